@@ -1,18 +1,49 @@
-#version 410 core
+#version 450 core
 layout (location = 0) out vec4 FragColor;
 layout (location = 1) out vec4 MaskColor;
 
 in vec3 Normal;
 in vec3 FragPos;
-
-uniform vec3 lightPos;
-uniform vec3 viewPos;
-uniform vec3 lightColor;
-uniform vec3 objectColor; // skin color
+flat in vec3 SkinColor; // skin color (per object or per instance)
+in float Thickness;     // mesh thickness below the surface, 0 (thin) to 1 (thick)
+in float Occlusion;     // ambient light reaching the surface, 0 (crease) to 1 (open)
+in vec2 UV;             // in the atlas of the mesh, see Mesh::unwrap_uvs
+
+// Camera and light, written once per frame (FrameUniforms in UniformRing.hpp).
+layout(std140, binding = 0) uniform FrameBlock {
+	mat4 projection;
+	mat4 view;
+	vec3 lightPos;
+	vec3 viewPos;
+	vec3 lightColor;
+};
 uniform vec3 freck_col;
 uniform float freck_scale;
 uniform float freck_frequency;
 
+// variants (see ShaderVariants.hpp), defined by the application after #version :
+// SKIN_NO_FRECKLES, SKIN_NO_THICKNESS, SKIN_FBM_OCTAVES n (1 to 6), SKIN_NOISE_TEXTURES,
+// SKIN_BAKED_ALBEDO
+#ifndef SKIN_FBM_OCTAVES
+#define SKIN_FBM_OCTAVES 6
+#endif
+
+// FBMNoise3D6 and snoise baked in tileable volumes (NoiseVolumes.hpp, same tiles and units)
+#ifdef SKIN_NOISE_TEXTURES
+layout(binding = 3) uniform sampler3D fbmVolume;
+layout(binding = 4) uniform sampler3D simplexVolume;
+const float fbm_tile = 50.0;
+const float simplex_tile = 16.0;
+#endif
+
+// skin colour baked in the atlas of the mesh (SkinAtlas.hpp, same unit and encoding) :
+// colour = mix(atlas_low, atlas_high, rgb) + SkinColor * a
+#ifdef SKIN_BAKED_ALBEDO
+layout(binding = 5) uniform sampler2D skinAtlas;
+const float atlas_low = -1.0 / 16.0;
+const float atlas_high = 17.0 / 16.0;
+#endif
+
 // math
 const float PI = 3.14159265359;
 const float DEG_TO_RAD = PI / 180.0;
@@ -44,44 +75,51 @@ float Noise3D( in vec3 uv ){
 
 float FBMNoise3D6( in vec3 uv){
     float fbm = Noise3D(uv*0.1)*0.5;
+#if SKIN_FBM_OCTAVES > 1
     fbm += Noise3D(uv*0.2)*0.25;
+#endif
+#if SKIN_FBM_OCTAVES > 2
     fbm += Noise3D(uv*0.4)*0.125;
+#endif
+#if SKIN_FBM_OCTAVES > 3
     fbm += Noise3D(uv*0.8)*0.0625;
+#endif
+#if SKIN_FBM_OCTAVES > 4
     fbm += Noise3D(uv*0.16)*0.03125;
+#endif
+#if SKIN_FBM_OCTAVES > 5
     fbm += Noise3D(uv*0.32)*0.03125;
+#endif
     return fbm;
 }
-// based on
-// https://colinbarrebrisebois.com/2011/03/07/gdc-2011-approximating-translucency-for-a-fast-cheap-and-convincing-subsurface-scattering-look/
 
-float hash( float n )
-{
-    return fract(sin(n)*3538.5453);
+float skinFBM( in vec3 uv){
+#ifdef SKIN_NOISE_TEXTURES
+    return texture(fbmVolume, uv / fbm_tile).r;
+#else
+    return FBMNoise3D6(uv);
+#endif
 }
+// based on
+// https://colinbarrebrisebois.com/2011/03/07/gdc-2011-approximating-translucency-for-a-fast-cheap-and-convincing-subsurface-scattering-look/
 
-float thickness( in vec3 p, in vec3 n, float maxDist, float falloff )
-{
-    const int nbIte = 7;
-    const float nbIteInv = 1./float(nbIte);
-    float ao = 0.0;
-
-    for( int i=0; i<nbIte; i++ )
-    {
-        float l = hash(float(i))*maxDist;
-        vec3 rd = normalize(-n)*l;
-        ao += (l) / pow(1.+l, falloff);
-    }
-
-    return clamp( 1.-ao*nbIteInv, 0., 1.);
-}
+// light going through the baked thickness : thin parts (fingers, ears) let more through
+const float thickness_transmittance = 0.3;
+const float thickness_density = 4.0;
+// the same everywhere, what the former per-fragment estimate evaluated to
+const float uniform_thickness = 0.05;
 
 vec3 sss(vec3 skin, in vec3 p, in vec3 n, in vec3 ro, in vec3 rd )
 {
     p.xz = mod(p.xz+100., 200.)-100.;
 
     vec3 ldir1 = normalize(lightPos-p);
-    float latt1 = pow( length(lightPos-p)*.15, 3. ) / (pow(1.125-FBMNoise3D6(p*100.0f), 0.25)*1.45+.35);
-    float thi = thickness(p, n, 6., 0.6);
+    float latt1 = pow( length(lightPos-p)*.15, 3. ) / (pow(1.125-skinFBM(p*100.0f), 0.25)*1.45+.35);
+#ifdef SKIN_NO_THICKNESS
+    float thi = uniform_thickness;
+#else
+    float thi = thickness_transmittance * exp(-thickness_density * Thickness);
+#endif
     vec3 diff1 = lightColor * (max(dot(n,ldir1),0.) ) / latt1;
 
     vec3 col =  diff1;
@@ -93,13 +131,16 @@ vec3 sss(vec3 skin, in vec3 p, in vec3 n, in vec3 ro, in vec3 rd )
 
 //----SKIN----
 // Partially inspired by works of Joseph Kubiak
-float subsurface_scale = 1.1;
-float subsurface_frequency = 2.2;
-float skin_scale = 0.5;
-float skin_frequency = 50.0;
-float base_skin_amt = 0.98;
-vec3 subsurface_color = vec3(0.639, 0.058, 0);
-vec3 surface_col = vec3(1.0, 1.0, 1.0);
+// constants : folded by the compiler
+const float subsurface_scale = 1.1;
+const float subsurface_frequency = 2.2;
+const float skin_scale = 0.5;
+const float skin_frequency = 50.0;
+const float base_skin_amt = 0.98;
+const vec3 subsurface_color = vec3(0.639, 0.058, 0);
+const vec3 surface_col = vec3(1.0, 1.0, 1.0);
+// how much the baked ambient occlusion darkens the scattered light (creases between the fingers)
+const float occlusion_strength = 0.6;
 
 // Simplex 2D noise by Inigo Quilez
 vec2 hash( vec2 p ) // replace this by something better
@@ -205,27 +246,42 @@ float snoise(vec3 v){
     dot(p2,x2), dot(p3,x3) ) );
 }
 
+float skinSimplex(vec3 v){
+#ifdef SKIN_NOISE_TEXTURES
+    return texture(simplexVolume, v / simplex_tile).r;
+#else
+    return snoise(v);
+#endif
+}
+
 
 
 void main()
 {
     //----------------------------[ HUMAN SKIN ]----------------------------//
+#ifdef SKIN_BAKED_ALBEDO
+    vec4 baked = texture(skinAtlas, UV);
+    vec3 col = mix(vec3(atlas_low), vec3(atlas_high), baked.rgb) + SkinColor * baked.a;
+#else
     float subsurface_radius = subsurface_scale / 2.0;
-    float freck_radius = freck_scale / 2.0;
     vec3 uv = FragPos*10.0f;
-    float subsurface_distance = snoise(uv * subsurface_frequency);
+    float subsurface_distance = skinSimplex(uv * subsurface_frequency);
     float subsurface = 1.0 - min(1.0, subsurface_distance / subsurface_radius);
-    float skin_value = snoise(uv * skin_frequency)/42.0 ;//* skin_scale;
-    float freck_distance = n_noise(FragPos.zy/FragPos.x * freck_frequency);
-    float freck = 1.0 - min(1.0, freck_distance / freck_radius);
+    float skin_value = skinSimplex(uv * skin_frequency)/42.0 ;//* skin_scale;
     vec3 col = (subsurface_color * subsurface);
-    col = mix(col,  objectColor , base_skin_amt);
+    col = mix(col,  SkinColor , base_skin_amt);
     col  = mix(col, surface_col, skin_value);
+#ifndef SKIN_NO_FRECKLES
+    float freck_radius = freck_scale / 2.0;
+    float freck_distance = n_noise(FragPos.zy/FragPos.x * freck_frequency);
+    float freck = 1.0 - min(1.0, freck_distance / freck_radius);
     col = mix(col, freck_col, freck);
+#endif
+#endif
 
     //-----------------------------[ LIGHTING ]-----------------------------//
     // basic lighgting
-    float ambientStrength = 0.001; vec3 ambient = ambientStrength * lightColor;
+    float ambientStrength = 0.001; vec3 ambient = ambientStrength * Occlusion * lightColor;
     vec3 norm = normalize(Normal); vec3 lightDir = normalize(lightPos - FragPos);
     float diff = max(dot(norm, lightDir), 0.0); vec3 diffuse = diff * lightColor;
     float specularStrength = 0.01; vec3 viewDir = normalize(viewPos - FragPos);
@@ -233,8 +289,9 @@ void main()
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
     vec3 specular = specularStrength * spec * lightColor;
     // SubSurface Scattering lighting
-    vec3 sssCol = sss(objectColor, FragPos, Normal, viewPos, normalize(viewPos - FragPos));
-    FragColor = vec4(mix(sssCol, sssCol*lightColor, 0.85) + ambient + specular,1.0);
+    vec3 sssCol = sss(SkinColor, FragPos, Normal, viewPos, normalize(viewPos - FragPos));
+    float crease = mix(1.0, Occlusion, occlusion_strength);
+    FragColor = vec4(mix(sssCol, sssCol*lightColor, 0.85) * crease + ambient + specular,1.0);
 
     FragColor.xyz *= col;
     MaskColor = vec4(0,0,0,1);
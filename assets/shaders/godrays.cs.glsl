@@ -1,59 +1,52 @@
 #version 450 core
+// radial blur of the light mask towards the light at a fraction of the screen resolution (see
+// GodRays.hpp), composited and upsampled by godrays.fs.glsl
 layout (local_size_x = 16, local_size_y = 16) in;
-layout (rgba32f, binding = 0) uniform image2D img_output;
-layout (binding = 1) uniform sampler2D img_in;
+layout (rgba16f, binding = 0) uniform writeonly image2D img_output;   // rgb : rays, a : linear depth
 layout (binding = 2) uniform sampler2D img_mask;
-//layout (binding = 3) uniform sampler2D img_mask;
+layout (binding = 6) uniform sampler2D img_depth;
 
 uniform vec2 sunPos;
+uniform vec2 depthParameters;   // projection[3][2], projection[2][2]
+uniform ivec2 raysSize;         // part of img_output of the render scale
+uniform vec2 uvScale;           // part of the scene textures the 3D pass rendered into
 
-vec4 getSample (in sampler2D img, in vec2 uv, in vec2 resolution){
-    ivec2       position = ivec2(uv.xy);
-    vec2        screenNormalized = vec2(position) / vec2(resolution);
-    return      texture2D(img, screenNormalized);
-}
-
-vec2 getTexCoords (in vec2 uv, in vec2 resolution){
-    ivec2       position = ivec2(uv.xy);
-    return      vec2(position) / vec2(resolution);
-}
-
-const float exposure = 0.009f;
 const float decay = 0.92;
 const float density  = 0.905;
 const float weight  = 0.36;
+const int NUM_SAMPLES = 80;
+
+// screen uv -> uv in the scene textures, kept half a texel inside the part the 3D pass rendered
+// into : the filtering never blends in the texels outside of it
+vec2 sceneUv(vec2 tc)
+{
+    vec2 halfTexel = 0.5 / vec2(textureSize(img_mask, 0));
+    return clamp(tc * uvScale, halfTexel, uvScale - halfTexel);
+}
 
 void main()
 {
-    vec4 pixel = vec4(0,0,0,1);     // final image pixel
     ivec2 pixel_coords = ivec2(gl_GlobalInvocationID);  // pixel coordinate
-    ivec2 img_resolution = imageSize(img_output);       // image resolution
-    vec2 st = pixel_coords.xy;      // fragCoords
-
-
-    vec4 color =  vec4(0);
-    color.a = 1.0;
+    ivec2 img_resolution = raysSize;                    // image resolution
+    if (any(greaterThanEqual(pixel_coords, img_resolution))) return;
 
-
-    int NUM_SAMPLES = 80;
-    vec2 tc = vec2(pixel_coords)/vec2(img_resolution);
+    vec2 tc = (vec2(pixel_coords) + 0.5) / vec2(img_resolution);
     vec2 deltatexCoord = (tc - sunPos);
     deltatexCoord *= (1.0/ float(NUM_SAMPLES))*density;
     float illuminationDecay = 1.0f;
 
-    vec4 godRayColor = vec4(0.0);//texture2D(img_mask , tc) ;//(texture2D(img_mask , tc) + texture2D(img_mask_sun, tc))/2.0f;
+    vec3 godRayColor = vec3(0.0);
     for(int i = 0 ; i< NUM_SAMPLES ; i++)
     {
         tc-= deltatexCoord;
-        vec4 samp = texture2D(img_mask , tc) ;//(texture2D(img_mask , tc) + texture2D(img_mask_sun, tc))/2.0f;
-        samp *= illuminationDecay*weight;
-        godRayColor += samp;
+        godRayColor += texture(img_mask , sceneUv(tc)).rgb * illuminationDecay*weight;
         illuminationDecay *= decay;
     }
-    vec4 realColor = getSample(img_in, pixel_coords, img_resolution);
-    color = vec4(vec3(godRayColor.r, godRayColor.g, godRayColor.b) * exposure, godRayColor.a) + realColor;
 
+    // depth of the screen pixel at the texel center
+    vec2 center = (vec2(pixel_coords) + 0.5) / vec2(img_resolution);
+    float depth = texelFetch(img_depth, ivec2(center * uvScale * vec2(textureSize(img_depth, 0))), 0).r;
+    float linearDepth = depthParameters.x / (depth * 2.0 - 1.0 + depthParameters.y);
 
-    //-------------[ REGISTER FINAL IMAGE ]-------------//
-    imageStore(img_output, pixel_coords, color);
-}
\ No newline at end of file
+    imageStore(img_output, pixel_coords, vec4(godRayColor, linearDepth));
+}
@@ -0,0 +1,99 @@
+#version 450 core
+// scene colour + light shafts, written to the screen (see GodRays.hpp) :
+// GODRAYS_FULL_RESOLUTION : radial blur of the light mask for every pixel
+// GODRAYS_NONE            : the scene alone (light not visible)
+// otherwise               : bilateral upsampling of the blur of godrays.cs.glsl
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+layout (binding = 1) uniform sampler2D img_in;
+layout (binding = 2) uniform sampler2D img_mask;
+layout (binding = 6) uniform sampler2D img_depth;
+layout (binding = 7) uniform sampler2D img_rays;    // rgb : rays, a : linear depth
+
+uniform vec2 sunPos;
+uniform vec2 depthParameters;   // projection[3][2], projection[2][2]
+uniform float intensity;        // visibility of the light
+uniform vec2 uvScale;           // part of the scene textures the 3D pass rendered into
+uniform ivec2 raysSize;         // part of img_rays of the render scale
+
+const float exposure = 0.009f;
+const float decay = 0.92;
+const float density  = 0.905;
+const float weight  = 0.36;
+const int NUM_SAMPLES = 80;
+// relative depth difference a low resolution texel loses most of its weight over
+const float depth_tolerance = 0.05;
+
+// screen uv -> uv in the scene textures, kept half a texel inside the part the 3D pass rendered
+// into : the filtering never blends in the texels outside of it
+vec2 sceneUv(vec2 tc)
+{
+    vec2 halfTexel = 0.5 / vec2(textureSize(img_mask, 0));
+    return clamp(tc * uvScale, halfTexel, uvScale - halfTexel);
+}
+
+#if defined(GODRAYS_NONE)
+// no rays, see main()
+#elif defined(GODRAYS_FULL_RESOLUTION)
+vec3 godRays(vec2 tc)
+{
+    vec2 deltatexCoord = (tc - sunPos);
+    deltatexCoord *= (1.0/ float(NUM_SAMPLES))*density;
+    float illuminationDecay = 1.0f;
+
+    vec3 godRayColor = vec3(0.0);
+    for(int i = 0 ; i< NUM_SAMPLES ; i++)
+    {
+        tc-= deltatexCoord;
+        godRayColor += texture(img_mask , sceneUv(tc)).rgb * illuminationDecay*weight;
+        illuminationDecay *= decay;
+    }
+    return godRayColor;
+}
+#else
+vec3 godRays(vec2 tc)
+{
+    float depth = texture(img_depth, sceneUv(tc)).r;
+    float linearDepth = depthParameters.x / (depth * 2.0 - 1.0 + depthParameters.y);
+
+    // the 4 texels bilinear filtering would blend, weighted by how close their depth is
+    ivec2 size = raysSize;
+    vec2 position = tc * vec2(size) - 0.5;
+    ivec2 base = ivec2(floor(position));
+    vec2 f = position - vec2(base);
+
+    vec3 sum = vec3(0.0);
+    float total = 0.0;
+    vec3 nearest = vec3(0.0);
+    float nearestDifference = 1e30;
+    for (int i = 0; i < 4; ++i)
+    {
+        ivec2 offset = ivec2(i & 1, i >> 1);
+        vec4 rays = texelFetch(img_rays, clamp(base + offset, ivec2(0), size - 1), 0);
+        vec2 bilinear = mix(1.0 - f, f, vec2(offset));
+        float difference = abs(rays.a - linearDepth) / linearDepth;
+        float w = bilinear.x * bilinear.y * exp(-difference / depth_tolerance);
+        sum += rays.rgb * w;
+        total += w;
+        if (difference < nearestDifference) {
+            nearestDifference = difference;
+            nearest = rays.rgb;
+        }
+    }
+    // none of them on the surface of the pixel : the closest in depth
+    return (total > 1e-4) ? sum / total : nearest;
+}
+#endif
+
+void main()
+{
+    // bilinear upscaling of the 3D pass
+    vec4 realColor = texture(img_in, sceneUv(TexCoords));
+#ifdef GODRAYS_NONE
+    FragColor = vec4(realColor.rgb, 1.0);
+#else
+    FragColor = vec4(godRays(TexCoords) * (exposure * intensity) + realColor.rgb, 1.0);
+#endif
+}
@@ -0,0 +1,60 @@
+#version 450 core
+
+// Input vertex data, different for all executions of this shader.
+layout(location = 0) in vec3 vertexPosition_modelspace;
+layout(location = 1) in vec2 vertexUV;
+layout(location = 2) in vec3 vertexNormal_modelspace;
+layout(location = 3) in float vertexThickness;   // baked, see Mesh::bake_thickness
+layout(location = 4) in float vertexOcclusion;   // baked, see Mesh::bake_occlusion
+
+// Values that change for each instance.
+layout(location = 8) in mat4 instanceModel;          // locations 8 to 11
+layout(location = 15) in vec3 instanceColor;
+
+// Camera and light, written once per frame (FrameUniforms in UniformRing.hpp).
+layout(std140, binding = 0) uniform FrameBlock {
+	mat4 projection;
+	mat4 view;
+	vec3 lightPos;
+	vec3 viewPos;
+	vec3 lightColor;
+};
+
+// Vertex format of the draw, model and colour come from the instance (ObjectUniforms in UniformRing.hpp).
+// Packed vertices : model space position = positionOffset + position * positionScale
+layout(std140, binding = 1) uniform ObjectBlock {
+	mat4 model;
+	vec3 objectColor;
+	vec3 positionOffset;
+	vec3 positionScale;
+	bool octahedralNormals;
+};
+
+out vec3 Normal;
+out vec3 FragPos;
+flat out vec3 SkinColor;
+out float Thickness;
+out float Occlusion;
+out vec2 UV;
+
+// normals of packed meshes are octahedral (2 components), see Mesh::pack_vertices
+vec3 octahedral_decode(vec2 e){
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.x += (n.x >= 0.0) ? -t : t;
+	n.y += (n.y >= 0.0) ? -t : t;
+	return normalize(n);
+}
+
+void main(){
+	vec3 position = positionOffset + vertexPosition_modelspace * positionScale;
+	vec4 worldPosition = instanceModel * vec4(position,1);
+	gl_Position =  projection * view * worldPosition;
+	// model space, as in vertex_shader.glsl (the lighting of fragment_shader.glsl expects it)
+	Normal = octahedralNormals ? octahedral_decode(vertexNormal_modelspace.xy) : vertexNormal_modelspace;
+	FragPos = worldPosition.xyz;
+	SkinColor = instanceColor;
+	Thickness = vertexThickness;
+	Occlusion = vertexOcclusion;
+	UV = vertexUV;
+}
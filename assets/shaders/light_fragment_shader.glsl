@@ -1,11 +1,19 @@
-#version 410 core
+#version 450 core
 layout (location = 0) out vec4 FragColor;
 layout (location = 1) out vec4 MaskColor;
 
-uniform vec3 color;
+// Model, colour and vertex format of the draw (ObjectUniforms in UniformRing.hpp).
+// Packed vertices : model space position = positionOffset + position * positionScale
+layout(std140, binding = 1) uniform ObjectBlock {
+	mat4 model;
+	vec3 objectColor;
+	vec3 positionOffset;
+	vec3 positionScale;
+	bool octahedralNormals;
+};
 
 void main()
 {
-    FragColor = vec4(color*1.0f, 1.0);
-    MaskColor = vec4(color*10.0f, 1.0);
+    FragColor = vec4(objectColor*1.0f, 1.0);
+    MaskColor = vec4(objectColor*10.0f, 1.0);
 }
\ No newline at end of file
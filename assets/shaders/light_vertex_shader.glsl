@@ -1,11 +1,28 @@
-#version 410 core
+#version 450 core
 layout (location = 0) in vec3 aPos;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+
+// Camera and light, written once per frame (FrameUniforms in UniformRing.hpp).
+layout(std140, binding = 0) uniform FrameBlock {
+	mat4 projection;
+	mat4 view;
+	vec3 lightPos;
+	vec3 viewPos;
+	vec3 lightColor;
+};
+
+// Model, colour and vertex format of the draw (ObjectUniforms in UniformRing.hpp).
+// Packed vertices : model space position = positionOffset + position * positionScale
+layout(std140, binding = 1) uniform ObjectBlock {
+	mat4 model;
+	vec3 objectColor;
+	vec3 positionOffset;
+	vec3 positionScale;
+	bool octahedralNormals;
+};
 
 void main()
 {
-	gl_Position = projection * view * model * vec4(aPos*0.5, 1.0);
+	vec3 position = positionOffset + aPos * positionScale;
+	gl_Position = projection * view * model * vec4(position, 1.0);
 }
\ No newline at end of file
@@ -1,22 +1,55 @@
-#version 410 core
+#version 450 core
 
 // Input vertex data, different for all executions of this shader.
 layout(location = 0) in vec3 vertexPosition_modelspace;
 layout(location = 1) in vec2 vertexUV;
 layout(location = 2) in vec3 vertexNormal_modelspace;
+layout(location = 3) in float vertexThickness;   // baked, see Mesh::bake_thickness
+layout(location = 4) in float vertexOcclusion;   // baked, see Mesh::bake_occlusion
 
-// Values that stay constant for the whole mesh.
-uniform mat4 projection;
-uniform mat4 modelGlobal;
-uniform mat4 view;
-uniform mat4 model;
+// Camera and light, written once per frame (FrameUniforms in UniformRing.hpp).
+layout(std140, binding = 0) uniform FrameBlock {
+	mat4 projection;
+	mat4 view;
+	vec3 lightPos;
+	vec3 viewPos;
+	vec3 lightColor;
+};
+
+// Model, colour and vertex format of the draw (ObjectUniforms in UniformRing.hpp).
+// Packed vertices : model space position = positionOffset + position * positionScale
+layout(std140, binding = 1) uniform ObjectBlock {
+	mat4 model;
+	vec3 objectColor;
+	vec3 positionOffset;
+	vec3 positionScale;
+	bool octahedralNormals;
+};
 
 out vec3 Normal;
 out vec3 FragPos;
+flat out vec3 SkinColor;
+out float Thickness;
+out float Occlusion;
+out vec2 UV;
+
+// normals of packed meshes are octahedral (2 components), see Mesh::pack_vertices
+vec3 octahedral_decode(vec2 e){
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.x += (n.x >= 0.0) ? -t : t;
+	n.y += (n.y >= 0.0) ? -t : t;
+	return normalize(n);
+}
 
 void main(){
-	gl_Position =  projection * view * model * vec4(vertexPosition_modelspace,1);
-	Normal = vertexNormal_modelspace;
-	FragPos = (model * vec4(vertexPosition_modelspace,1)).xyz;
+	vec3 position = positionOffset + vertexPosition_modelspace * positionScale;
+	gl_Position =  projection * view * model * vec4(position,1);
+	Normal = octahedralNormals ? octahedral_decode(vertexNormal_modelspace.xy) : vertexNormal_modelspace;
+	FragPos = (model * vec4(position,1)).xyz;
+	SkinColor = objectColor;
+	Thickness = vertexThickness;
+	Occlusion = vertexOcclusion;
+	UV = vertexUV;
 }
 
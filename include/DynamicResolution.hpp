@@ -0,0 +1,95 @@
+#ifndef DYNAMICRESOLUTION_HPP
+#define DYNAMICRESOLUTION_HPP
+
+// Include standard headers
+#include <cstdint>
+#include <deque>
+#include <ostream>
+#include <vector>
+
+// Include Glad
+#include <glad/glad.h>
+
+// render scale of the 3D pass (RenderTargets.hpp) adapted to hold a target GPU frame time :
+// - the GPU time from beginFrame() to endFrame() is measured with GL_TIMESTAMP queries (they do
+//   not nest like the GL_TIME_ELAPSED ones of GpuTimer, which run inside) in a ring of FRAMES
+//   frames, read once available so it never stalls
+// - over the target, the scale drops at once to the one expected to meet it (the time goes with
+//   the number of pixels, the square of the scale) ; well under it, the scale rises by STEP.
+//   After a change the timings of the frames issued before it are dropped, and the controller
+//   waits COOLDOWN frames for the new ones.
+// Every change is kept as a Decision, and the scale and time of the last HISTORY frames, for the
+// profiling panel.
+class DynamicResolution
+{
+public:
+    static const int FRAMES = 4;
+    static const int COOLDOWN = 16;
+    static const int HISTORY = 240;
+    static constexpr float STEP = 0.05f;
+
+    struct Decision {
+        std::uint64_t frame;
+        float milliseconds;     // smoothed GPU time the decision was taken on
+        float from, to;         // render scales
+    };
+
+    DynamicResolution() = default;
+    DynamicResolution(const DynamicResolution &) = delete;
+    DynamicResolution & operator=(const DynamicResolution &) = delete;
+
+    // around the GPU work of a frame (needs a current GL context)
+    void beginFrame();
+    void endFrame();
+
+    // adapt the scale (otherwise it stays where it is)
+    void setEnabled(bool value) { enabled = value; }
+    bool isEnabled() const { return enabled; }
+    void setTargetMilliseconds(float value) { targetMilliseconds = value; }
+    float getTargetMilliseconds() const { return targetMilliseconds; }
+    void setScaleRange(float minimum, float maximum);
+    float getMinimumScale() const { return minimumScale; }
+    float getMaximumScale() const { return maximumScale; }
+    void setScale(float value);
+
+    // render scale for the next frame
+    float getScale() const { return scale; }
+    // smoothed GPU time of the frames (0 until measured)
+    float getMilliseconds() const { return milliseconds; }
+
+    // profiling : changes of the scale (oldest first, the last MAX_DECISIONS), scales and times of
+    // the last frames (ring starting at getHistoryOffset())
+    const std::deque<Decision> & getDecisions() const { return decisions; }
+    const std::vector<float> & getScaleHistory() const { return scaleHistory; }
+    const std::vector<float> & getMillisecondsHistory() const { return millisecondsHistory; }
+    int getHistoryOffset() const { return historyOffset; }
+    void report(std::ostream & out) const;
+
+    void destroy();
+
+private:
+    static const std::size_t MAX_DECISIONS = 64;
+
+    void decide(float ms);
+
+    GLuint startQueries[FRAMES] = {}, endQueries[FRAMES] = {};
+    bool issued[FRAMES] = {};
+    std::uint64_t issuedFrame[FRAMES] = {};   // frame each slot was issued on
+    int current = 0;
+    std::uint64_t frame = 0;
+    std::uint64_t decisionFrame = 0;          // first frame at the current scale
+
+    bool enabled = true;
+    float targetMilliseconds = 1000.0f / 60.0f;
+    float minimumScale = 0.5f, maximumScale = 1.0f;
+    float scale = 1.0f;
+    float milliseconds = 0.0f;
+    int framesSinceChange = 0;
+
+    std::deque<Decision> decisions;
+    std::vector<float> scaleHistory = std::vector<float>(HISTORY, 1.0f);
+    std::vector<float> millisecondsHistory = std::vector<float>(HISTORY, 0.0f);
+    int historyOffset = 0;
+};
+
+#endif //DYNAMICRESOLUTION_HPP
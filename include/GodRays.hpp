@@ -0,0 +1,83 @@
+#ifndef GODRAYS_HPP
+#define GODRAYS_HPP
+
+// Include standard headers
+#include <memory>
+#include <string>
+
+// Include Glad
+#include <glad/glad.h>
+
+// Include GLM
+#include <glm.hpp>
+
+#include "GpuTimer.hpp"
+#include "RenderTargets.hpp"
+#include "Shader.hpp"
+
+// resolution the radial blur runs at (divisor of the screen size)
+enum GodRaysQuality {
+    GODRAYS_FULL = 1,
+    GODRAYS_HALF = 2,
+    GODRAYS_QUARTER = 4
+};
+
+// the light shafts of the post-processing, composited with the scene of RenderTargets straight
+// into the bound framebuffer (no intermediate full screen image), which upscales the part the 3D
+// pass rendered into to the viewport :
+// - full : one pass, the radial blur of the light mask is done per screen pixel in the composite
+// - half / quarter : godrays.cs.glsl blurs the mask at the reduced resolution and keeps the
+//   linear depth of each texel, the composite upsamples the blur bilaterally : of the 4 nearest
+//   texels, those at the depth of the pixel weigh the most, so the shafts do not bleed over the
+//   edges of the hands
+// The rays are scaled by the visibility of the light (LightVisibility.hpp) ; without any, the
+// blur is skipped and the composite only copies the scene. Each quality has its GPU timer (of
+// the frames with rays). Texture units 1, 2 (scene colour, light mask), 6 (depth) and
+// 7 (blurred rays) are used, they are repeated in the shaders.
+class GodRays {
+public:
+    static const GLuint COLOR_UNIT = 1;     // texture units (layout(binding = ...) in the shaders)
+    static const GLuint MASK_UNIT = 2;
+    static const GLuint DEPTH_UNIT = 6;
+    static const GLuint RAYS_UNIT = 7;
+    static const int QUALITIES = 3;
+
+    // programs from the shaders in @shaderDirectory
+    explicit GodRays(const std::string & shaderDirectory);
+    GodRays(const GodRays &) = delete;
+    GodRays & operator=(const GodRays &) = delete;
+
+    // blur and composite the scene of @targets (rendered with @projection) with the light shafts
+    // of its mask, @sunPos the light in [0, 1] screen coordinates, the rays scaled by @intensity
+    // (0 : none)
+    void render(const RenderTargets & targets, const glm::vec2 & sunPos, const glm::mat4 & projection,
+                float intensity = 1.0f);
+
+    void setQuality(GodRaysQuality value) { quality = value; }
+    GodRaysQuality getQuality() const { return quality; }
+
+    // the last frame had rays
+    bool active() const { return lastActive; }
+
+    // smoothed GPU time of the god rays at @mode (0 until it was rendered once)
+    float getMilliseconds(GodRaysQuality mode) const { return timers[index(mode)].getMilliseconds(); }
+
+    void destroy();
+
+private:
+    // the composite, one triangle over the screen
+    void drawTriangle();
+
+    static int index(GodRaysQuality mode) { return mode == GODRAYS_FULL ? 0 : (mode == GODRAYS_HALF ? 1 : 2); }
+
+    std::unique_ptr<Shader> blurProgram, fullProgram, upsampleProgram, copyProgram;
+    GpuTimer timers[QUALITIES];
+    GodRaysQuality quality = GODRAYS_HALF;
+    bool lastActive = false;
+
+    GLuint rays = 0;        // rgb : blurred light, a : linear depth
+    GLuint vertexArray = 0; // empty, the full screen triangle comes from gl_VertexID
+    int raysWidth = 0, raysHeight = 0;   // allocated
+};
+
+#endif //GODRAYS_HPP
@@ -0,0 +1,58 @@
+#ifndef GPUTIMER_HPP
+#define GPUTIMER_HPP
+
+#include <glad/glad.h>
+
+// measure the GPU time spent between begin() and end() with GL_TIME_ELAPSED queries.
+// queries are double buffered so reading the result of the previous frame never stalls.
+class GpuTimer
+{
+public:
+    GpuTimer() = default;
+
+    void begin()
+    {
+        if (queries[0] == 0) glGenQueries(2, queries);
+        glBeginQuery(GL_TIME_ELAPSED, queries[current]);
+    }
+
+    void end()
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        issued[current] = true;
+        current = 1 - current;
+
+        // the other query was issued one frame ago, fetch it if the GPU is done with it
+        if (issued[current])
+        {
+            GLint available = 0;
+            glGetQueryObjectiv(queries[current], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available)
+            {
+                GLuint64 nanoseconds = 0;
+                glGetQueryObjectui64v(queries[current], GL_QUERY_RESULT, &nanoseconds);
+                // exponential moving average keeps the displayed value readable
+                float ms = float(nanoseconds) * 1e-6f;
+                milliseconds = (milliseconds == 0.0f) ? ms : milliseconds * 0.9f + ms * 0.1f;
+                issued[current] = false;
+            }
+        }
+    }
+
+    // smoothed GPU time in milliseconds
+    float getMilliseconds() const { return milliseconds; }
+
+    void cleanUp()
+    {
+        if (queries[0] != 0) glDeleteQueries(2, queries);
+        queries[0] = queries[1] = 0;
+    }
+
+private:
+    GLuint queries[2] = {0, 0};
+    bool issued[2] = {false, false};
+    int current = 0;
+    float milliseconds = 0.0f;
+};
+
+#endif //GPUTIMER_HPP
@@ -0,0 +1,57 @@
+#ifndef LIGHTVISIBILITY_HPP
+#define LIGHTVISIBILITY_HPP
+
+// Include standard headers
+#include <functional>
+
+// Include Glad
+#include <glad/glad.h>
+
+// Include GLM
+#include <glm.hpp>
+
+// how much of the light the camera sees, to scale the god rays and skip them when it is none :
+// - on the CPU, the bounding sphere of the light against the screen : none when it is behind the
+//   camera or off screen, fading out while its center leaves the screen (the rays are cast from
+//   the on screen part of the light mask only)
+// - on the GPU, occlusion queries on the light drawn again once the scene is in the depth
+//   buffer (colour and depth writes off) : the fraction of its samples that pass the depth test
+// The queries are double buffered like GpuTimer : the fraction is the one of the previous frame
+// whose result is there, reading it never stalls.
+class LightVisibility
+{
+public:
+    LightVisibility() = default;
+    LightVisibility(const LightVisibility &) = delete;
+    LightVisibility & operator=(const LightVisibility &) = delete;
+
+    // screen test of the light of bounding sphere (@center, @radius) seen through @projection * @view
+    void beginFrame(const glm::mat4 & projection, const glm::mat4 & view, const glm::vec3 & center, float radius);
+
+    // occlusion queries around @drawLight (draws the light with the depth buffer of the scene
+    // bound), nothing when the light is off screen
+    void query(const std::function<void()> & drawLight);
+
+    // the light (partly) on screen
+    bool onScreen() const { return edgeFade > 0.0f; }
+    // light center in [0, 1] screen coordinates (outside when off screen)
+    const glm::vec2 & getScreenPosition() const { return screenPosition; }
+    // fraction of the light samples not hidden by the scene (1 until a query result arrived)
+    float getUnoccluded() const { return unoccluded; }
+    // scale of the god rays : unoccluded fraction and fade at the screen edges, 0 : no rays
+    float getVisibility() const { return onScreen() ? unoccluded * edgeFade : 0.0f; }
+
+    void destroy();
+
+private:
+    GLuint visibleQueries[2] = {0, 0};   // samples passing the depth test of the scene
+    GLuint totalQueries[2] = {0, 0};     // samples of the light on screen
+    bool issued[2] = {false, false};
+    int current = 0;
+
+    glm::vec2 screenPosition = glm::vec2(0.5f);
+    float edgeFade = 0.0f;
+    float unoccluded = 1.0f;
+};
+
+#endif //LIGHTVISIBILITY_HPP
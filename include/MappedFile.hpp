@@ -0,0 +1,38 @@
+#ifndef MAPPEDFILE_HPP
+#define MAPPEDFILE_HPP
+
+// Include standard headers
+#include <cstddef>
+#include <string>
+
+// read-only memory mapping of a whole file
+class MappedFile {
+public:
+    // constructors
+    MappedFile() = default;
+    explicit MappedFile(const std::string & filename) { open(filename); }
+    MappedFile(const MappedFile &) = delete;
+    MappedFile & operator=(const MappedFile &) = delete;
+    // destructor
+    ~MappedFile() { close(); }
+
+    // map the file, return false if it can't be opened or mapped
+    bool open(const std::string & filename);
+
+    // unmap the file
+    void close();
+
+    bool is_open() const { return mapping != nullptr; }
+    const char * data() const { return static_cast<const char *>(mapping); }
+    std::size_t size() const { return length; }
+
+private:
+    void * mapping = nullptr;
+    std::size_t length = 0;
+#ifdef _WIN32
+    void * fileHandle = nullptr;
+    void * mappingHandle = nullptr;
+#endif
+};
+
+#endif //MAPPEDFILE_HPP
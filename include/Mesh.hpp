@@ -17,6 +17,9 @@
 #include <gtx/transform.hpp>
 #include <unordered_map>
 
+#include "MeshAdjacency.hpp"
+#include "MeshBVH.hpp"
+
 // BOX structure for bounding box
 struct BOX {
     glm::vec2 xpos, ypos, zpos;
@@ -25,6 +28,25 @@ struct BOX {
     glm::vec3 dimension() {return glm::vec3(xpos.y - xpos.x, ypos.y - ypos.x, zpos.y - zpos.x);}
 };
 
+// width of the indices sent to the GPU (in bytes)
+enum IndexWidth {
+    INDEX_16_BITS = 2,
+    INDEX_32_BITS = 4
+};
+
+// layout of the vertices sent to the GPU
+enum VertexFormat {
+    VERTEX_FLOAT,   // 4 buffers : float positions, uvs, normals, thickness + occlusion (40 bytes per vertex)
+    VERTEX_PACKED   // 1 interleaved buffer, see Mesh::pack_vertices (16 to 24 bytes per vertex)
+};
+
+// level of detail : @count indices from @first in the concatenation of Mesh::indices and
+// Mesh::lod_indices, @error is how far the simplified surface may be from the full one
+struct MeshLod {
+    unsigned int first, count;
+    float error;
+};
+
 class Mesh {
 public:
     // constructors
@@ -34,55 +56,182 @@ public:
     ~Mesh();
 
     // compute normals for each vertex depending on weight_type criteria
+    // (refresh triangle_normals and triangle_areas too)
     // @weight_type : 0 for uniform, 1 for area of triangles, 2 for angle of triangle
     void compute_smooth_vertex_normals(int weight_type);
 
     // variables of a mesh
     //
-    // P0 ---- P1       indices :           0 1 2 1 2 3
-    //  \    /  \       triangles:          (0, 1, 2) (1, 2, 3)
+    // P0 ---- P1       indices :           0 1 2 1 2 3   (triangle i is indices[3i .. 3i+2])
+    //  \    /  \       triangle_normals:   N012 N123
     //   \  /    \      indexed_vertices:   P0 P1 P2 P3
     //    P2 --- P3
     //
     std::vector<float> valence_field;
-    std::vector<unsigned short> indices;
+    std::vector<unsigned int> indices;
     std::vector<glm::vec3> indexed_vertices, indexed_normals;
     std::vector<glm::vec2> indexed_uvs;
-    std::vector<std::vector<unsigned short> > triangles;
+    // texels along each side of the atlas indexed_uvs were packed for by unwrap_uvs(), 0 without one
+    unsigned int atlas_size = 0;
+    std::vector<glm::vec3> triangle_normals;
+    std::vector<float> triangle_areas;
     BOX bounding_box;
 
+    // thickness of the mesh below each vertex, relative to its thick parts (0 to 1), baked by
+    // bake_thickness() and kept in the binary cache
+    std::vector<float> vertex_thickness;
+
+    // ambient light reaching each vertex, 1 when nothing is around, baked by bake_occlusion()
+    // on every load
+    std::vector<float> vertex_occlusion;
+
+    // levels of detail over the same vertices, lods[0] is the full mesh (indices), coarser
+    // levels are stored one after the other in lod_indices
+    std::vector<unsigned int> lod_indices;
+    std::vector<MeshLod> lods;
+
+    // indices are always 32 bits on the CPU, index_width is the width they take on the GPU
+    IndexWidth index_width = INDEX_16_BITS;
+
+    // GPU vertex layout, quantized_positions and packed_uvs only apply to VERTEX_PACKED
+    VertexFormat vertex_format = VERTEX_PACKED;
+    bool quantized_positions = true;
+    bool packed_uvs = true;
+
     unsigned int getNumberOfVertices(){return indexed_vertices.size();}
+    unsigned int getNumberOfTriangles() const {return indices.size() / 3;}
+
+    // vertex -> vertex / triangle adjacency, built on first use (in parallel) and kept
+    // until invalidate_adjacency() is called after a change of indices
+    const MeshAdjacency & adjacency();
+    void invalidate_adjacency();
+
+    // bounding volume hierarchy over the triangles for ray queries, built on first use (in
+    // parallel) and kept until invalidate_bvh() is called after a change of vertices or indices
+    const MeshBVH & bvh();
+    void invalidate_bvh();
+
+    // number of neighbours of each vertex, stored in valence_field
+    void compute_valence_field();
+
+    // reorder triangles for the post-transform vertex cache and to reduce overdraw, then
+    // renumber vertices in order of first use (see MeshOptimizer.cpp)
+    void optimize_for_gpu(unsigned int cache_size = 16);
+
+    // average cache miss ratio (transformed vertices per triangle) and average transformed
+    // vertex ratio (transformed vertices per vertex, 1 is ideal) for a FIFO cache of cache_size
+    float compute_ACMR(unsigned int cache_size) const;
+    float compute_ATVR(unsigned int cache_size) const;
+
+    // build @levels levels of detail with quadric error edge collapses, each one keeping
+    // @ratio of the triangles of the previous one (see MeshSimplifier.cpp)
+    void build_lod_chain(unsigned int levels = 4, float ratio = 0.25f);
+
+    // split the mesh in charts and pack them in a @size x @size texel atlas, with @padding texels
+    // around each one. Vertices on the borders of the charts are duplicated (see MeshUnwrap.cpp)
+    void unwrap_uvs(unsigned int size = 2048, unsigned int padding = 4);
+
+    // cast @samples rays from every vertex into the mesh around the inverted normal and store
+    // the mean distance to the other side in vertex_thickness, in parallel (see MeshBaker.cpp)
+    void bake_thickness(unsigned int samples = 32);
+
+    // cast @samples rays from every vertex over the outward hemisphere and store the fraction that
+    // travels @radius (relative to the bounding box diagonal) without a hit in vertex_occlusion,
+    // on @threads threads (0 for all of them)
+    void bake_occlusion(unsigned int samples = 32, float radius = 0.05f, unsigned int threads = 0);
+
+    // time bake_occlusion() with 1, 2, 4... threads
+    void benchmark_occlusion(std::ostream & out, unsigned int samples = 32, float radius = 0.05f);
+
+    // coarsest level of detail whose error is below @max_error (in model units)
+    unsigned int select_lod(float max_error) const;
+
+    // use 16 bits indices when every vertex can be addressed with them (less bandwidth),
+    // 32 bits otherwise or when @force_32_bits is set
+    void select_index_width(bool force_32_bits = false);
+
+    // select the GPU vertex layout. The packed one leaves the uvs out when they are all the
+    // same (they become a constant attribute, see uv_constant())
+    void select_vertex_format(VertexFormat format = VERTEX_PACKED, bool quantize_positions = true);
+
+    // bytes per vertex on the GPU
+    unsigned int vertex_stride() const;
+
+    // interleave the vertices for VERTEX_PACKED, in this order :
+    // - positions : 4 x unorm16 relative to bounding_box (quantized_positions) or 3 x float
+    // - normals   : 2 x snorm16, octahedral encoding
+    // - uvs       : 2 x unorm16 (packed_uvs only, atlas coordinates are in [0, 1])
+    // - baked     : 4 x unorm8, thickness, occlusion then 0 (1 when they weren't baked)
+    void pack_vertices(std::vector<unsigned char> & buffer) const;
+
+    // model space position = position_offset() + packed position * position_scale()
+    glm::vec3 position_offset() const;
+    glm::vec3 position_scale() const;
+
+    // uv of every vertex when they are not packed
+    glm::vec2 uv_constant() const { return indexed_uvs.empty() ? glm::vec2(0.0f) : indexed_uvs[0]; }
+
+    // bytes allocated by the attributes, indices, adjacency and BVH of the mesh
+    std::size_t memory_usage() const;
+
+    // copy the indices then the lod_indices with index_width bytes each, ready to be uploaded
+    // in an element buffer
+    void pack_indices(std::vector<unsigned char> & buffer) const;
 
 private:
 
-    // compute normals for each triangles and stock in triangle_normals
+    // compute normal and area of each triangle of the flat @triangles array (SIMD, in parallel)
     void compute_triangle_normals ( const std::vector<glm::vec3> & vertices,
-                                    const std::vector<std::vector<unsigned short> > & triangles,
-                                    std::vector<glm::vec3> & triangle_normals);
+                                    const std::vector<unsigned int> & triangles,
+                                    std::vector<glm::vec3> & triangle_normals,
+                                    std::vector<float> & triangle_areas);
 
     // compute normals for each vertex depending on weight_type criteria
-    // and stock in vertex_normals
+    // and stock in vertex_normals, in parallel over the vertices
     // @weight_type : 0 for uniform, 1 for area of triangles, 2 for angle of triangle
     void compute_smooth_vertex_normals (const std::vector<glm::vec3> & vertices,
-                                        const std::vector<std::vector<unsigned short> > & triangles,
+                                        const std::vector<unsigned int> & triangles,
+                                        const std::vector<glm::vec3> & triangle_normals,
+                                        const std::vector<float> & triangle_areas,
+                                        const MeshAdjacency & adjacency,
                                         unsigned int weight_type,
                                         std::vector<glm::vec3> & vertex_normals);
 
-    // create a list of numbers of vertices around each one
+    // create a list of numbers of vertices around each one (sorted, see adjacency() for the compact form)
     void collect_one_ring ( const std::vector<glm::vec3> & vertices,
-                            const std::vector<std::vector<unsigned short> > & triangles,
-                            std::vector<std::vector<unsigned short> > & one_ring) ;
+                            const std::vector<unsigned int> & triangles,
+                            std::vector<std::vector<unsigned int> > & one_ring) ;
 
     // load file of format OFF with given filename
     bool load_OFF_file (const std::string & filename, std::vector< glm::vec3 > & vertices,
-                        std::vector< glm::vec3 > & normals, std::vector< unsigned short > & indices,
-                        std::vector< std::vector<unsigned short > > & triangles, glm::vec2 & xpos,
-                        glm::vec2 & ypos, glm::vec2 & zpos);
+                        std::vector< glm::vec3 > & normals, std::vector< unsigned int > & indices,
+                        glm::vec2 & xpos, glm::vec2 & ypos, glm::vec2 & zpos);
+
+    // binary cache files that may hold the mesh of @filename, by order of preference
+    static std::vector<std::string> binary_cache_paths(const std::string & filename);
+
+    // load the binary cache @filename if it was written from the current version of @source
+    bool load_OFFB_file(const std::string & filename, const std::string & source);
+
+    // write the mesh into the binary cache @filename, stamped with the size and time of @source
+    bool save_OFFB_file(const std::string & filename, const std::string & source) const;
+
+    // Tipsify triangle order, @clusters receives the first triangle of each overdraw cluster
+    void optimize_vertex_cache(unsigned int cache_size, std::vector<unsigned int> & clusters);
+
+    // sort the clusters so the ones facing away from the mesh center are drawn first
+    void optimize_overdraw(const std::vector<unsigned int> & clusters);
+
+    // renumber the vertices in order of first use and permute every vertex attribute
+    void optimize_vertex_fetch();
 
     // calculate plane equation using 3 vertices
     glm::vec4 equation_plane(float x1, float y1, float z1,
                              float x2, float y2, float z2,
-                             float x3, float y3, float z3);
+                             float x3, float y3, float z3) const;
+
+    MeshAdjacency vertex_adjacency;
+    MeshBVH triangle_bvh;
 };
 
 #endif
@@ -0,0 +1,38 @@
+#ifndef MESHADJACENCY_HPP
+#define MESHADJACENCY_HPP
+
+// Include standard headers
+#include <cstddef>
+#include <vector>
+
+// vertex -> vertex and vertex -> triangle adjacency of a triangle mesh, stored as
+// compressed sparse rows (one offset array + one flat array per relation)
+//
+// neighbours of v : neighbors[neighbor_offsets[v] .. neighbor_offsets[v+1]]  (sorted, unique)
+// corners of v    : corners[corner_offsets[v] .. corner_offsets[v+1]]        (sorted)
+//
+// a corner is a position in the index array : it belongs to triangle corner / 3
+class MeshAdjacency {
+public:
+    // build both relations from a flat triangle index array, in parallel
+    void build(std::size_t numberOfVertices, const std::vector<unsigned int> & triangles);
+
+    void clear();
+    bool empty() const { return corner_offsets.empty(); }
+
+    std::size_t getNumberOfVertices() const { return corner_offsets.empty() ? 0 : corner_offsets.size() - 1; }
+
+    // number of distinct neighbours of @v
+    unsigned int valence(std::size_t v) const { return neighbor_offsets[v + 1] - neighbor_offsets[v]; }
+
+    const unsigned int * neighbors_begin(std::size_t v) const { return neighbors.data() + neighbor_offsets[v]; }
+    const unsigned int * neighbors_end(std::size_t v) const { return neighbors.data() + neighbor_offsets[v + 1]; }
+
+    const unsigned int * corners_begin(std::size_t v) const { return corners.data() + corner_offsets[v]; }
+    const unsigned int * corners_end(std::size_t v) const { return corners.data() + corner_offsets[v + 1]; }
+
+    std::vector<unsigned int> neighbor_offsets, neighbors;
+    std::vector<unsigned int> corner_offsets, corners;
+};
+
+#endif //MESHADJACENCY_HPP
@@ -0,0 +1,91 @@
+#ifndef MESHASSET_HPP
+#define MESHASSET_HPP
+
+// Include standard headers
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Include Glad
+#include <glad/glad.h>
+
+#include "Mesh.hpp"
+
+// one mesh on the CPU and its buffers / vertex array on the GPU, shared by every renderer
+// that draws it. GL objects are deleted with the last handle, so handles must be released
+// while the context is still current.
+class MeshAsset {
+public:
+    // upload @mesh (needs a current GL context)
+    explicit MeshAsset(std::shared_ptr<Mesh> mesh);
+    MeshAsset(const MeshAsset &) = delete;
+    MeshAsset & operator=(const MeshAsset &) = delete;
+    // destructor
+    ~MeshAsset();
+
+    // re-upload every attribute and the indices after the mesh changed
+    void updateBuffers();
+
+    // re-upload the indices with 32 bits even if 16 bits would fit (for comparisons)
+    void forceIndexWidth(bool force_32_bits);
+
+    // re-upload the vertices in another layout (see Mesh::select_vertex_format)
+    void setVertexFormat(VertexFormat format, bool quantize_positions = true);
+
+    // point the attributes 0 (positions), 1 (uvs), 2 (normals), 3 (thickness) and 4 (occlusion) and
+    // the element buffer of the bound vertex array to the buffers of the asset, in the layout of the mesh
+    void setupVertexAttributes() const;
+
+    // changes whenever the attribute layout changes : vertex arrays made with
+    // setupVertexAttributes() must then be set up again
+    unsigned int getLayoutVersion() const { return layoutVersion; }
+
+    // bytes held by the mesh on the CPU and by the buffers on the GPU
+    std::size_t getCpuBytes() const { return mesh->memory_usage(); }
+    std::size_t getGpuBytes() const { return gpuBytes; }
+
+    std::shared_ptr<Mesh> mesh;
+
+    GLuint VertexArrayID = 0;
+    GLuint vertexbuffer = 0;
+    GLuint uvbuffer = 0;
+    GLuint normalbuffer = 0;
+    GLuint bakedbuffer = 0;
+    GLuint elementbuffer = 0;
+    GLenum indexType = GL_UNSIGNED_SHORT;
+
+private:
+    // upload indices in the width selected by the mesh
+    void uploadIndices();
+
+    std::size_t gpuBytes = 0;
+    unsigned int layoutVersion = 0;
+};
+
+// mesh assets by path. The cache only keeps weak references : an asset lives as long as a
+// renderer holds it, and a path loaded again while it is alive returns the same asset.
+class MeshAssetCache {
+public:
+    // asset of @path, created from @mesh if it isn't alive (@mesh is ignored otherwise)
+    static std::shared_ptr<MeshAsset> acquire(const std::string & path, std::shared_ptr<Mesh> mesh);
+
+    // asset of @path, loaded synchronously if it isn't alive
+    static std::shared_ptr<MeshAsset> acquire(const std::string & path);
+
+    // live asset of @path or null
+    static std::shared_ptr<MeshAsset> find(const std::string & path);
+
+    // print the assets alive, their handles and memory, with what unshared copies would take
+    static void report(std::ostream & out);
+
+    // CPU + GPU bytes of the assets alive, and what one copy per handle would take
+    static void memory_usage(std::size_t & shared, std::size_t & unshared);
+
+private:
+    static std::mutex mutex;
+    static std::unordered_map<std::string, std::weak_ptr<MeshAsset> > assets;
+};
+
+#endif //MESHASSET_HPP
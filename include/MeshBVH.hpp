@@ -0,0 +1,83 @@
+#ifndef MESHBVH_HPP
+#define MESHBVH_HPP
+
+// Include standard headers
+#include <cfloat>
+#include <cstddef>
+#include <iostream>
+#include <vector>
+
+// Include GLM
+#include <glm.hpp>
+
+// ray from @origin along @direction (any length), hits are searched for t in [tmin, tmax]
+struct Ray {
+    glm::vec3 origin;
+    glm::vec3 direction;
+    float tmin = 0.0f;
+    float tmax = FLT_MAX;
+};
+
+const unsigned int NO_HIT = ~0u;
+
+// closest hit : point = origin + t * direction = (1 - u - v) P0 + u P1 + v P2 of @triangle
+// (index of the triangle in the array the BVH was built from, NO_HIT if none)
+struct RayHit {
+    float t = FLT_MAX;
+    unsigned int triangle = NO_HIT;
+    float u = 0.0f, v = 0.0f;
+};
+
+// bounding volume hierarchy over the triangles of a mesh, for ray queries on the CPU (picking,
+// thickness, ambient occlusion, baking). Triangles are two-sided.
+//
+// built top-down with the binned surface area heuristic (Wald 2007) : the upper levels bin their
+// triangles in parallel, the subtrees below them are then built in parallel, one per task.
+// The two children of a node are stored next to each other, leaves reference a range of a copy of
+// the triangles kept in leaf order (v0 and two edges) so traversal never goes through the indices.
+class MeshBVH {
+public:
+    // build over the flat triangle index array @triangles, in parallel
+    void build(const std::vector<glm::vec3> & vertices, const std::vector<unsigned int> & triangles);
+
+    void clear();
+    bool empty() const { return nodes.empty(); }
+
+    // closest hit of @ray, false if it hits nothing
+    bool intersect(const Ray & ray, RayHit & hit) const;
+
+    // true as soon as any hit is found (shadow, occlusion and thickness rays)
+    bool occluded(const Ray & ray) const;
+
+    // same queries for 4 rays at once (SSE when available) : nodes are tested and visited once
+    // for the whole packet, which pays off when the rays are coherent (neighbouring pixels,
+    // samples of one texel)
+    void intersect4(const Ray rays[4], RayHit hits[4]) const;
+    void occluded4(const Ray rays[4], bool occluded[4]) const;
+
+    std::size_t getNumberOfNodes() const { return nodes.size(); }
+    std::size_t memory_usage() const;
+
+    // Mrays/s of every query on camera rays (coherent) and random rays through the bounds
+    // (incoherent), on the calling thread
+    void benchmark(std::ostream & out) const;
+
+private:
+    // inner node : count == 0 and children first, first + 1 ; leaf : triangles [first, first + count)
+    struct Node {
+        glm::vec3 min;
+        unsigned int first;
+        glm::vec3 max;
+        unsigned int count;
+    };
+
+    struct Triangle {
+        glm::vec3 v0, e1, e2;
+        unsigned int id;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<Triangle> leafTriangles;
+};
+
+#endif //MESHBVH_HPP
@@ -0,0 +1,47 @@
+#ifndef MESHLOADER_HPP
+#define MESHLOADER_HPP
+
+// Include standard headers
+#include <future>
+#include <memory>
+#include <string>
+
+#include "Mesh.hpp"
+
+// load a mesh on a worker thread : parsing, normals, GPU reordering and levels of detail
+// run in the background while the render thread keeps drawing frames. The render thread
+// polls ready() and does the GL upload itself once the mesh is there.
+class MeshLoader {
+public:
+    // constructors
+    MeshLoader() = default;
+    explicit MeshLoader(const std::string & filename) { load(filename); }
+    MeshLoader(const MeshLoader &) = delete;
+    MeshLoader & operator=(const MeshLoader &) = delete;
+
+    // start loading @filename, a load still running is waited for first
+    void load(const std::string & filename);
+
+    // true once the worker finished, with a mesh or not (never blocks)
+    bool ready();
+
+    // true if the worker finished without a usable mesh (missing or invalid file, exception)
+    bool failed() { return ready() && (!mesh || mesh->indices.empty()); }
+
+    // loaded mesh, null until ready()
+    std::shared_ptr<Mesh> get() { return ready() ? mesh : nullptr; }
+
+    const std::string & getFilename() const { return filename; }
+
+    // time spent in the worker
+    double getMilliseconds() const { return milliseconds; }
+
+private:
+    std::string filename;
+    std::future<std::shared_ptr<Mesh> > pending;
+    std::shared_ptr<Mesh> mesh;
+    bool finished = false;
+    double milliseconds = 0.0;
+};
+
+#endif //MESHLOADER_HPP
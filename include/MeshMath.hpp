@@ -0,0 +1,21 @@
+#ifndef MESHMATH_HPP
+#define MESHMATH_HPP
+
+// Include standard headers
+#include <cmath>
+
+// Include GLM
+#include <glm.hpp>
+
+// orthonormal basis @t, @b around the unit vector @n (Duff et al. 2017), without the
+// singularity of the cross product methods
+inline void basis(const glm::vec3 & n, glm::vec3 & t, glm::vec3 & b)
+{
+    float sign = std::copysign(1.0f, n.z);
+    float a = -1.0f / (sign + n.z);
+    float c = n.x * n.y * a;
+    t = glm::vec3(1.0f + sign * n.x * n.x * a, sign * c, -sign * n.x);
+    b = glm::vec3(c, sign + n.y * n.y * a, -n.y);
+}
+
+#endif //MESHMATH_HPP
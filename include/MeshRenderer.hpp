@@ -25,31 +25,77 @@
 
 #include "Shader.hpp"
 #include "Mesh.hpp"
+#include "MeshAsset.hpp"
 #include "LightSource.hpp"
+#include "UniformRing.hpp"
 extern unsigned int SCR_WIDTH;
 extern unsigned int SCR_HEIGHT;
 
+// one copy of the mesh in an instanced draw
+struct MeshInstance {
+    glm::mat4 model;
+    glm::vec3 color;
+};
+
 class MeshRenderer {
 public:
     // constructor
     MeshRenderer() = default;
-    MeshRenderer(unsigned int shaderID, unsigned int depthShaderID, Mesh& mesh);
+    MeshRenderer(unsigned int shaderID, unsigned int depthShaderID, std::shared_ptr<MeshAsset> asset);
     
     // destructor
     ~MeshRenderer();
 
+    // ring the per-object uniform blocks are written to (the per-frame block is bound by the
+    // application before the draws)
+    static void setUniformRing(UniformRing * ring) { uniformRing = ring; }
+
+    // height in pixels of the viewport the 3D pass renders into (the render scale of
+    // RenderTargets), for the automatic level of detail ; the window height until set
+    static void setViewportHeight(int height) { viewportHeight = height; }
+
     // draw mesh
     void draw(unsigned int ShaderID, Camera & camera, LightSource & lightPosition) ;
 
+    // draw every instance with glDrawElementsInstanced. Instances are grouped by level of detail
+    // and by winding (mirrored ones have a negative determinant and need clockwise front faces),
+    // one draw per group. Per-instance data is streamed to the instance buffer on every call.
+    void drawInstanced(unsigned int ShaderID, Camera & camera, LightSource & light, const std::vector<MeshInstance> & instances);
+
+    // number of draw calls of the last drawInstanced
+    unsigned int getNumberOfInstancedDraws() const { return instancedDraws; }
+
     // get depth map from light
     void createDepthMapFromLight(LightSource & light) const;
 
     // get depth map from eye
     void createDepthMapFromEye(Camera &eye);
 
-    // update mesh's vertices
+    // update mesh's vertices (shared : every renderer of the asset sees the change)
     void updateBuffers();
 
+    // re-upload the indices with 32 bits even if 16 bits would fit (for comparisons)
+    void forceIndexWidth(bool force_32_bits);
+
+    // re-upload the vertices in another layout (shared with every renderer of the asset)
+    void setVertexFormat(VertexFormat format) { asset->setVertexFormat(format); }
+    unsigned int getVertexStride() const { return asset->mesh->vertex_stride(); }
+
+    // width of the indices currently in the element buffer
+    IndexWidth getIndexWidth() const { return asset->mesh->index_width; }
+    unsigned int getNumberOfTriangles() const { return asset->mesh->getNumberOfTriangles(); }
+
+    const std::shared_ptr<MeshAsset> & getAsset() const { return asset; }
+
+    // pick the level of detail every frame from the projected error (else always the full mesh)
+    void setAutomaticLod(bool enabled) { automaticLod = enabled; }
+    // level of detail and number of triangles of the last draw
+    unsigned int getCurrentLod() const { return currentLod; }
+    unsigned int getNumberOfDrawnTriangles() const { return drawCount / 3; }
+
+    const glm::mat4 & getModel() const { return model; }
+    void setModel(const glm::mat4 & m) { model = m; }
+
     // set model to shader
     void setModelRotation(glm::vec3 rotation) {
         model = glm::rotate(model, (float) rotation.x, glm::vec3(1.0,0.0,0.0));
@@ -73,35 +119,52 @@ public:
         color = c;
     }
 
-    void setModelColor(unsigned int shaderID, glm::vec3 c){
-        color = c;
-        glUseProgram(shaderID);
-        glUniform3f(glGetUniformLocation(shaderID, "color"), color.x, color.y, color.z);
-        glUseProgram(0);
-    }
 
 
-    // clean all vao / vbo / shader
+    // release the mesh asset (its vao / vbo go with the last renderer) and delete the shaders
     void cleanUp();
 
 
 private:
 
-    GLuint VertexArrayID;
+    // coarsest level of detail whose error covers less than lodPixelError pixels on screen
+    unsigned int selectLod(const Camera & camera, const glm::mat4 & transform) const;
+
+    // vertex array of the instanced draws : the buffers of the asset plus the instance buffer
+    // (set up again when the layout of the asset changes)
+    void createInstanceArray();
+
+    // object block of a draw : @transform, @c and the vertex format of the asset
+    ObjectUniforms objectUniforms(const glm::mat4 & transform, const glm::vec3 & c) const;
+
+    // attributes of an instance in the instance buffer (locations 8 to 11 and 15, divisor 1)
+    struct InstanceAttributes {
+        glm::mat4 model;
+        glm::vec3 color;
+    };
+
+    static UniformRing * uniformRing;
+    static int viewportHeight;
+
     GLuint programID, depthProgramID;
-    
-    GLuint MatrixID, ViewMatrixID, ModelMatrixID;
-    GLuint LightID;
-    
-    GLuint vertexbuffer;
-    GLuint uvbuffer;
-    GLuint normalbuffer;
-    GLuint elementbuffer;
+
+    bool automaticLod = true;
+    float lodPixelError = 1.0f;
+    unsigned int currentLod = 0;
+    unsigned int drawCount = 0;
+
+    GLuint instanceVertexArrayID = 0;
+    GLuint instancebuffer = 0;
+    std::size_t instanceCapacity = 0;
+    unsigned int instanceLayout = 0;
+    std::vector<InstanceAttributes> instanceAttributes;
+    std::vector<unsigned int> instanceGroups;
+    unsigned int instancedDraws = 0;
 
     glm::mat4 model;
     glm::vec3 color;
 
-    // mesh to be rendered
-    Mesh tridimodel;
+    // mesh to be rendered, with its buffers
+    std::shared_ptr<MeshAsset> asset;
 };
 #endif
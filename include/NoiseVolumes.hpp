@@ -0,0 +1,64 @@
+#ifndef NOISEVOLUMES_HPP
+#define NOISEVOLUMES_HPP
+
+// Include standard headers
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <vector>
+
+// Include Glad
+#include <glad/glad.h>
+
+// the noise fields of the skin shader baked in tileable 3D textures (SKIN_NOISE_TEXTURES) :
+// - FBMNoise3D6 over FBM_TILE units, the analytic values inside the tile (SkinNoise::fbmTiled)
+// - snoise over SIMPLEX_TILE units, made tileable by blending the 8 copies shifted by a tile
+//   with weights that keep its variance
+// The texels are computed on CPU threads at startup with the SIMD noise, the render thread
+// uploads them and builds the mipmaps once the bake is done. The tiles and texture units are
+// repeated in fragment_shader.glsl.
+class NoiseVolumes {
+public:
+    static const int SIZE = 128;            // texels along each axis
+    static constexpr float FBM_TILE = 50.0f;
+    static constexpr float SIMPLEX_TILE = 16.0f;
+    static const GLuint FBM_UNIT = 3;       // texture units (layout(binding = ...) in the shader),
+    static const GLuint SIMPLEX_UNIT = 4;   // 1, 2, 6 and 7 belong to the post-processing (GodRays.hpp)
+
+    NoiseVolumes() = default;
+    NoiseVolumes(const NoiseVolumes &) = delete;
+    NoiseVolumes & operator=(const NoiseVolumes &) = delete;
+
+    // start the bake on worker threads, returns at once
+    void bake(int size = SIZE);
+
+    // upload the textures once the bake is done (needs a current GL context), never blocks ;
+    // true when the textures are there
+    bool update();
+    bool ready() const { return fbmTexture != 0; }
+
+    // bind the textures to their units
+    void bind() const;
+
+    void destroy();
+
+    // time spent baking on the CPU, bytes of the textures with their mipmaps
+    double getBakeMilliseconds() const { return milliseconds; }
+    std::size_t getGpuBytes() const;
+
+private:
+    struct Texels {
+        int size = 0;
+        std::vector<std::uint8_t> fbm;     // unorm8
+        std::vector<std::int8_t> simplex;  // snorm8
+        double milliseconds = 0.0;
+    };
+    static Texels compute(int size);
+
+    std::future<Texels> pending;
+    GLuint fbmTexture = 0, simplexTexture = 0;
+    int size = 0;
+    double milliseconds = 0.0;
+};
+
+#endif //NOISEVOLUMES_HPP
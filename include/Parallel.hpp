@@ -0,0 +1,126 @@
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+// Include standard headers
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// number of worker threads used by the parallel loops (never 0)
+inline unsigned int worker_count()
+{
+    unsigned int n = std::thread::hardware_concurrency();
+    return n == 0 ? 1 : n;
+}
+
+// split [begin, end) in chunks of at least @grain elements and run
+// fn(first, last) on them from several threads, the caller included.
+// chunks are claimed dynamically so uneven chunks do not stall the loop.
+template <typename Function>
+void parallel_for(std::size_t begin, std::size_t end, std::size_t grain, Function && fn)
+{
+    if (end <= begin) return;
+    grain = std::max<std::size_t>(grain, 1);
+
+    const std::size_t count = end - begin;
+    const std::size_t chunks = (count + grain - 1) / grain;
+    const std::size_t threads = std::min<std::size_t>(worker_count(), chunks);
+    if (threads <= 1)
+    {
+        fn(begin, end);
+        return;
+    }
+
+    std::atomic<std::size_t> next(0);
+    auto worker = [&]() {
+        for (std::size_t c = next.fetch_add(1); c < chunks; c = next.fetch_add(1))
+        {
+            std::size_t first = begin + c * grain;
+            fn(first, std::min(first + grain, end));
+        }
+    };
+
+    std::vector<std::thread> pool;
+    pool.reserve(threads - 1);
+    for (std::size_t t = 1; t < threads; ++t) pool.emplace_back(worker);
+    worker();
+    for (auto & thread : pool) thread.join();
+}
+
+// same contract as parallel_for, with work stealing : every thread starts on its own contiguous
+// share of the chunks and takes them from the front, a thread that runs out steals the back half
+// of the share of another one. Neighbouring chunks stay on one thread (warm caches, coherent
+// rays) and uneven chunks still balance. @threads = 0 uses worker_count() threads.
+template <typename Function>
+void parallel_for_stealing(std::size_t begin, std::size_t end, std::size_t grain, Function && fn,
+                           unsigned int threads = 0)
+{
+    if (end <= begin) return;
+    grain = std::max<std::size_t>(grain, 1);
+
+    const std::size_t count = end - begin;
+    const std::size_t chunks = (count + grain - 1) / grain;
+    threads = unsigned(std::min<std::size_t>(threads == 0 ? worker_count() : threads, chunks));
+    if (threads <= 1)
+    {
+        fn(begin, end);
+        return;
+    }
+
+    // chunks [first, last) still to run by each thread
+    struct Share {
+        std::mutex mutex;
+        std::size_t first = 0, last = 0;
+    };
+    std::vector<Share> shares(threads);
+    for (unsigned int t = 0; t < threads; ++t)
+    {
+        shares[t].first = chunks * t / threads;
+        shares[t].last = chunks * (t + 1) / threads;
+    }
+
+    auto worker = [&](unsigned int self) {
+        Share & own = shares[self];
+        for (;;)
+        {
+            std::size_t chunk = chunks;
+            {
+                std::lock_guard<std::mutex> lock(own.mutex);
+                if (own.first < own.last) chunk = own.first++;
+            }
+            if (chunk == chunks)
+            {
+                // steal from the next threads in turn, stop when every share is empty
+                std::size_t stolenFirst = 0, stolenLast = 0;
+                for (unsigned int k = 1; k < threads && stolenFirst == stolenLast; ++k)
+                {
+                    Share & victim = shares[(self + k) % threads];
+                    std::lock_guard<std::mutex> lock(victim.mutex);
+                    std::size_t left = victim.last - victim.first;
+                    if (left == 0) continue;
+                    stolenLast = victim.last;
+                    stolenFirst = victim.last - (left + 1) / 2;
+                    victim.last = stolenFirst;
+                }
+                if (stolenFirst == stolenLast) return;
+                std::lock_guard<std::mutex> lock(own.mutex);
+                own.first = stolenFirst + 1;
+                own.last = stolenLast;
+                chunk = stolenFirst;
+            }
+            std::size_t first = begin + chunk * grain;
+            fn(first, std::min(first + grain, end));
+        }
+    };
+
+    std::vector<std::thread> pool;
+    pool.reserve(threads - 1);
+    for (unsigned int t = 1; t < threads; ++t) pool.emplace_back(worker, t);
+    worker(0);
+    for (auto & thread : pool) thread.join();
+}
+
+#endif //PARALLEL_HPP
@@ -0,0 +1,57 @@
+#ifndef RENDERTARGETS_HPP
+#define RENDERTARGETS_HPP
+
+// Include Glad
+#include <glad/glad.h>
+
+// Include GLM
+#include <glm.hpp>
+
+// the offscreen framebuffer of the 3D pass : scene colour and light mask (RGBA16F) and depth /
+// stencil (a texture, read by the god rays). The textures have the size of the window and are
+// allocated again when it changes ; the 3D pass renders into the bottom left corner scaled by
+// the render scale (DynamicResolution.hpp), which only changes the viewport : no reallocation
+// while the resolution adapts. Passes reading the textures scale their coordinates by
+// getUvScale().
+class RenderTargets
+{
+public:
+    RenderTargets() = default;
+    RenderTargets(const RenderTargets &) = delete;
+    RenderTargets & operator=(const RenderTargets &) = delete;
+
+    // textures of @width x @height (needs a current GL context), nothing when the size is the
+    // same or empty (minimised window) ; true when they were allocated
+    bool resize(int width, int height);
+
+    // fraction of the size the 3D pass renders at, in ]0, 1]
+    void setRenderScale(float scale);
+    float getRenderScale() const { return renderScale; }
+
+    // bind the framebuffer with the viewport of the render scale
+    void bind() const;
+
+    GLuint getFramebuffer() const { return framebuffer; }
+    GLuint getColor() const { return color; }
+    GLuint getMask() const { return mask; }
+    GLuint getDepth() const { return depth; }
+
+    // allocated size, part the 3D pass renders into, and that part in texture coordinates
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    int getRenderWidth() const { return renderWidth; }
+    int getRenderHeight() const { return renderHeight; }
+    glm::vec2 getUvScale() const;
+
+    void destroy();
+
+private:
+    void updateRenderSize();
+
+    GLuint framebuffer = 0, color = 0, mask = 0, depth = 0;
+    int width = 0, height = 0;
+    int renderWidth = 0, renderHeight = 0;
+    float renderScale = 1.0f;
+};
+
+#endif //RENDERTARGETS_HPP
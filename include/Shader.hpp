@@ -5,6 +5,13 @@
 #include <glm.hpp>
 
 #include <string>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <iomanip>
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -21,6 +28,7 @@ public:
 	}
 
     Shader(const char* computePath){
+        auto start = std::chrono::steady_clock::now();
         std::string computeCode;
         std::ifstream cShaderFile;
         cShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
@@ -38,6 +46,9 @@ public:
         catch (std::ifstream::failure e){
             std::cout << "ERROR::COMPUTE-SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
         }
+        // linked before by the same driver : no compilation
+        const std::string binaryPath = binaryCachePath({computeCode});
+        if (loadProgramBinary(binaryPath)) { programBuilt(start, true); return; }
         const char * cShaderCode = computeCode.c_str();
         // compile shaders
         unsigned int compute;
@@ -48,11 +59,14 @@ public:
         checkCompileErrors(compute, "COMPUTE");
         // shader Program
         ID = glCreateProgram();
+        glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
         glAttachShader(ID, compute);
         glLinkProgram(ID);
         checkCompileErrors(ID, "PROGRAM");
+        saveProgramBinary(binaryPath);
         // delete the shaders as they're linked into our program now and no longer necessery
         glDeleteShader(compute);
+        programBuilt(start, false);
     }
 
     unsigned int generateComputeTexture(int tex_w, int tex_h, unsigned int layout = 0){
@@ -67,9 +81,17 @@ public:
         return tex_norm;
     }
 
+	// variant of a program : every stage is compiled with @defines ("NAME" or "NAME VALUE")
+	Shader(const char* vertexPath, const char* fragmentPath, const std::vector<std::string> & defines)
+		: Shader(vertexPath, fragmentPath, nullptr, nullptr, nullptr, defines)
+	{
+	}
+
 	//Shader(const char* vertexPath, const char* fragmentPath, const char * geometryPath = nullptr, const char * tessControlPath = nullptr, const char * tessEvalPath = nullptr);
-	Shader(const char* vertexPath, const char* fragmentPath, const char * geometryPath = nullptr, const char * tessControlPath = nullptr, const char * tessEvalPath = nullptr)
+	Shader(const char* vertexPath, const char* fragmentPath, const char * geometryPath = nullptr, const char * tessControlPath = nullptr, const char * tessEvalPath = nullptr,
+	       const std::vector<std::string> & defines = std::vector<std::string>())
 	{
+		auto start = std::chrono::steady_clock::now();
 		// 1. retrieve the vertex/fragment source code from filePath
 		std::string vertexCode;
 		std::string tessControlCode;
@@ -120,6 +142,17 @@ public:
 		{
 			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << e.what() << std::endl;
 		}
+		if (!defines.empty())
+		{
+			vertexCode = injectDefines(vertexCode, defines);
+			if (tessControlPath != nullptr) tessControlCode = injectDefines(tessControlCode, defines);
+			if (tessEvalPath != nullptr) tessEvalCode = injectDefines(tessEvalCode, defines);
+			if (geometryPath != nullptr) geometryCode = injectDefines(geometryCode, defines);
+			fragmentCode = injectDefines(fragmentCode, defines);
+		}
+		// linked before by the same driver : no compilation
+		const std::string binaryPath = binaryCachePath({vertexCode, tessControlCode, tessEvalCode, geometryCode, fragmentCode});
+		if (loadProgramBinary(binaryPath)) { programBuilt(start, true); return; }
 		const char * vShaderCode = vertexCode.c_str();
 		const char *gShaderCode, *tcShaderCode, *teShaderCode;
 		if (tessControlPath != nullptr) tcShaderCode = tessControlCode.c_str();
@@ -162,6 +195,7 @@ public:
 
 		// shader Program
 		ID = glCreateProgram();
+		glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 		glAttachShader(ID, vertex);
 		if (tessControlPath != nullptr) glAttachShader(ID, tessC);
 		if (tessEvalPath != nullptr) glAttachShader(ID, tessE);
@@ -169,12 +203,14 @@ public:
 		glAttachShader(ID, fragment);
 		glLinkProgram(ID);
 		checkCompileErrors(ID, "PROGRAM");
+		saveProgramBinary(binaryPath);
 		// delete the shaders as they're linked into our program now and no longer necessery
 		glDeleteShader(vertex);
 		if (tessControlPath != nullptr) glDeleteShader(tessC);
 		if (tessEvalPath != nullptr) glDeleteShader(tessE);
 		if (geometryPath != nullptr) glDeleteShader(geometry);
 		glDeleteShader(fragment);
+		programBuilt(start, false);
 	}
 
 	~Shader()
@@ -187,74 +223,255 @@ public:
         glUseProgram(0);
     }
     
+	// programs built so far and how many came from the binary cache (cold start : none)
+	// ------------------------------------------------------------------------
+	static void report(std::ostream & out)
+	{
+		out << "Shaders : " << statistics().programs << " programs in " << statistics().milliseconds << " ms ("
+		    << statistics().fromCache << " from the binary cache)" << std::endl;
+	}
 	// activate the shader
 	// ------------------------------------------------------------------------
 	void use() const
 	{
 		glUseProgram(ID);
 	}
+	// location of a uniform, looked up at link time (-1 if the program doesn't use it)
+	// ------------------------------------------------------------------------
+	GLint getUniformLocation(const std::string &name) const
+	{
+		auto it = uniformLocations.find(name);
+		return (it != uniformLocations.end()) ? it->second : -1;
+	}
 	// utility uniform functions
 	// ------------------------------------------------------------------------
 	void setBool(const std::string &name, bool value) const
 	{
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+		glUniform1i(getUniformLocation(name), (int)value);
 	}
 	// ------------------------------------------------------------------------
 	void setInt(const std::string &name, int value) const
 	{
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+		glUniform1i(getUniformLocation(name), value);
 	}
 	// ------------------------------------------------------------------------
 	void setFloat(const std::string &name, float value) const
 	{
-		glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+		glUniform1f(getUniformLocation(name), value);
 	}
 	// ------------------------------------------------------------------------
 	void setVec2(const std::string &name, const glm::vec2 &value) const
 	{
-		glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+		glUniform2fv(getUniformLocation(name), 1, &value[0]);
 	}
 	void setVec2(const std::string &name, float x, float y) const
 	{
-		glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+		glUniform2f(getUniformLocation(name), x, y);
+	}
+	void setIVec2(const std::string &name, const glm::ivec2 &value) const
+	{
+		glUniform2iv(getUniformLocation(name), 1, &value[0]);
 	}
 	// ------------------------------------------------------------------------
 	void setVec3(const std::string &name, const glm::vec3 &value) const
 	{
-		glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+		glUniform3fv(getUniformLocation(name), 1, &value[0]);
 	}
 	void setVec3(const std::string &name, float x, float y, float z) const
 	{
-		glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+		glUniform3f(getUniformLocation(name), x, y, z);
 	}
 	// ------------------------------------------------------------------------
 	void setVec4(const std::string &name, const glm::vec4 &value) const
 	{
-		glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+		glUniform4fv(getUniformLocation(name), 1, &value[0]);
 	}
 	void setVec4(const std::string &name, float x, float y, float z, float w) const
 	{
-		glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+		glUniform4f(getUniformLocation(name), x, y, z, w);
 	}
 	// ------------------------------------------------------------------------
 	void setMat2(const std::string &name, const glm::mat2 &mat) const
 	{
-		glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+		glUniformMatrix2fv(getUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
 	}
 	// ------------------------------------------------------------------------
 	void setMat3(const std::string &name, const glm::mat3 &mat) const
 	{
-		glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+		glUniformMatrix3fv(getUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
 	}
 	// ------------------------------------------------------------------------
 	void setMat4(const std::string &name, const glm::mat4 &mat) const
 	{
-		glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+		glUniformMatrix4fv(getUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
 	}
 
 
 
 private:
+	// locations of the active uniforms, so that the setters never ask the driver
+	std::unordered_map<std::string, GLint> uniformLocations;
+
+	struct Statistics {
+		unsigned int programs = 0;
+		unsigned int fromCache = 0;
+		double milliseconds = 0.0;
+	};
+	static Statistics & statistics()
+	{
+		static Statistics stats;
+		return stats;
+	}
+
+	// a program is ready : cache its uniforms and account for the time it took
+	// ------------------------------------------------------------------------
+	void programBuilt(std::chrono::steady_clock::time_point start, bool fromCache)
+	{
+		cacheUniformLocations();
+		Statistics & stats = statistics();
+		++stats.programs;
+		if (fromCache) ++stats.fromCache;
+		stats.milliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// #define lines go right after #version (which must stay first), #line keeps the
+	// compiler messages on the line numbers of the file
+	// ------------------------------------------------------------------------
+	static std::string injectDefines(const std::string & code, const std::vector<std::string> & defines)
+	{
+		std::size_t version = code.find("#version");
+		std::size_t insert = (version == std::string::npos) ? 0 : code.find('\n', version);
+		if (insert == std::string::npos) insert = code.size();
+		else if (version != std::string::npos) ++insert;
+		const std::size_t line = 1 + std::count(code.begin(), code.begin() + insert, '\n');
+
+		std::string header;
+		for (const std::string & define : defines) header += "#define " + define + "\n";
+		header += "#line " + std::to_string(line) + "\n";
+		return code.substr(0, insert) + header + code.substr(insert);
+	}
+
+	// program binary cache
+	//
+	// linked programs are saved with glGetProgramBinary in <temp>/skin-texture-cache/shaders, the
+	// file name is a hash of the sources and of the driver strings : editing a shader or updating
+	// the driver gives a new name, and a binary the driver refuses falls back to compiling.
+	// file : magic | format (GLenum) | length (uint32) | binary
+	// ------------------------------------------------------------------------
+	static std::string binaryCachePath(const std::vector<std::string> & sources)
+	{
+		GLint formats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		std::error_code error;
+		std::filesystem::path directory = std::filesystem::temp_directory_path(error);
+		if (formats == 0 || error) return std::string();
+
+		// FNV-1a over the stages (separated, so moving code between stages changes the key)
+		std::uint64_t hash = 14695981039346656037ull;
+		auto add = [&hash](const std::string & text) {
+			for (unsigned char c : text) { hash ^= c; hash *= 1099511628211ull; }
+			hash ^= 0xff; hash *= 1099511628211ull;
+		};
+		for (const std::string & source : sources) add(source);
+		for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION})
+		{
+			const GLubyte * value = glGetString(name);
+			add(value != nullptr ? reinterpret_cast<const char *>(value) : "");
+		}
+
+		std::ostringstream file;
+		file << std::hex << std::setw(16) << std::setfill('0') << hash << ".glbin";
+		return (directory / "skin-texture-cache" / "shaders" / file.str()).string();
+	}
+
+	bool loadProgramBinary(const std::string & path)
+	{
+		if (path.empty()) return false;
+		std::ifstream file(path, std::ios::binary);
+		if (!file.is_open()) return false;
+
+		char magic[4] = {0, 0, 0, 0};
+		GLenum format = 0;
+		std::uint32_t length = 0;
+		file.read(magic, 4);
+		file.read(reinterpret_cast<char *>(&format), sizeof(format));
+		file.read(reinterpret_cast<char *>(&length), sizeof(length));
+		if (!file.good() || std::string(magic, 4) != "GLPB" || length == 0) return false;
+		std::vector<char> binary(length);
+		file.read(binary.data(), length);
+		if (!file.good()) return false;
+
+		ID = glCreateProgram();
+		glProgramBinary(ID, format, binary.data(), GLsizei(length));
+		GLint success = 0;
+		glGetProgramiv(ID, GL_LINK_STATUS, &success);
+		if (!success)
+		{
+			// another driver build : compile again, the new binary replaces this one
+			glDeleteProgram(ID);
+			ID = 0;
+			return false;
+		}
+		return true;
+	}
+
+	void saveProgramBinary(const std::string & path) const
+	{
+		GLint success = 0, length = 0;
+		glGetProgramiv(ID, GL_LINK_STATUS, &success);
+		glGetProgramiv(ID, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (path.empty() || !success || length <= 0) return;
+
+		std::vector<char> binary(std::size_t(length), 0);
+		GLenum format = 0;
+		glGetProgramBinary(ID, length, nullptr, &format, binary.data());
+
+		std::error_code error;
+		std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+		// write aside then rename, so another instance never reads a partial file
+		const std::string temporary = path + ".tmp";
+		{
+			std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+			if (!file.is_open()) return;
+			const std::uint32_t size = std::uint32_t(length);
+			file.write("GLPB", 4);
+			file.write(reinterpret_cast<const char *>(&format), sizeof(format));
+			file.write(reinterpret_cast<const char *>(&size), sizeof(size));
+			file.write(binary.data(), length);
+			if (!file.good())
+			{
+				file.close();
+				std::filesystem::remove(temporary, error);
+				return;
+			}
+		}
+		std::filesystem::rename(temporary, path, error);
+		if (error) std::filesystem::remove(temporary, error);
+	}
+
+	// fill uniformLocations after a successful link
+	// ------------------------------------------------------------------------
+	void cacheUniformLocations()
+	{
+		uniformLocations.clear();
+		GLint count = 0, maxLength = 0;
+		glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+		glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+		std::string name(std::size_t(std::max(maxLength, 1)), '\0');
+		for (GLint i = 0; i < count; ++i)
+		{
+			GLsizei length = 0; GLint size = 0; GLenum type = 0;
+			glGetActiveUniform(ID, GLuint(i), maxLength, &length, &size, &type, &name[0]);
+			std::string uniform = name.substr(0, std::size_t(length));
+			GLint location = glGetUniformLocation(ID, uniform.c_str());
+			if (location < 0) continue; // member of a uniform block
+			uniformLocations[uniform] = location;
+			// arrays are reported as "name[0]", make "name" work too
+			std::size_t bracket = uniform.find('[');
+			if (bracket != std::string::npos) uniformLocations[uniform.substr(0, bracket)] = location;
+		}
+	}
+
 	// utility function for checking shader compilation/linking errors.
 	// ------------------------------------------------------------------------
 	static void checkCompileErrors(GLuint shader, const std::string& type)
@@ -0,0 +1,73 @@
+#ifndef SHADERVARIANTS_HPP
+#define SHADERVARIANTS_HPP
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Shader.hpp"
+
+// features of the skin fragment shader that can be compiled out : a disabled feature costs
+// nothing per fragment instead of being computed and multiplied by zero
+struct SkinFeatures {
+    bool freckles = true;
+    bool thickness = true;  // subsurface scattering through the baked thickness (uniform otherwise)
+    int fbmOctaves = 6;     // octaves of the noise attenuating the subsurface light (1 to 6)
+    bool noiseTextures = true;  // noise sampled from the baked volumes (NoiseVolumes) instead of computed
+    bool bakedAlbedo = true;    // skin colour sampled from the atlas of the mesh (SkinAtlas) instead of computed
+
+    bool operator==(const SkinFeatures & other) const
+    {
+        return freckles == other.freckles && thickness == other.thickness && fbmOctaves == other.fbmOctaves
+            && noiseTextures == other.noiseTextures && bakedAlbedo == other.bakedAlbedo;
+    }
+    bool operator!=(const SkinFeatures & other) const { return !(*this == other); }
+
+    std::vector<std::string> defines() const
+    {
+        std::vector<std::string> result;
+        if (!freckles) result.push_back("SKIN_NO_FRECKLES");
+        if (!thickness) result.push_back("SKIN_NO_THICKNESS");
+        if (noiseTextures) result.push_back("SKIN_NOISE_TEXTURES");
+        // the octaves only matter to the computed noise
+        if (!noiseTextures && fbmOctaves != 6) result.push_back("SKIN_FBM_OCTAVES " + std::to_string(fbmOctaves));
+        if (bakedAlbedo) result.push_back("SKIN_BAKED_ALBEDO");
+        return result;
+    }
+};
+
+// one program per set of #defines, compiled the first time it is asked for and kept until
+// destruction (the program binary cache makes a variant cheap on the next launches)
+class ShaderVariants
+{
+public:
+    ShaderVariants(std::string vertexPath, std::string fragmentPath)
+        : vertexPath(std::move(vertexPath)), fragmentPath(std::move(fragmentPath))
+    {
+    }
+
+    const Shader & get(const std::vector<std::string> & defines)
+    {
+        std::string key;
+        for (const std::string & define : defines) key += define + ";";
+        std::unique_ptr<Shader> & variant = variants[key];
+        if (!variant)
+        {
+            variant.reset(new Shader(vertexPath.c_str(), fragmentPath.c_str(), defines));
+            std::cout << "Shader variant [" << key << "] of " << fragmentPath << std::endl;
+        }
+        return *variant;
+    }
+
+    const Shader & get(const SkinFeatures & features) { return get(features.defines()); }
+
+    // number of variants compiled so far
+    std::size_t size() const { return variants.size(); }
+
+private:
+    std::string vertexPath, fragmentPath;
+    std::map<std::string, std::unique_ptr<Shader> > variants;
+};
+
+#endif //SHADERVARIANTS_HPP
@@ -0,0 +1,98 @@
+#ifndef SKINATLAS_HPP
+#define SKINATLAS_HPP
+
+// Include standard headers
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <vector>
+
+// Include Glad
+#include <glad/glad.h>
+
+// Include GLM
+#include <glm.hpp>
+
+#include "Mesh.hpp"
+
+// what the skin colour depends on besides the mesh
+struct SkinAtlasParameters {
+    glm::mat4 model = glm::mat4(1.0f);  // placement the world space noise is evaluated at
+    glm::vec3 freckleColor = glm::vec3(0.0f);
+    float freckleScale = 0.0f;          // no freckles when <= 0 (SKIN_NO_FRECKLES)
+    float freckleFrequency = 0.0f;
+};
+
+// the skin colour of fragment_shader.glsl (subsurface noise, pores, freckles) baked in the uv
+// atlas of a mesh (Mesh::unwrap_uvs) for SKIN_BAKED_ALBEDO. The colour is linear in the skin
+// colour of the object, so a texel stores both terms and every instance keeps its own colour :
+//   colour = mix(COLOR_LOW, COLOR_HIGH, texel.rgb) + SkinColor * texel.a
+// The noise is evaluated with the world positions of one placement (@model) : the other
+// instances carry the same pattern instead of one that swims when they move.
+//
+// Texels are computed on worker threads with the SIMD noise (SkinNoise), the render thread
+// uploads them and builds the mipmaps. A bake runs at a time, the last parameters asked for
+// meanwhile are baked next. Parameters are told apart by their version (SkinParameters.hpp) :
+// the caller gives a new one whenever they change.
+class SkinAtlas {
+public:
+    static const GLuint UNIT = 5;                   // texture unit (layout(binding = ...) in the shader)
+    static constexpr float COLOR_LOW = -1.0f / 16.0f;
+    static constexpr float COLOR_HIGH = 17.0f / 16.0f;
+
+    SkinAtlas() = default;
+    SkinAtlas(const SkinAtlas &) = delete;
+    SkinAtlas & operator=(const SkinAtlas &) = delete;
+
+    // bake @mesh with @parameters (of @version) unless it is already baked or on its way,
+    // returns at once
+    void request(const std::shared_ptr<const Mesh> & mesh, const SkinAtlasParameters & parameters,
+                 std::uint64_t version);
+
+    // upload a finished bake (needs a current GL context) and start the next one, never blocks ;
+    // true when a texture is there
+    bool update();
+    bool ready() const { return texture != 0; }
+
+    // the texture holds @mesh baked with the parameters of @version
+    bool current(const std::shared_ptr<const Mesh> & mesh, std::uint64_t version) const
+    {
+        return ready() && mesh == bakedMesh && version == bakedVersion;
+    }
+
+    // bind the texture to its unit
+    void bind() const;
+
+    void destroy();
+
+    // time of the last bake on the CPU, texels along a side, texels the mesh covers, bytes of the
+    // texture with its mipmaps
+    double getBakeMilliseconds() const { return milliseconds; }
+    int getSize() const { return size; }
+    std::size_t getCoveredTexels() const { return covered; }
+    std::size_t getGpuBytes() const;
+
+private:
+    struct Texels {
+        int size = 0;
+        std::vector<std::uint8_t> rgba;
+        std::size_t covered = 0;
+        double milliseconds = 0.0;
+    };
+    static Texels compute(std::shared_ptr<const Mesh> mesh, SkinAtlasParameters parameters);
+
+    void start(const std::shared_ptr<const Mesh> & mesh, const SkinAtlasParameters & parameters, std::uint64_t version);
+
+    std::future<Texels> pending;
+    std::shared_ptr<const Mesh> pendingMesh, queuedMesh, bakedMesh;
+    SkinAtlasParameters queuedParameters;
+    std::uint64_t pendingVersion = 0, queuedVersion = 0, bakedVersion = 0;
+
+    GLuint texture = 0;
+    int size = 0;
+    std::size_t covered = 0;
+    double milliseconds = 0.0;
+};
+
+#endif //SKINATLAS_HPP
@@ -0,0 +1,62 @@
+#ifndef SKINNOISE_HPP
+#define SKINNOISE_HPP
+
+// Include standard headers
+#include <cstddef>
+#include <iostream>
+
+// Include GLM
+#include <glm.hpp>
+
+// instruction set of the batch functions, from the slowest to the fastest
+enum SkinNoisePath {
+    NOISE_SCALAR,
+    NOISE_SSE2,   // 4 points at a time
+    NOISE_AVX2    // 8 points at a time, when the CPU has it (checked at run time)
+};
+
+// the procedural skin noise of fragment_shader.glsl on the CPU, to bake it or check it without
+// a GPU. Every function reproduces the GLSL one operation by operation in float ; the sin of the
+// hashes is computed in double and rounded, as a correctly rounded float sin would be (GPUs
+// approximate it, so their values only match where their sin is exact). Arguments of the hashes
+// are reduced exactly up to |x| ~ 2e8, far beyond the coordinates the shader feeds them.
+//
+// The batch functions evaluate @count points with the fastest available path, all the paths give
+// the same values.
+class SkinNoise {
+public:
+    // Noise3D : value noise in [0, 1]
+    static float noise3D(const glm::vec3 & p);
+    // FBMNoise3D6 with @octaves octaves (1 to 6, SKIN_FBM_OCTAVES)
+    static float fbm(const glm::vec3 & p, int octaves = 6);
+    // snoise : simplex noise in [-1, 1]
+    static float simplex3D(const glm::vec3 & p);
+    // noise : 2D simplex noise in [-1, 1] (the freckles use 0.5 + 0.5 * simplex2D)
+    static float simplex2D(const glm::vec2 & p);
+
+    static void noise3D(const glm::vec3 * points, std::size_t count, float * out);
+    static void fbm(const glm::vec3 * points, std::size_t count, float * out, int octaves = 6);
+
+    // fbm that repeats every @tile units along each axis (@tile a multiple of 50, see
+    // SkinNoiseKernels.hpp), equal to fbm() over [0, tile) but near the far sides
+    static void fbmTiled(const glm::vec3 * points, std::size_t count, float * out, float tile, int octaves = 6);
+
+    static void simplex3D(const glm::vec3 * points, std::size_t count, float * out);
+    static void simplex2D(const glm::vec2 * points, std::size_t count, float * out);
+
+    // path used by the batch functions, and a name for it
+    static SkinNoisePath path();
+    static const char * pathName(SkinNoisePath path);
+
+    // force the batch functions onto @path (or the fastest one below it that the CPU runs)
+    static void setPath(SkinNoisePath path);
+
+    // compare every path with reference values of the functions and with the scalar path on
+    // random points, print the largest differences ; false if a path is off
+    static bool conformance(std::ostream & out);
+
+    // points/s of every function on every path, on the calling thread
+    static void benchmark(std::ostream & out);
+};
+
+#endif //SKINNOISE_HPP
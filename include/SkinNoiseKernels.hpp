@@ -0,0 +1,300 @@
+#ifndef SKINNOISEKERNELS_HPP
+#define SKINNOISEKERNELS_HPP
+
+// Include standard headers
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+// Include GLM
+#include <glm.hpp>
+
+// the skin noise functions of fragment_shader.glsl, written once for any lane type V : one lane
+// for the scalar path, 4 or 8 float lanes for the SIMD paths (SkinNoise.cpp, SkinNoiseAVX2.cpp).
+// Operations follow the GLSL ones in the same order, so every path rounds the same way.
+//
+// A lane type provides + - * / (with a float broadcast), vfloor, vmin, vmax, vabs, vstep,
+// vsin (computed in double, see SkinNoise.hpp), V::width, V::load and V::store.
+//
+// Only for SkinNoise*.cpp : everything is in an anonymous namespace because the translation
+// units are compiled for different instruction sets and must not share an instantiation.
+
+// batches of points for every function, one instruction set
+struct SkinNoiseBatch {
+    void (*noise3D)(const glm::vec3 * points, std::size_t count, float * out);
+    void (*fbm)(const glm::vec3 * points, std::size_t count, float * out, int octaves);
+    void (*fbmTiled)(const glm::vec3 * points, std::size_t count, float * out, float tile, int octaves);
+    void (*simplex3D)(const glm::vec3 * points, std::size_t count, float * out);
+    void (*simplex2D)(const glm::vec2 * points, std::size_t count, float * out);
+};
+
+// AVX2 batches, false when the build or the CPU has no AVX2 (SkinNoiseAVX2.cpp)
+bool make_avx2_batch(SkinNoiseBatch & batch);
+
+namespace {
+
+// sin in double for the SIMD lanes : x - k pi/2 with pi/2 cut in 3 parts (the first two have 26
+// bits so k * part is exact up to k = 2^27), then the fdlibm kernels on [-pi/4, pi/4]
+const double TWO_OVER_PI = 0.6366197723675814;
+const double PI_OVER_2[3] = {1.5707963407039642, -1.3909067675399456e-08, 6.123233995736766e-17};
+const double SIN_KERNEL[6] = {-1.66666666666666324348e-01, 8.33333333332248946124e-03, -1.98412698298579493134e-04,
+                              2.75573137070700676789e-06, -2.50507602534068634195e-08, 1.58969099521155010221e-10};
+const double COS_KERNEL[6] = {4.16666666666666019037e-02, -1.38888888888741095749e-03, 2.48015872894767294178e-05,
+                              -2.75573143513906633035e-07, 2.08757232129817482790e-09, -1.13596475577881948265e-11};
+
+// one lane, the reference the SIMD paths are checked against
+struct ScalarLanes {
+    float v;
+
+    static const int width = 1;
+    ScalarLanes() = default;
+    ScalarLanes(float x) : v(x) {}
+    static ScalarLanes load(const float * p) { return ScalarLanes(*p); }
+    static void store(float * p, ScalarLanes x) { *p = x.v; }
+};
+inline ScalarLanes operator+(ScalarLanes a, ScalarLanes b) { return a.v + b.v; }
+inline ScalarLanes operator-(ScalarLanes a, ScalarLanes b) { return a.v - b.v; }
+inline ScalarLanes operator*(ScalarLanes a, ScalarLanes b) { return a.v * b.v; }
+inline ScalarLanes operator/(ScalarLanes a, ScalarLanes b) { return a.v / b.v; }
+inline ScalarLanes vfloor(ScalarLanes x) { return std::floor(x.v); }
+inline ScalarLanes vmin(ScalarLanes a, ScalarLanes b) { return std::min(a.v, b.v); }
+inline ScalarLanes vmax(ScalarLanes a, ScalarLanes b) { return std::max(a.v, b.v); }
+inline ScalarLanes vabs(ScalarLanes x) { return std::abs(x.v); }
+inline ScalarLanes vstep(ScalarLanes edge, ScalarLanes x) { return x.v < edge.v ? 0.0f : 1.0f; }
+inline ScalarLanes vsin(ScalarLanes x) { return float(std::sin(double(x.v))); }
+
+template <typename V> V vfract(V x) { return x - vfloor(x); }
+template <typename V> V vmod(V x, V y) { return x - y * vfloor(x / y); }
+template <typename V> V vmod(V x, float y) { return vmod(x, V(y)); }
+template <typename V> V vmix(V a, V b, V t) { return a * (V(1.0f) - t) + b * t; }
+
+// ******************************************************************************************************
+// Noise3D / FBMNoise3D6 : value noise over a sin hash
+template <typename V>
+V random3(V x, V y, V z)
+{
+    V d = x * V(1274.0546f) + y * V(1156.01549f) + z * V(1422.65229f);
+    return vfract(vsin(d) * V(15554.0f));
+}
+
+// @period > 0 wraps the lattice every @period cells (tileable), the values in [0, period) are
+// the ones of the unwrapped noise except in the last cell, which blends back to the first
+template <typename V>
+V noise3(V x, V y, V z, float period = 0.0f)
+{
+    V ix = vfloor(x), iy = vfloor(y), iz = vfloor(z);
+    V fx = vfract(x), fy = vfract(y), fz = vfract(z);
+    const V one(1.0f);
+    V jx = ix + one, jy = iy + one, jz = iz + one;
+    if (period > 0.0f)
+    {
+        ix = vmod(ix, period); iy = vmod(iy, period); iz = vmod(iz, period);
+        jx = vmod(jx, period); jy = vmod(jy, period); jz = vmod(jz, period);
+    }
+
+    V a = random3(ix, iy, iz);
+    V b = random3(jx, iy, iz);
+    V c = random3(ix, jy, iz);
+    V d = random3(jx, jy, iz);
+
+    V f = random3(ix, iy, jz);
+    V g = random3(jx, iy, jz);
+    V h = random3(ix, jy, jz);
+    V i = random3(jx, jy, jz);
+
+    fx = fx * fx * (V(3.0f) - V(2.0f) * fx);
+    fy = fy * fy * (V(3.0f) - V(2.0f) * fy);
+    fz = fz * fz * (V(3.0f) - V(2.0f) * fz);
+
+    return vmix(vmix(vmix(a, b, fx), vmix(c, d, fx), fy),
+                vmix(vmix(f, g, fx), vmix(h, i, fx), fy), fz);
+}
+
+const float FBM_SCALES[6] = {0.1f, 0.2f, 0.4f, 0.8f, 0.16f, 0.32f};
+const float FBM_WEIGHTS[6] = {0.5f, 0.25f, 0.125f, 0.0625f, 0.03125f, 0.03125f};
+
+// @tile > 0 makes the sum tileable every @tile units : every octave wraps its lattice, so
+// tile * FBM_SCALES must be whole numbers (multiples of 50)
+template <typename V>
+V fbm3(V x, V y, V z, int octaves, float tile = 0.0f)
+{
+    V sum = noise3(x * V(FBM_SCALES[0]), y * V(FBM_SCALES[0]), z * V(FBM_SCALES[0]), std::round(tile * FBM_SCALES[0])) * V(FBM_WEIGHTS[0]);
+    for (int o = 1; o < octaves && o < 6; ++o)
+    {
+        V octave = noise3(x * V(FBM_SCALES[o]), y * V(FBM_SCALES[o]), z * V(FBM_SCALES[o]), std::round(tile * FBM_SCALES[o]));
+        sum = sum + octave * V(FBM_WEIGHTS[o]);
+    }
+    return sum;
+}
+
+// ******************************************************************************************************
+// snoise : simplex 3D noise by Ian McEwan, Ashima Arts
+template <typename V>
+V permute(V x)
+{
+    return vmod((x * V(34.0f) + V(1.0f)) * x, 289.0f);
+}
+
+template <typename V>
+V simplex3(V vx, V vy, V vz)
+{
+    const float Cx = 1.0f / 6.0f, Cy = 1.0f / 3.0f;
+
+    // first corner
+    V s = vx * V(Cy) + vy * V(Cy) + vz * V(Cy);
+    V ix = vfloor(vx + s), iy = vfloor(vy + s), iz = vfloor(vz + s);
+    V t = ix * V(Cx) + iy * V(Cx) + iz * V(Cx);
+    V x0[3] = {vx - ix + t, vy - iy + t, vz - iz + t};
+
+    // other corners
+    V g[3] = {vstep(x0[1], x0[0]), vstep(x0[2], x0[1]), vstep(x0[0], x0[2])};
+    V l[3] = {V(1.0f) - g[0], V(1.0f) - g[1], V(1.0f) - g[2]};
+    V i1[3] = {vmin(g[0], l[2]), vmin(g[1], l[0]), vmin(g[2], l[1])};
+    V i2[3] = {vmax(g[0], l[2]), vmax(g[1], l[0]), vmax(g[2], l[1])};
+
+    // corner k is x0 - offset[k] + k * C.x
+    V x[4][3];
+    for (int a = 0; a < 3; ++a)
+    {
+        x[0][a] = x0[a];
+        x[1][a] = x0[a] - i1[a] + V(1.0f * Cx);
+        x[2][a] = x0[a] - i2[a] + V(2.0f * Cx);
+        x[3][a] = x0[a] - V(1.0f) + V(3.0f * Cx);
+    }
+
+    // permutations
+    ix = vmod(ix, 289.0f); iy = vmod(iy, 289.0f); iz = vmod(iz, 289.0f);
+    const V zero(0.0f), one(1.0f);
+    const V ox[4] = {zero, i1[0], i2[0], one}, oy[4] = {zero, i1[1], i2[1], one}, oz[4] = {zero, i1[2], i2[2], one};
+
+    // gradients : N*N points uniformly over a square, mapped onto an octahedron (N = 7)
+    const float n_ = 1.0f / 7.0f;
+    const float nsx = n_ * 2.0f - 0.0f, nsy = n_ * 0.5f - 1.0f, nsz = n_ * 1.0f - 0.0f;
+
+    V result(0.0f);
+    for (int k = 0; k < 4; ++k)
+    {
+        V p = permute(permute(permute(iz + oz[k]) + iy + oy[k]) + ix + ox[k]);
+
+        V j = p - V(49.0f) * vfloor(p * V(nsz) * V(nsz));
+        V xk_ = vfloor(j * V(nsz));
+        V yk_ = vfloor(j - V(7.0f) * xk_);
+        V gx = xk_ * V(nsx) + V(nsy);
+        V gy = yk_ * V(nsx) + V(nsy);
+        V h = V(1.0f) - vabs(gx) - vabs(gy);
+
+        V sh = zero - vstep(h, zero);
+        gx = gx + (vfloor(gx) * V(2.0f) + V(1.0f)) * sh;
+        gy = gy + (vfloor(gy) * V(2.0f) + V(1.0f)) * sh;
+
+        // normalise the gradient
+        V norm = V(1.79284291400159f) - V(0.85373472095314f) * (gx * gx + gy * gy + h * h);
+        gx = gx * norm; gy = gy * norm; h = h * norm;
+
+        V m = vmax(V(0.6f) - (x[k][0] * x[k][0] + x[k][1] * x[k][1] + x[k][2] * x[k][2]), zero);
+        m = m * m;
+        result = result + m * m * (gx * x[k][0] + gy * x[k][1] + h * x[k][2]);
+    }
+    return V(42.0f) * result;
+}
+
+// ******************************************************************************************************
+// noise : simplex 2D noise by Inigo Quilez
+template <typename V>
+void hash2(V px, V py, V & hx, V & hy)
+{
+    V dx = px * V(127.1f) + py * V(311.7f);
+    V dy = px * V(269.5f) + py * V(183.3f);
+    hx = V(-1.0f) + V(2.0f) * vfract(vsin(dx) * V(43758.5453123f));
+    hy = V(-1.0f) + V(2.0f) * vfract(vsin(dy) * V(43758.5453123f));
+}
+
+template <typename V>
+V simplex2(V px, V py)
+{
+    const float K1 = 0.366025404f; // (sqrt(3)-1)/2;
+    const float K2 = 0.211324865f; // (3-sqrt(3))/6;
+
+    V s = (px + py) * V(K1);
+    V ix = vfloor(px + s), iy = vfloor(py + s);
+
+    V t = (ix + iy) * V(K2);
+    V ax = px - ix + t, ay = py - iy + t;
+    V ox = vstep(ay, ax), oy = vstep(ax, ay);
+    V bx = ax - ox + V(K2), by = ay - oy + V(K2);
+    V cx = ax - V(1.0f) + V(2.0f * K2), cy = ay - V(1.0f) + V(2.0f * K2);
+
+    const V zero(0.0f);
+    V ha = vmax(V(0.5f) - (ax * ax + ay * ay), zero);
+    V hb = vmax(V(0.5f) - (bx * bx + by * by), zero);
+    V hc = vmax(V(0.5f) - (cx * cx + cy * cy), zero);
+
+    V gx, gy;
+    hash2(ix + zero, iy + zero, gx, gy);
+    V na = ha * ha * ha * ha * (ax * gx + ay * gy);
+    hash2(ix + ox, iy + oy, gx, gy);
+    V nb = hb * hb * hb * hb * (bx * gx + by * gy);
+    hash2(ix + V(1.0f), iy + V(1.0f), gx, gy);
+    V nc = hc * hc * hc * hc * (cx * gx + cy * gy);
+
+    return na * V(70.0f) + nb * V(70.0f) + nc * V(70.0f);
+}
+
+// ******************************************************************************************************
+// batches : points are gathered V::width at a time, the last group is padded with its last point
+
+template <typename V, int Components, typename Point, typename Kernel>
+void run_batch(const Point * points, std::size_t count, float * out, Kernel && kernel)
+{
+    const int W = V::width;
+    alignas(32) float in[Components][W];
+    alignas(32) float result[W];
+    for (std::size_t first = 0; first < count; first += W)
+    {
+        const std::size_t n = std::min<std::size_t>(W, count - first);
+        for (int k = 0; k < W; ++k)
+        {
+            const Point & p = points[first + std::min<std::size_t>(k, n - 1)];
+            for (int c = 0; c < Components; ++c) in[c][k] = p[c];
+        }
+        V value = kernel(in);
+        V::store(result, value);
+        std::copy(result, result + n, out + first);
+    }
+}
+
+template <typename V>
+SkinNoiseBatch make_batch()
+{
+    SkinNoiseBatch batch;
+    batch.noise3D = [](const glm::vec3 * points, std::size_t count, float * out) {
+        run_batch<V, 3>(points, count, out, [](float (*in)[V::width]) {
+            return noise3(V::load(in[0]), V::load(in[1]), V::load(in[2]));
+        });
+    };
+    batch.fbm = [](const glm::vec3 * points, std::size_t count, float * out, int octaves) {
+        run_batch<V, 3>(points, count, out, [octaves](float (*in)[V::width]) {
+            return fbm3(V::load(in[0]), V::load(in[1]), V::load(in[2]), octaves);
+        });
+    };
+    batch.fbmTiled = [](const glm::vec3 * points, std::size_t count, float * out, float tile, int octaves) {
+        run_batch<V, 3>(points, count, out, [tile, octaves](float (*in)[V::width]) {
+            return fbm3(V::load(in[0]), V::load(in[1]), V::load(in[2]), octaves, tile);
+        });
+    };
+    batch.simplex3D = [](const glm::vec3 * points, std::size_t count, float * out) {
+        run_batch<V, 3>(points, count, out, [](float (*in)[V::width]) {
+            return simplex3(V::load(in[0]), V::load(in[1]), V::load(in[2]));
+        });
+    };
+    batch.simplex2D = [](const glm::vec2 * points, std::size_t count, float * out) {
+        run_batch<V, 2>(points, count, out, [](float (*in)[V::width]) {
+            return simplex2(V::load(in[0]), V::load(in[1]));
+        });
+    };
+    return batch;
+}
+
+} // namespace
+
+#endif //SKINNOISEKERNELS_HPP
@@ -0,0 +1,70 @@
+#ifndef SKINPARAMETERS_HPP
+#define SKINPARAMETERS_HPP
+
+// Include standard headers
+#include <algorithm>
+#include <cstdint>
+
+// Include GLM
+#include <glm.hpp>
+
+// a value of the store and the version of the store it last changed at (0 : never)
+template <typename T>
+class Tracked {
+public:
+    explicit Tracked(const T & value) : value(value) {}
+
+    const T & get() const { return value; }
+    std::uint64_t version() const { return changed; }
+
+private:
+    friend class SkinParameters;
+    T value;
+    std::uint64_t changed = 0;
+};
+
+// the skin settings edited in the panel. A change stamps the value with a new version of the
+// store ; what is derived from the values (uniforms, the baked atlas, instance colours) keeps the
+// newest version of its inputs it was made from and is only redone when one of them is newer,
+// so nothing is recomputed or uploaded while the settings stay the same.
+class SkinParameters {
+public:
+    Tracked<glm::vec3> skinColor{glm::vec3(1.0f, 0.75f, 0.66f)};
+    Tracked<glm::vec3> freckleColor{glm::vec3(0.409f, 0.101f, 0.108f)};
+    Tracked<float> freckleScale{0.3f};
+    Tracked<float> freckleFrequency{5.0f};
+
+    // give @field the value @value, true (with a new version) when it changed
+    template <typename T>
+    bool set(Tracked<T> & field, const T & value)
+    {
+        if (field.value == value) return false;
+        field.value = value;
+        field.changed = ++latest;
+        return true;
+    }
+
+    // back to the defaults, as changes
+    void reset()
+    {
+        SkinParameters defaults;
+        set(skinColor, defaults.skinColor.get());
+        set(freckleColor, defaults.freckleColor.get());
+        set(freckleScale, defaults.freckleScale.get());
+        set(freckleFrequency, defaults.freckleFrequency.get());
+    }
+
+    // newest version of the freckle values (their uniforms and the atlas depend on them)
+    std::uint64_t freckles_version() const
+    {
+        return std::max({freckleColor.version(), freckleScale.version(), freckleFrequency.version()});
+    }
+
+    // version of the last change
+    std::uint64_t version() const { return latest; }
+
+private:
+    std::uint64_t latest = 0;
+};
+
+#endif //SKINPARAMETERS_HPP
@@ -0,0 +1,81 @@
+#ifndef UNIFORMRING_HPP
+#define UNIFORMRING_HPP
+
+// Include standard headers
+#include <cstddef>
+#include <vector>
+
+// Include Glad
+#include <glad/glad.h>
+
+// Include GLM
+#include <glm.hpp>
+
+// uniform blocks shared by the mesh shaders (std140, see the shaders for the GLSL side).
+// vec3 members take 16 bytes : the padding is explicit so both sides agree.
+const GLuint FRAME_BLOCK_BINDING = 0;
+const GLuint OBJECT_BLOCK_BINDING = 1;
+
+// camera and light, written once per frame
+struct FrameUniforms {
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::vec3 lightPos;   float pad0;
+    glm::vec3 viewPos;    float pad1;
+    glm::vec3 lightColor; float pad2;
+};
+static_assert(sizeof(FrameUniforms) == 176, "FrameUniforms must follow std140");
+
+// model and colour, written for every draw
+struct ObjectUniforms {
+    glm::mat4 model;
+    glm::vec3 objectColor;    float pad0;
+    glm::vec3 positionOffset; float pad1;
+    glm::vec3 positionScale;  GLint octahedralNormals;
+};
+static_assert(sizeof(ObjectUniforms) == 112, "ObjectUniforms must follow std140");
+
+// persistently mapped uniform buffer cut in one region per frame in flight. The CPU writes
+// the blocks of frame N in region N % frames while the GPU still reads the older regions, a
+// fence per region makes it wait only if it gets a whole ring ahead.
+class UniformRing {
+public:
+    // constructors
+    UniformRing() = default;
+    UniformRing(const UniformRing &) = delete;
+    UniformRing & operator=(const UniformRing &) = delete;
+
+    // allocate @framesInFlight regions of @bytesPerFrame (needs a current GL context)
+    void create(std::size_t bytesPerFrame, unsigned int framesInFlight = 3);
+    void destroy();
+
+    // wait until the GPU is done with the region of this frame, then start writing in it
+    void beginFrame();
+
+    // fence the region written during the frame
+    void endFrame();
+
+    // copy @size bytes into the region of the frame and bind them to the uniform block @binding
+    void bind(GLuint binding, const void * data, std::size_t size);
+
+    // times beginFrame() had to wait for the GPU, and times a frame didn't fit in its region
+    unsigned int getStalls() const { return stalls; }
+    unsigned int getOverflows() const { return overflows; }
+
+private:
+    // copy at the cursor and bind
+    void write(GLuint binding, const void * data, std::size_t size);
+
+    GLuint buffer = 0;
+    unsigned char * mapping = nullptr;
+    std::size_t regionSize = 0;
+    std::size_t alignment = 256;
+    std::size_t cursor = 0;
+    unsigned int current = 0;
+    std::vector<GLsync> fences;
+    unsigned int stalls = 0;
+    unsigned int overflows = 0;
+    std::vector<unsigned char> frameBlock;  // of this frame, rewritten when the region wraps
+};
+
+#endif //UNIFORMRING_HPP
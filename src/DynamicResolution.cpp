@@ -0,0 +1,111 @@
+#include "DynamicResolution.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <glm.hpp>
+
+// ******************************************************************************************************
+// ******************************************************************************************************
+// ******************************************************************************************************
+// timing
+void DynamicResolution::beginFrame()
+{
+    if (startQueries[0] == 0)
+    {
+        glGenQueries(FRAMES, startQueries);
+        glGenQueries(FRAMES, endQueries);
+    }
+    glQueryCounter(startQueries[current], GL_TIMESTAMP);
+}
+
+void DynamicResolution::endFrame()
+{
+    glQueryCounter(endQueries[current], GL_TIMESTAMP);
+    issued[current] = true;
+    issuedFrame[current] = frame;
+    current = (current + 1) % FRAMES;
+    ++frame;
+
+    // the slot reused next frame was issued FRAMES - 1 frames ago : read it if the GPU is done,
+    // drop it otherwise (waiting would stall). A frame rendered before the last change of the
+    // scale is dropped too, its time is the one of the old scale.
+    if (issued[current])
+    {
+        GLint available = 0;
+        glGetQueryObjectiv(endQueries[current], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available && issuedFrame[current] >= decisionFrame)
+        {
+            GLuint64 start = 0, end = 0;
+            glGetQueryObjectui64v(startQueries[current], GL_QUERY_RESULT, &start);
+            glGetQueryObjectui64v(endQueries[current], GL_QUERY_RESULT, &end);
+            decide(float(end - start) * 1e-6f);
+        }
+        issued[current] = false;
+    }
+}
+
+// ******************************************************************************************************
+// ******************************************************************************************************
+// ******************************************************************************************************
+// controller
+void DynamicResolution::setScaleRange(float minimum, float maximum)
+{
+    minimumScale = glm::clamp(minimum, 0.1f, 1.0f);
+    maximumScale = glm::clamp(maximum, minimumScale, 1.0f);
+    setScale(scale);
+}
+
+void DynamicResolution::setScale(float value)
+{
+    scale = glm::clamp(value, minimumScale, maximumScale);
+    framesSinceChange = 0;
+    decisionFrame = frame;
+}
+
+void DynamicResolution::decide(float ms)
+{
+    milliseconds = (milliseconds == 0.0f) ? ms : milliseconds * 0.8f + ms * 0.2f;
+    scaleHistory[historyOffset] = scale;
+    millisecondsHistory[historyOffset] = ms;
+    historyOffset = (historyOffset + 1) % HISTORY;
+
+    if (!enabled || ++framesSinceChange < COOLDOWN) return;
+
+    float next = scale;
+    if (milliseconds > targetMilliseconds)
+        // a little under the target, so it is not crossed again at once
+        next = scale * std::sqrt(0.9f * targetMilliseconds / milliseconds);
+    else if (milliseconds < 0.7f * targetMilliseconds)
+        next = scale + STEP;
+    // steps of 1/80 : no change for noise
+    next = glm::clamp(std::round(next * 80.0f) / 80.0f, minimumScale, maximumScale);
+    if (next == scale) return;
+
+    decisions.push_back({frame, milliseconds, scale, next});
+    if (decisions.size() > MAX_DECISIONS) decisions.pop_front();
+    scale = next;
+    framesSinceChange = 0;
+    // the next frame is the first at the new scale, the timings of the old one are dropped
+    decisionFrame = frame;
+    milliseconds = 0.0f;
+}
+
+void DynamicResolution::report(std::ostream & out) const
+{
+    out << "frame | GPU (ms) | render scale" << std::endl;
+    for (const Decision & decision : decisions)
+        out << decision.frame << " | " << decision.milliseconds << " | " << decision.from << " -> " << decision.to << std::endl;
+}
+
+void DynamicResolution::destroy()
+{
+    if (startQueries[0] != 0)
+    {
+        glDeleteQueries(FRAMES, startQueries);
+        glDeleteQueries(FRAMES, endQueries);
+    }
+    std::fill(startQueries, startQueries + FRAMES, 0u);
+    std::fill(endQueries, endQueries + FRAMES, 0u);
+    std::fill(issued, issued + FRAMES, false);
+    std::fill(issuedFrame, issuedFrame + FRAMES, std::uint64_t(0));
+}
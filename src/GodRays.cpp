@@ -0,0 +1,121 @@
+#include "GodRays.hpp"
+
+#include <iostream>
+#include <vector>
+
+// ******************************************************************************************************
+// ******************************************************************************************************
+// ******************************************************************************************************
+// programs
+GodRays::GodRays(const std::string & shaderDirectory)
+{
+    const std::string vertex = shaderDirectory + "/quad.vs.glsl";
+    const std::string fragment = shaderDirectory + "/godrays.fs.glsl";
+    blurProgram.reset(new Shader((shaderDirectory + "/godrays.cs.glsl").c_str()));
+    fullProgram.reset(new Shader(vertex.c_str(), fragment.c_str(), std::vector<std::string>{"GODRAYS_FULL_RESOLUTION"}));
+    upsampleProgram.reset(new Shader(vertex.c_str(), fragment.c_str(), std::vector<std::string>()));
+    copyProgram.reset(new Shader(vertex.c_str(), fragment.c_str(), std::vector<std::string>{"GODRAYS_NONE"}));
+}
+
+// ******************************************************************************************************
+// ******************************************************************************************************
+// ******************************************************************************************************
+// render
+void GodRays::render(const RenderTargets & targets, const glm::vec2 & sunPos, const glm::mat4 & projection,
+                     float intensity)
+{
+    if (vertexArray == 0) glGenVertexArrays(1, &vertexArray);
+    const glm::vec2 uvScale = targets.getUvScale();
+
+    // light not visible : the scene alone
+    lastActive = intensity > 0.0f;
+    if (!lastActive)
+    {
+        glActiveTexture(GL_TEXTURE0 + COLOR_UNIT);
+        glBindTexture(GL_TEXTURE_2D, targets.getColor());
+        copyProgram->use();
+        copyProgram->setVec2("uvScale", uvScale);
+        drawTriangle();
+        return;
+    }
+
+    // blurred rays at the resolution of the quality, rounded up : allocated for the render
+    // targets, computed over the part of the render scale
+    const int divisor = int(quality);
+    const int width = (targets.getWidth() + divisor - 1) / divisor, height = (targets.getHeight() + divisor - 1) / divisor;
+    const glm::ivec2 raysSize((targets.getRenderWidth() + divisor - 1) / divisor, (targets.getRenderHeight() + divisor - 1) / divisor);
+    if (quality != GODRAYS_FULL && (rays == 0 || raysWidth != width || raysHeight != height))
+    {
+        raysWidth = width;
+        raysHeight = height;
+        if (rays == 0) glGenTextures(1, &rays);
+        glBindTexture(GL_TEXTURE_2D, rays);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, raysWidth, raysHeight, 0, GL_RGBA, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        std::cout << "God rays at " << raysWidth << "x" << raysHeight << std::endl;
+    }
+
+    GpuTimer & timer = timers[index(quality)];
+    timer.begin();
+
+    glActiveTexture(GL_TEXTURE0 + COLOR_UNIT);
+    glBindTexture(GL_TEXTURE_2D, targets.getColor());
+    glActiveTexture(GL_TEXTURE0 + MASK_UNIT);
+    glBindTexture(GL_TEXTURE_2D, targets.getMask());
+    glActiveTexture(GL_TEXTURE0 + DEPTH_UNIT);
+    glBindTexture(GL_TEXTURE_2D, targets.getDepth());
+    // linear depth = depthParameters.x / (ndc depth + depthParameters.y)
+    const glm::vec2 depthParameters(projection[3][2], projection[2][2]);
+
+    if (quality != GODRAYS_FULL)
+    {
+        blurProgram->use();
+        blurProgram->setVec2("sunPos", sunPos);
+        blurProgram->setVec2("depthParameters", depthParameters);
+        blurProgram->setVec2("uvScale", uvScale);
+        blurProgram->setIVec2("raysSize", raysSize);
+        glBindImageTexture(0, rays, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+        glDispatchCompute(GLuint((raysSize.x + 15) / 16), GLuint((raysSize.y + 15) / 16), 1);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+        glActiveTexture(GL_TEXTURE0 + RAYS_UNIT);
+        glBindTexture(GL_TEXTURE_2D, rays);
+    }
+
+    // composite with the scene, one triangle over the screen
+    const Shader & composite = (quality == GODRAYS_FULL) ? *fullProgram : *upsampleProgram;
+    composite.use();
+    composite.setVec2("sunPos", sunPos);
+    composite.setVec2("depthParameters", depthParameters);
+    composite.setFloat("intensity", intensity);
+    composite.setVec2("uvScale", uvScale);
+    composite.setIVec2("raysSize", raysSize);
+    drawTriangle();
+
+    timer.end();
+}
+
+void GodRays::drawTriangle()
+{
+    GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+    glDisable(GL_DEPTH_TEST);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    glBindVertexArray(vertexArray);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    if (depthTest) glEnable(GL_DEPTH_TEST);
+}
+
+void GodRays::destroy()
+{
+    for (GpuTimer & timer : timers) timer.cleanUp();
+    if (rays != 0) glDeleteTextures(1, &rays);
+    if (vertexArray != 0) glDeleteVertexArrays(1, &vertexArray);
+    rays = vertexArray = 0;
+    blurProgram.reset();
+    fullProgram.reset();
+    upsampleProgram.reset();
+    copyProgram.reset();
+}
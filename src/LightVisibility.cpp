@@ -0,0 +1,85 @@
+#include "LightVisibility.hpp"
+
+#include <algorithm>
+
+// ******************************************************************************************************
+// ******************************************************************************************************
+// ******************************************************************************************************
+// screen test
+void LightVisibility::beginFrame(const glm::mat4 & projection, const glm::mat4 & view, const glm::vec3 & center, float radius)
+{
+    glm::vec4 clip = projection * (view * glm::vec4(center, 1.0f));
+    if (clip.w <= 0.0f)
+    {
+        // behind the camera
+        edgeFade = 0.0f;
+        return;
+    }
+    screenPosition = (glm::vec2(clip.x, clip.y) / clip.w + glm::vec2(1.0f)) * 0.5f;
+
+    // radius of the sphere on screen, and how far its center is out of the screen (< 0 inside)
+    float screenRadius = std::max(radius * std::max(projection[0][0], projection[1][1]) / clip.w * 0.5f, 1e-4f);
+    float outside = std::max(std::max(-screenPosition.x, screenPosition.x - 1.0f),
+                             std::max(-screenPosition.y, screenPosition.y - 1.0f));
+    // 1 with the whole sphere inside, 0.5 with the center on the edge, 0 once it is out
+    edgeFade = glm::clamp((screenRadius - outside) / (2.0f * screenRadius), 0.0f, 1.0f);
+}
+
+// ******************************************************************************************************
+// ******************************************************************************************************
+// ******************************************************************************************************
+// occlusion queries
+void LightVisibility::query(const std::function<void()> & drawLight)
+{
+    if (!onScreen()) return;
+    if (visibleQueries[0] == 0)
+    {
+        glGenQueries(2, visibleQueries);
+        glGenQueries(2, totalQueries);
+    }
+
+    GLint depthFunc = GL_LESS;
+    glGetIntegerv(GL_DEPTH_FUNC, &depthFunc);
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDepthMask(GL_FALSE);
+    // the light is in the depth buffer already : its own samples pass with LEQUAL
+    glDepthFunc(GL_LEQUAL);
+    glBeginQuery(GL_SAMPLES_PASSED, visibleQueries[current]);
+    drawLight();
+    glEndQuery(GL_SAMPLES_PASSED);
+    glDepthFunc(GL_ALWAYS);
+    glBeginQuery(GL_SAMPLES_PASSED, totalQueries[current]);
+    drawLight();
+    glEndQuery(GL_SAMPLES_PASSED);
+    glDepthFunc(GLenum(depthFunc));
+    glDepthMask(GL_TRUE);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    issued[current] = true;
+    current = 1 - current;
+
+    // the other pair was issued one frame ago, fetch it if the GPU is done with it
+    if (issued[current])
+    {
+        GLint available = 0;
+        glGetQueryObjectiv(totalQueries[current], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available)
+        {
+            GLuint visible = 0, total = 0;
+            glGetQueryObjectuiv(visibleQueries[current], GL_QUERY_RESULT, &visible);
+            glGetQueryObjectuiv(totalQueries[current], GL_QUERY_RESULT, &total);
+            unoccluded = (total > 0) ? std::min(float(visible) / float(total), 1.0f) : 0.0f;
+            issued[current] = false;
+        }
+    }
+}
+
+void LightVisibility::destroy()
+{
+    if (visibleQueries[0] != 0)
+    {
+        glDeleteQueries(2, visibleQueries);
+        glDeleteQueries(2, totalQueries);
+    }
+    visibleQueries[0] = visibleQueries[1] = totalQueries[0] = totalQueries[1] = 0;
+    issued[0] = issued[1] = false;
+}
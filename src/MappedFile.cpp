@@ -0,0 +1,83 @@
+#include "MappedFile.hpp"
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+bool MappedFile::open(const std::string & filename)
+{
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE view = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (view == nullptr)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    mapping = MapViewOfFile(view, FILE_MAP_READ, 0, 0, 0);
+    if (mapping == nullptr)
+    {
+        CloseHandle(view);
+        CloseHandle(file);
+        return false;
+    }
+    fileHandle = file;
+    mappingHandle = view;
+    length = static_cast<std::size_t>(fileSize.QuadPart);
+#else
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st{};
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void * ptr = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping stays valid once the descriptor is closed
+    ::close(fd);
+    if (ptr == MAP_FAILED) return false;
+
+    madvise(ptr, static_cast<std::size_t>(st.st_size), MADV_SEQUENTIAL);
+    mapping = ptr;
+    length = static_cast<std::size_t>(st.st_size);
+#endif
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (mapping == nullptr) return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(mapping);
+    CloseHandle(static_cast<HANDLE>(mappingHandle));
+    CloseHandle(static_cast<HANDLE>(fileHandle));
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+#else
+    munmap(mapping, length);
+#endif
+    mapping = nullptr;
+    length = 0;
+}
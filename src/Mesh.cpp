@@ -1,4 +1,21 @@
 #include "Mesh.hpp"
+#include "MappedFile.hpp"
+#include "Parallel.hpp"
+
+#include <gtc/packing.hpp>
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+
+#if defined(__AVX__)
+    #include <immintrin.h>
+#elif defined(__SSE2__)
+    #include <emmintrin.h>
+#endif
 
 // ******************************************************************************************************
 // ******************************************************************************************************
@@ -10,16 +27,49 @@ Mesh::Mesh(const char * filename)
 {
     bounding_box = BOX();
 
-    load_OFF_file(filename, indexed_vertices, indexed_normals, indices, triangles,
-                  bounding_box.xpos, bounding_box.ypos, bounding_box.zpos);
+    // reuse the binary cache if it was written from this exact source file
+    bool cached = false;
+    for (const auto & cacheName : binary_cache_paths(filename))
+    {
+        if ((cached = load_OFFB_file(cacheName, filename))) break;
+    }
+
+    if (!cached)
+    {
+        if (!load_OFF_file(filename, indexed_vertices, indexed_normals, indices,
+                           bounding_box.xpos, bounding_box.ypos, bounding_box.zpos))
+        {
+            // an empty mesh (MeshLoader::failed), never written to the cache
+            std::cerr << "Mesh " << filename << " could not be loaded" << std::endl;
+            indexed_vertices.clear();
+            indexed_normals.clear();
+            indices.clear();
+            bounding_box = BOX();
+            return;
+        }
+        invalidate_adjacency();
+        indexed_uvs.resize(indexed_vertices.size(), glm::vec2(1.)); //List vide de UV
+
+        compute_smooth_vertex_normals(0);
+        optimize_for_gpu();
+        build_lod_chain();
+        unwrap_uvs();
+        bake_thickness();
+        select_index_width();
+
+        for (const auto & cacheName : binary_cache_paths(filename))
+        {
+            if (save_OFFB_file(cacheName, filename)) break;
+        }
+    }
+    bake_occlusion();
+    select_vertex_format();
+
     std::cout << "**********\nBounding box :" << std::endl;
     std::cout << "(xmin, xmax) = (" << bounding_box.xpos.x << ", " << bounding_box.xpos.y << ")" << std::endl;
     std::cout << "(ymin, ymax) = (" << bounding_box.ypos.x << ", " << bounding_box.ypos.y << ")" << std::endl;
     std::cout << "(zmin, zmax) = (" << bounding_box.zpos.x << ", " << bounding_box.zpos.y << ")" << std::endl;
     std::cout << "**********" << std::endl;
-    indexed_uvs.resize(indexed_vertices.size(), glm::vec2(1.)); //List vide de UV
-
-    compute_smooth_vertex_normals(0);
 }
 
 // ******************************************************************************************************
@@ -28,160 +78,364 @@ Mesh::Mesh(const char * filename)
 // destructor
 Mesh::~Mesh() = default;
 
+// ******************************************************************************************************
+// ******************************************************************************************************
+// ******************************************************************************************************
+// index width
+void Mesh::select_index_width(bool force_32_bits)
+{
+    // 16 bits indices address vertices 0 to 65535
+    index_width = (force_32_bits || indexed_vertices.size() > 65536) ? INDEX_32_BITS : INDEX_16_BITS;
+}
+
+void Mesh::pack_indices(std::vector<unsigned char> & buffer) const
+{
+    buffer.resize((indices.size() + lod_indices.size()) * index_width);
+    if (index_width == INDEX_32_BITS)
+    {
+        std::memcpy(buffer.data(), indices.data(), indices.size() * sizeof(unsigned int));
+        std::memcpy(buffer.data() + indices.size() * sizeof(unsigned int), lod_indices.data(),
+                    lod_indices.size() * sizeof(unsigned int));
+        return;
+    }
+    auto * packed = reinterpret_cast<unsigned short *>(buffer.data());
+    for (std::size_t i = 0; i < indices.size(); ++i) packed[i] = static_cast<unsigned short>(indices[i]);
+    packed += indices.size();
+    for (std::size_t i = 0; i < lod_indices.size(); ++i) packed[i] = static_cast<unsigned short>(lod_indices[i]);
+}
+
+std::size_t Mesh::memory_usage() const
+{
+    auto bytes = [](const auto & v) { return v.capacity() * sizeof(v[0]); };
+    return bytes(valence_field) + bytes(indices) + bytes(lod_indices) + bytes(lods)
+         + bytes(indexed_vertices) + bytes(indexed_normals) + bytes(indexed_uvs)
+         + bytes(triangle_normals) + bytes(triangle_areas) + bytes(vertex_thickness)
+         + bytes(vertex_occlusion)
+         + bytes(vertex_adjacency.neighbor_offsets) + bytes(vertex_adjacency.neighbors)
+         + bytes(vertex_adjacency.corner_offsets) + bytes(vertex_adjacency.corners)
+         + triangle_bvh.memory_usage();
+}
+
 // ******************************************************************************************************
 // ******************************************************************************************************
 // ******************************************************************************************************
 // normal computation
 void Mesh::compute_smooth_vertex_normals(int weight_type)
 {
-    compute_smooth_vertex_normals(indexed_vertices, triangles, weight_type, indexed_normals);
+    compute_triangle_normals(indexed_vertices, indices, triangle_normals, triangle_areas);
+    compute_smooth_vertex_normals(indexed_vertices, indices, triangle_normals, triangle_areas, adjacency(),
+                                  weight_type, indexed_normals);
 }
 
 
+namespace {
+
+// lanes used by the per-triangle pass : AVX when the compiler targets it, SSE2 on any x86-64,
+// plain floats otherwise. Only exact IEEE operations are used (no rsqrt, no FMA) so that every
+// width gives the same bits as glm::normalize / glm::length on one triangle.
+#if defined(__AVX__)
+typedef __m256 lanes;
+const std::size_t LANES = 8;
+inline lanes lanes_load(const float * p) { return _mm256_loadu_ps(p); }
+inline void lanes_store(float * p, lanes a) { _mm256_storeu_ps(p, a); }
+inline lanes lanes_set(float a) { return _mm256_set1_ps(a); }
+inline lanes lanes_add(lanes a, lanes b) { return _mm256_add_ps(a, b); }
+inline lanes lanes_sub(lanes a, lanes b) { return _mm256_sub_ps(a, b); }
+inline lanes lanes_mul(lanes a, lanes b) { return _mm256_mul_ps(a, b); }
+inline lanes lanes_div(lanes a, lanes b) { return _mm256_div_ps(a, b); }
+inline lanes lanes_sqrt(lanes a) { return _mm256_sqrt_ps(a); }
+#elif defined(__SSE2__)
+typedef __m128 lanes;
+const std::size_t LANES = 4;
+inline lanes lanes_load(const float * p) { return _mm_loadu_ps(p); }
+inline void lanes_store(float * p, lanes a) { _mm_storeu_ps(p, a); }
+inline lanes lanes_set(float a) { return _mm_set1_ps(a); }
+inline lanes lanes_add(lanes a, lanes b) { return _mm_add_ps(a, b); }
+inline lanes lanes_sub(lanes a, lanes b) { return _mm_sub_ps(a, b); }
+inline lanes lanes_mul(lanes a, lanes b) { return _mm_mul_ps(a, b); }
+inline lanes lanes_div(lanes a, lanes b) { return _mm_div_ps(a, b); }
+inline lanes lanes_sqrt(lanes a) { return _mm_sqrt_ps(a); }
+#else
+typedef float lanes;
+const std::size_t LANES = 1;
+inline lanes lanes_load(const float * p) { return *p; }
+inline void lanes_store(float * p, lanes a) { *p = a; }
+inline lanes lanes_set(float a) { return a; }
+inline lanes lanes_add(lanes a, lanes b) { return a + b; }
+inline lanes lanes_sub(lanes a, lanes b) { return a - b; }
+inline lanes lanes_mul(lanes a, lanes b) { return a * b; }
+inline lanes lanes_div(lanes a, lanes b) { return a / b; }
+inline lanes lanes_sqrt(lanes a) { return std::sqrt(a); }
+#endif
+
+const std::size_t TRIANGLE_GRAIN = 4096;
+const std::size_t VERTEX_GRAIN = 4096;
+
+} // namespace
+
 void Mesh::compute_triangle_normals (const std::vector<glm::vec3> & vertices,
-                                     const std::vector<std::vector<unsigned short> > & triangles,
-                                     std::vector<glm::vec3> & triangle_normals)
+                                     const std::vector<unsigned int> & triangles,
+                                     std::vector<glm::vec3> & triangle_normals,
+                                     std::vector<float> & triangle_areas)
 {
-    for(auto triangle : triangles)
-    {
-        glm::vec3 p0 = vertices.at(triangle.at(0));
-        glm::vec3 p1 = vertices.at(triangle.at(1));
-        glm::vec3 p2 = vertices.at(triangle.at(2));
-
-        glm::vec3 n = glm::normalize(glm::cross(p1-p0, p2-p0));
-
-        triangle_normals.push_back(n);
-    }
+    const std::size_t numberOfTriangles = triangles.size() / 3;
+    triangle_normals.resize(numberOfTriangles);
+    triangle_areas.resize(numberOfTriangles);
+
+    parallel_for(0, numberOfTriangles, TRIANGLE_GRAIN, [&](std::size_t first, std::size_t last) {
+        // LANES triangles at a time, transposed to one register per coordinate
+        float p[9][LANES], out[4][LANES];
+        for (std::size_t i = first; i < last; i += LANES)
+        {
+            const std::size_t count = std::min(LANES, last - i);
+            for (std::size_t l = 0; l < LANES; ++l)
+            {
+                // pad the last block with a copy of its first triangle
+                const unsigned int * t = &triangles[3 * (i + (l < count ? l : 0))];
+                for (std::size_t k = 0; k < 3; ++k)
+                {
+                    p[3 * k + 0][l] = vertices[t[k]].x;
+                    p[3 * k + 1][l] = vertices[t[k]].y;
+                    p[3 * k + 2][l] = vertices[t[k]].z;
+                }
+            }
+            lanes x0 = lanes_load(p[0]), y0 = lanes_load(p[1]), z0 = lanes_load(p[2]);
+            lanes ax = lanes_sub(lanes_load(p[3]), x0), ay = lanes_sub(lanes_load(p[4]), y0), az = lanes_sub(lanes_load(p[5]), z0);
+            lanes bx = lanes_sub(lanes_load(p[6]), x0), by = lanes_sub(lanes_load(p[7]), y0), bz = lanes_sub(lanes_load(p[8]), z0);
+
+            // same operation order as glm::cross, glm::dot and glm::normalize
+            lanes cx = lanes_sub(lanes_mul(ay, bz), lanes_mul(by, az));
+            lanes cy = lanes_sub(lanes_mul(az, bx), lanes_mul(bz, ax));
+            lanes cz = lanes_sub(lanes_mul(ax, by), lanes_mul(bx, ay));
+            lanes length = lanes_sqrt(lanes_add(lanes_add(lanes_mul(cx, cx), lanes_mul(cy, cy)), lanes_mul(cz, cz)));
+            lanes inverse = lanes_div(lanes_set(1.0f), length);
+
+            lanes_store(out[0], lanes_mul(cx, inverse));
+            lanes_store(out[1], lanes_mul(cy, inverse));
+            lanes_store(out[2], lanes_mul(cz, inverse));
+            lanes_store(out[3], lanes_div(length, lanes_set(2.0f)));
+            for (std::size_t l = 0; l < count; ++l)
+            {
+                triangle_normals[i + l] = glm::vec3(out[0][l], out[1][l], out[2][l]);
+                triangle_areas[i + l] = out[3][l];
+            }
+        }
+    });
 }
 
 void Mesh::compute_smooth_vertex_normals (const std::vector<glm::vec3> & vertices,
-                                          const std::vector<std::vector<unsigned short> > & triangles,
+                                          const std::vector<unsigned int> & triangles,
+                                          const std::vector<glm::vec3> & triangle_normals,
+                                          const std::vector<float> & triangle_areas,
+                                          const MeshAdjacency & adjacency,
                                           unsigned int weight_type, //0 uniforme, 1 area of triangles, 2 angle of triangle
                                           std::vector<glm::vec3> & vertex_normals){
 
-    vertex_normals.clear();
-    vertex_normals.resize(vertices.size(), glm::vec3(0.0));
+    const std::size_t numberOfTriangles = triangles.size() / 3;
+    vertex_normals.resize(vertices.size());
 
-    std::vector<glm::vec3> triangle_normals;
-    std::vector<glm::vec3> triangle_angles;
-    std::vector<float> triangle_surface, point_aire_triangles, point_angles_triangles;
-
-    compute_triangle_normals(vertices, triangles, triangle_normals);
-    triangle_angles.resize(triangles.size(), glm::vec3(0.0));
-    triangle_surface.resize(triangles.size(),0.0);
-    point_aire_triangles.resize(vertices.size(),0.0f);
-    point_angles_triangles.resize(vertices.size(), 0.0f);
-
-    for(unsigned int i = 0; i < triangles.size(); ++i)
+    // angle of each corner of each triangle
+    std::vector<float> corner_angles;
+    if (weight_type == 2)
     {
-        glm::vec3 p0 = vertices.at(triangles.at(i).at(0));
-        glm::vec3 p1 = vertices.at(triangles.at(i).at(1));
-        glm::vec3 p2 = vertices.at(triangles.at(i).at(2));
-
-        switch(weight_type){
-            case 0 :
-                // we add normal of the current triangle to each vertex
-                vertex_normals.at(triangles.at(i).at(0)) += triangle_normals.at(i);
-                vertex_normals.at(triangles.at(i).at(1)) += triangle_normals.at(i);
-                vertex_normals.at(triangles.at(i).at(2)) += triangle_normals.at(i);
-                break;
-
-            case 1:
-                // we add area of a triangle to each vertices
-                triangle_surface.at(i) = glm::dot(p1-p0, p2-p0)/2.0f;
-                point_aire_triangles.at(triangles.at(i).at(0)) += triangle_surface.at(i);
-                point_aire_triangles.at(triangles.at(i).at(1)) += triangle_surface.at(i);
-                point_aire_triangles.at(triangles.at(i).at(2)) += triangle_surface.at(i);
-                break;
-
-            case 2:
-                // we add near triangle's area with current triangle of a vertex
-                triangle_angles.at(i).x = acos(glm::radians(glm::dot(p1-p0, p2-p0)/
-                                                            (glm::length(p1-p0) * glm::length(p2-p0))));
-                triangle_angles.at(i).y = acos(glm::radians(glm::dot(p2-p1, p0-p1)/
-                                                            (glm::length(p0-p1) * glm::length(p2-p1))));
-                triangle_angles.at(i).z = acos(glm::radians(glm::dot(p0-p2, p1-p2)/
-                                                            (glm::length(p0-p2) * glm::length(p1-p2))));
-
-                point_angles_triangles.at(triangles.at(i).at(0)) += triangle_angles.at(i).x;
-                point_angles_triangles.at(triangles.at(i).at(1)) += triangle_angles.at(i).y;
-                point_angles_triangles.at(triangles.at(i).at(2)) += triangle_angles.at(i).z;
-                break;
-        }
+        corner_angles.resize(triangles.size());
+        parallel_for(0, numberOfTriangles, TRIANGLE_GRAIN, [&](std::size_t first, std::size_t last) {
+            for (std::size_t i = first; i < last; ++i)
+            {
+                const glm::vec3 & p0 = vertices[triangles[3 * i]];
+                const glm::vec3 & p1 = vertices[triangles[3 * i + 1]];
+                const glm::vec3 & p2 = vertices[triangles[3 * i + 2]];
+                corner_angles[3 * i]     = acos(glm::radians(glm::dot(p1-p0, p2-p0)/
+                                                             (glm::length(p1-p0) * glm::length(p2-p0))));
+                corner_angles[3 * i + 1] = acos(glm::radians(glm::dot(p2-p1, p0-p1)/
+                                                             (glm::length(p0-p1) * glm::length(p2-p1))));
+                corner_angles[3 * i + 2] = acos(glm::radians(glm::dot(p0-p2, p1-p2)/
+                                                             (glm::length(p0-p2) * glm::length(p1-p2))));
+            }
+        });
     }
 
-    switch(weight_type){
-        case 1 :
-            // we divide the weight of the normal for each triangle with the area
-            for(int i = 0 ; i < triangles.size() ; i++){
-                vertex_normals.at(triangles.at(i).at(0)) += triangle_normals.at(i)*
-                                                            (triangle_surface.at(i)/point_aire_triangles.at(triangles.at(i).at(0)));
-                vertex_normals.at(triangles.at(i).at(1)) += triangle_normals.at(i)*
-                                                            (triangle_surface.at(i)/point_aire_triangles.at(triangles.at(i).at(1)));
-                vertex_normals.at(triangles.at(i).at(2)) += triangle_normals.at(i)*
-                                                            (triangle_surface.at(i)/point_aire_triangles.at(triangles.at(i).at(2)));
-            }
-            break;
-
-        case 2 :
-            // we devide the weight of the normal with each vertex depending of the angle of
-            // near triangles normalize with max angle
-            for(int i = 0 ; i < triangles.size() ; i++){
-                vertex_normals.at(triangles.at(i).at(0)) += triangle_normals.at(i)*
-                                                            (triangle_angles.at(i).x/point_angles_triangles.at(triangles.at(i).at(0)));
-                vertex_normals.at(triangles.at(i).at(1)) += triangle_normals.at(i)*
-                                                            (triangle_angles.at(i).y/point_angles_triangles.at(triangles.at(i).at(1)));
-                vertex_normals.at(triangles.at(i).at(2)) += triangle_normals.at(i)*
-                                                            (triangle_angles.at(i).z/point_angles_triangles.at(triangles.at(i).at(2)));
+    // gather the triangles around each vertex instead of scattering into the vertices : every
+    // vertex is written by one thread only and its triangles are summed in increasing order,
+    // which is the order of the serial scatter, so the result is bit-identical to it
+    parallel_for(0, vertices.size(), VERTEX_GRAIN, [&](std::size_t first, std::size_t last) {
+        for (std::size_t v = first; v < last; ++v)
+        {
+            const unsigned int * begin = adjacency.corners_begin(v);
+            const unsigned int * end = adjacency.corners_end(v);
+            glm::vec3 normal(0.0f);
+            float weight = 0.0f;
+
+            switch(weight_type){
+                case 0 :
+                    // we add normal of the current triangle to each vertex
+                    for (const unsigned int * c = begin; c != end; ++c) normal += triangle_normals[*c / 3];
+                    break;
+
+                case 1 :
+                    // we divide the weight of the normal for each triangle with the area
+                    for (const unsigned int * c = begin; c != end; ++c) weight += triangle_areas[*c / 3];
+                    for (const unsigned int * c = begin; c != end; ++c)
+                        normal += triangle_normals[*c / 3] * (triangle_areas[*c / 3] / weight);
+                    break;
+
+                case 2 :
+                    // we devide the weight of the normal with each vertex depending of the angle of
+                    // near triangles normalize with max angle
+                    for (const unsigned int * c = begin; c != end; ++c) weight += corner_angles[*c];
+                    for (const unsigned int * c = begin; c != end; ++c)
+                        normal += triangle_normals[*c / 3] * (corner_angles[*c] / weight);
+                    break;
             }
-            break;
+
+            // we nomalize normals
+            vertex_normals[v] = glm::normalize(normal);
+        }
+    });
+}
+
+void Mesh::collect_one_ring (const std::vector<glm::vec3> & vertices,
+                             const std::vector<unsigned int> & triangles,
+                             std::vector<std::vector<unsigned int> > & one_ring)
+{
+    MeshAdjacency ring;
+    ring.build(vertices.size(), triangles);
+
+    one_ring.resize(vertices.size());
+    for (std::size_t v = 0; v < vertices.size(); ++v)
+    {
+        one_ring[v].assign(ring.neighbors_begin(v), ring.neighbors_end(v));
     }
+}
+
+// ******************************************************************************************************
+// ******************************************************************************************************
+// ******************************************************************************************************
+// vertex format
+namespace {
 
-    // we nomalize normals
-    for(unsigned int i = 0 ; i < vertex_normals.size(); ++i)
+// octahedral encoding (Meyer et al. 2010) : the unit sphere is projected on the octahedron
+// |x| + |y| + |z| = 1, whose lower half is folded over the upper one, then on the z = 0 plane
+glm::vec2 octahedral_encode(const glm::vec3 & n)
+{
+    float sum = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    if (sum == 0.0f) return glm::vec2(0.0f);
+    glm::vec2 p = glm::vec2(n.x, n.y) / sum;
+    if (n.z < 0.0f)
     {
-        vertex_normals.at(i) = glm::normalize(vertex_normals.at(i));
+        glm::vec2 sign(p.x >= 0.0f ? 1.0f : -1.0f, p.y >= 0.0f ? 1.0f : -1.0f);
+        p = (glm::vec2(1.0f) - glm::abs(glm::vec2(p.y, p.x))) * sign;
     }
+    return p;
 }
 
-void Mesh::collect_one_ring (const std::vector<glm::vec3> & vertices,
-                             const std::vector<std::vector<unsigned short> > & triangles,
-                             std::vector<std::vector<unsigned short> > & one_ring)
+} // namespace
+
+void Mesh::select_vertex_format(VertexFormat format, bool quantize_positions)
 {
-    one_ring.resize(vertices.size());
+    vertex_format = format;
+    quantized_positions = quantize_positions;
+    packed_uvs = std::any_of(indexed_uvs.begin(), indexed_uvs.end(),
+                             [this](const glm::vec2 & uv) { return uv != indexed_uvs[0]; });
+}
+
+unsigned int Mesh::vertex_stride() const
+{
+    if (vertex_format == VERTEX_FLOAT) return 2 * sizeof(glm::vec3) + 2 * sizeof(glm::vec2);
+    return (quantized_positions ? 4 * sizeof(std::uint16_t) : sizeof(glm::vec3)) + 2 * sizeof(std::int16_t)
+         + (packed_uvs ? 2 * sizeof(std::uint16_t) : 0) + 4 * sizeof(std::uint8_t);
+}
+
+glm::vec3 Mesh::position_offset() const
+{
+    if (vertex_format == VERTEX_FLOAT || !quantized_positions) return glm::vec3(0.0f);
+    return glm::vec3(bounding_box.xpos.x, bounding_box.ypos.x, bounding_box.zpos.x);
+}
 
-    for (unsigned int i = 0 ; i < triangles.size() ; ++i)
+glm::vec3 Mesh::position_scale() const
+{
+    if (vertex_format == VERTEX_FLOAT || !quantized_positions) return glm::vec3(1.0f);
+    return glm::vec3(bounding_box.xpos.y - bounding_box.xpos.x, bounding_box.ypos.y - bounding_box.ypos.x,
+                     bounding_box.zpos.y - bounding_box.zpos.x);
+}
+
+void Mesh::pack_vertices(std::vector<unsigned char> & buffer) const
+{
+    const std::size_t numberOfVertices = indexed_vertices.size();
+    const std::size_t stride = vertex_stride();
+    buffer.resize(numberOfVertices * stride);
+
+    const glm::vec3 offset = position_offset(), scale = position_scale();
+    const glm::vec3 inverseScale(scale.x > 0.0f ? 1.0f / scale.x : 0.0f, scale.y > 0.0f ? 1.0f / scale.y : 0.0f,
+                                 scale.z > 0.0f ? 1.0f / scale.z : 0.0f);
+    parallel_for(0, numberOfVertices, VERTEX_GRAIN, [&](std::size_t first, std::size_t last) {
+        for (std::size_t v = first; v < last; ++v)
+        {
+            unsigned char * out = buffer.data() + v * stride;
+            if (quantized_positions)
+            {
+                glm::vec3 p = (indexed_vertices[v] - offset) * inverseScale;
+                std::uint16_t q[4] = {glm::packUnorm1x16(p.x), glm::packUnorm1x16(p.y), glm::packUnorm1x16(p.z), 0};
+                std::memcpy(out, q, sizeof(q)); out += sizeof(q);
+            }
+            else
+            {
+                std::memcpy(out, &indexed_vertices[v], sizeof(glm::vec3)); out += sizeof(glm::vec3);
+            }
+
+            glm::vec2 e = octahedral_encode(v < indexed_normals.size() ? indexed_normals[v] : glm::vec3(0.0f));
+            std::uint16_t n[2] = {glm::packSnorm1x16(e.x), glm::packSnorm1x16(e.y)};
+            std::memcpy(out, n, sizeof(n)); out += sizeof(n);
+
+            if (packed_uvs)
+            {
+                std::uint16_t uv[2] = {glm::packUnorm1x16(indexed_uvs[v].x), glm::packUnorm1x16(indexed_uvs[v].y)};
+                std::memcpy(out, uv, sizeof(uv)); out += sizeof(uv);
+            }
+
+            std::uint8_t baked[4] = {glm::packUnorm1x8(v < vertex_thickness.size() ? vertex_thickness[v] : 1.0f),
+                                     glm::packUnorm1x8(v < vertex_occlusion.size() ? vertex_occlusion[v] : 1.0f), 0, 0};
+            std::memcpy(out, baked, sizeof(baked));
+        }
+    });
+}
+
+// ******************************************************************************************************
+// ******************************************************************************************************
+// ******************************************************************************************************
+// adjacency
+const MeshAdjacency & Mesh::adjacency()
+{
+    if (vertex_adjacency.empty() || vertex_adjacency.getNumberOfVertices() != indexed_vertices.size())
     {
-        if (std::find(one_ring.at(triangles.at(i).at(0)).begin(),
-                      one_ring.at(triangles.at(i).at(0)).end(),
-                      triangles.at(i).at(1)) == one_ring.at(triangles.at(i).at(0)).end())
-            one_ring.at(triangles.at(i).at(0)).push_back(triangles.at(i).at(1));
-
-        if (std::find(one_ring.at(triangles.at(i).at(0)).begin(),
-                      one_ring.at(triangles.at(i).at(0)).end(),
-                      triangles.at(i).at(2)) == one_ring.at(triangles.at(i).at(0)).end())
-            one_ring.at(triangles.at(i).at(0)).push_back(triangles.at(i).at(2));
-
-        if (std::find(one_ring.at(triangles.at(i).at(1)).begin(),
-                      one_ring.at(triangles.at(i).at(1)).end(),
-                      triangles.at(i).at(0)) == one_ring.at(triangles.at(i).at(1)).end())
-            one_ring.at(triangles.at(i).at(1)).push_back(triangles.at(i).at(0));
-
-        if (std::find(one_ring.at(triangles.at(i).at(1)).begin(),
-                      one_ring.at(triangles.at(i).at(1)).end(),
-                      triangles.at(i).at(2)) == one_ring.at(triangles.at(i).at(1)).end())
-            one_ring.at(triangles.at(i).at(1)).push_back(triangles.at(i).at(2));
-
-        if (std::find(one_ring.at(triangles.at(i).at(2)).begin(),
-                      one_ring.at(triangles.at(i).at(2)).end(),
-                      triangles.at(i).at(0)) == one_ring.at(triangles.at(i).at(2)).end())
-            one_ring.at(triangles.at(i).at(2)).push_back(triangles.at(i).at(0));
-
-        if (std::find(one_ring.at(triangles.at(i).at(2)).begin(),
-                      one_ring.at(triangles.at(i).at(2)).end(),
-                      triangles.at(i).at(1)) == one_ring.at(triangles.at(i).at(2)).end())
-            one_ring.at(triangles.at(i).at(2)).push_back(triangles.at(i).at(1));
+        vertex_adjacency.build(indexed_vertices.size(), indices);
     }
+    return vertex_adjacency;
+}
+
+void Mesh::invalidate_adjacency()
+{
+    vertex_adjacency.clear();
+}
+
+const MeshBVH & Mesh::bvh()
+{
+    if (triangle_bvh.empty() && !indices.empty()) triangle_bvh.build(indexed_vertices, indices);
+    return triangle_bvh;
+}
+
+void Mesh::invalidate_bvh()
+{
+    triangle_bvh.clear();
+}
+
+void Mesh::compute_valence_field()
+{
+    const MeshAdjacency & ring = adjacency();
+    valence_field.resize(indexed_vertices.size());
+    parallel_for(0, indexed_vertices.size(), VERTEX_GRAIN, [&](std::size_t first, std::size_t last) {
+        for (std::size_t v = first; v < last; ++v) valence_field[v] = float(ring.valence(v));
+    });
 }
 
 
@@ -190,137 +444,412 @@ void Mesh::collect_one_ring (const std::vector<glm::vec3> & vertices,
 // ******************************************************************************************************
 // load off file
 
+namespace {
+
+inline bool is_space(char c)
+{
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f';
+}
+
+inline const char * skip_spaces(const char * first, const char * last)
+{
+    while (first < last && is_space(*first)) ++first;
+    return first;
+}
+
+inline const char * skip_token(const char * first, const char * last)
+{
+    while (first < last && !is_space(*first)) ++first;
+    return first;
+}
+
+// parse a number and leave @first just after it, false on malformed token
+template <typename T>
+inline bool parse_number(const char *& first, const char * last, T & value)
+{
+    if (first < last && *first == '+') ++first; // accepted by >>, not by from_chars
+    std::from_chars_result result = std::from_chars(first, last, value);
+    if (result.ec != std::errc() || (result.ptr < last && !is_space(*result.ptr))) return false;
+    first = result.ptr;
+    return true;
+}
+
+// slice of the OFF body, split on whitespace so that no token straddles two chunks
+struct OFFChunk {
+    const char * first, * last;
+    std::size_t firstToken, tokenCount;
+    glm::vec3 minimum, maximum;
+    bool failed;
+};
+
+} // namespace
 
 bool Mesh::load_OFF_file(const std::string & filename, std::vector< glm::vec3 > & vertices,
-                         std::vector< glm::vec3 > & normals, std::vector< unsigned short > & indices,
-                         std::vector< std::vector<unsigned short > > & triangles,
+                         std::vector< glm::vec3 > & normals, std::vector< unsigned int > & indices,
                          glm::vec2 & xpos, glm::vec2 & ypos, glm::vec2 & zpos)
 {
-    std::ifstream myfile; myfile.open(filename.c_str());
-    if (!myfile.is_open())
+    auto start = std::chrono::steady_clock::now();
+
+    MappedFile file(filename);
+    if (!file.is_open())
     {
         std::cout << "Failure to open " <<filename << " file"<< std::endl;
         return false;
     }
-
-    std::string isOFFfile; myfile >> isOFFfile;
-    if(isOFFfile != "OFF")
+    const char * cursor = file.data();
+    const char * end = file.data() + file.size();
+
+    // header : OFF numberOfVertices numberOfFaces numberOfEdges
+    cursor = skip_spaces(cursor, end);
+    const char * token = cursor;
+    cursor = skip_token(cursor, end);
+    if (std::string(token, cursor) != "OFF")
     {
         std::cerr << "File " << filename << " isn't an OFF format file" << std::endl;
-        myfile.close();
         return false;
     }
 
-    int numberOfVertices , numberOfFaces , numberOfEdges;
-    myfile >> numberOfVertices >> numberOfFaces >> numberOfEdges;
-
-    vertices.resize(numberOfVertices);
-    normals.resize(numberOfVertices);
+    int numberOfVertices(0), numberOfFaces(0), numberOfEdges(0);
+    cursor = skip_spaces(cursor, end);
+    bool header = parse_number(cursor, end, numberOfVertices);
+    cursor = skip_spaces(cursor, end);
+    header = header && parse_number(cursor, end, numberOfFaces);
+    cursor = skip_spaces(cursor, end);
+    header = header && parse_number(cursor, end, numberOfEdges);
+    if (!header || numberOfVertices < 0 || numberOfFaces < 0)
+    {
+        std::cerr << "File " << filename << " has a malformed OFF header" << std::endl;
+        return false;
+    }
 
-    std::vector< std::vector<glm::vec3> > normalsTmp;
-    normalsTmp.resize(numberOfVertices);
+    // every vertex is 3 tokens, every face is 4 tokens ("3 v1 v2 v3") so the global
+    // position of a token tells which vertex coordinate or face index it is
+    const std::size_t vertexTokens = std::size_t(numberOfVertices) * 3;
+    const std::size_t faceTokens = std::size_t(numberOfFaces) * 4;
 
+    // split the body in chunks aligned on whitespace
+    const std::size_t bodySize = std::size_t(end - cursor);
+    const std::size_t minChunkSize = 256 * 1024;
+    const std::size_t numberOfChunks = std::max<std::size_t>(1, std::min<std::size_t>(
+            bodySize / minChunkSize, std::size_t(worker_count()) * 4));
 
-    for( int v = 0 ; v < numberOfVertices ; ++v )
+    std::vector<OFFChunk> chunks(numberOfChunks);
+    const char * chunkStart = cursor;
+    for (std::size_t c = 0; c < numberOfChunks; ++c)
     {
-        glm::vec3 vertex;
-        myfile >> vertex.x >> vertex.y >> vertex.z;
-        vertices[v] = vertex;
+        const char * chunkEnd = (c + 1 == numberOfChunks) ? end
+                              : skip_token(cursor + bodySize * (c + 1) / numberOfChunks, end);
+        chunkEnd = std::max(chunkEnd, chunkStart);
+        chunks[c] = {chunkStart, chunkEnd, 0, 0, glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX), false};
+        chunkStart = chunkEnd;
+    }
 
-        if(v == 0)
+    // first pass : count tokens of each chunk, then prefix sum
+    parallel_for(0, numberOfChunks, 1, [&](std::size_t first, std::size_t last) {
+        for (std::size_t c = first; c < last; ++c)
         {
-            xpos.x = vertex.x; xpos.y = vertex.x;
-            ypos.x = vertex.y; ypos.y = vertex.y;
-            zpos.x = vertex.z; zpos.y = vertex.z;
+            std::size_t count = 0;
+            const char * p = skip_spaces(chunks[c].first, chunks[c].last);
+            while (p < chunks[c].last)
+            {
+                ++count;
+                p = skip_spaces(skip_token(p, chunks[c].last), chunks[c].last);
+            }
+            chunks[c].tokenCount = count;
         }
-        else
-        {
-            if(xpos.x > vertex.x) xpos.x = vertex.x;
-            if(xpos.y < vertex.x) xpos.y = vertex.x;
-
-            if(ypos.x > vertex.y) ypos.x = vertex.y;
-            if(ypos.y < vertex.y) ypos.y = vertex.y;
+    });
 
-            if(zpos.x > vertex.z) zpos.x = vertex.z;
-            if(zpos.y < vertex.z) zpos.y = vertex.z;
-        }
+    std::size_t numberOfTokens = 0;
+    for (auto & chunk : chunks)
+    {
+        chunk.firstToken = numberOfTokens;
+        numberOfTokens += chunk.tokenCount;
     }
-
-
-    for( int f = 0 ; f < numberOfFaces ; ++f )
+    if (numberOfTokens < vertexTokens + faceTokens)
     {
-        int numberOfVerticesOnFace;
-        myfile >> numberOfVerticesOnFace;
-        if( numberOfVerticesOnFace == 3 )
-        {
-            unsigned short v1 , v2 , v3;
-            std::vector< unsigned short > v;
-            myfile >> v1 >> v2 >> v3;
-
-            v.push_back(v1);
-            v.push_back(v2);
-            v.push_back(v3);
-
-            triangles.push_back(v);
-
-            indices.push_back(v1);
-            indices.push_back(v2);
-            indices.push_back(v3);
+        std::cerr << "File " << filename << " ends before its " << numberOfVertices << " vertices and "
+                  << numberOfFaces << " faces" << std::endl;
+        return false;
+    }
 
-            glm::vec3 normal;
-            glm::vec3 tmp1 = vertices[v2] - vertices[v1];
-            glm::vec3 tmp2 = vertices[v3] - vertices[v1];
-            normal = glm::normalize(glm::cross(tmp1,tmp2));
-            normalsTmp[v1].push_back(normal);
-            normalsTmp[v2].push_back(normal);
-            normalsTmp[v3].push_back(normal);
+    vertices.resize(numberOfVertices);
+    indices.resize(std::size_t(numberOfFaces) * 3);
 
+    // second pass : parse every chunk in place
+    parallel_for(0, numberOfChunks, 1, [&](std::size_t first, std::size_t last) {
+        for (std::size_t c = first; c < last; ++c)
+        {
+            OFFChunk & chunk = chunks[c];
+            std::size_t t = chunk.firstToken;
+            const char * p = skip_spaces(chunk.first, chunk.last);
+            for (; p < chunk.last && t < vertexTokens + faceTokens; ++t)
+            {
+                if (t < vertexTokens)
+                {
+                    float value;
+                    if (!parse_number(p, chunk.last, value)) { chunk.failed = true; return; }
+                    const std::size_t axis = t % 3;
+                    vertices[t / 3][axis] = value;
+                    chunk.minimum[axis] = std::min(chunk.minimum[axis], value);
+                    chunk.maximum[axis] = std::max(chunk.maximum[axis], value);
+                }
+                else
+                {
+                    const std::size_t f = (t - vertexTokens) / 4;
+                    const std::size_t slot = (t - vertexTokens) % 4;
+                    if (slot == 0)
+                    {
+                        int numberOfVerticesOnFace;
+                        if (!parse_number(p, chunk.last, numberOfVerticesOnFace) || numberOfVerticesOnFace != 3)
+                        { chunk.failed = true; return; }
+                    }
+                    else
+                    {
+                        unsigned int v;
+                        if (!parse_number(p, chunk.last, v) || v >= unsigned(numberOfVertices))
+                        { chunk.failed = true; return; }
+                        indices[f * 3 + slot - 1] = v;
+                    }
+                }
+                p = skip_spaces(p, chunk.last);
+            }
         }
-        else
+    });
+
+    glm::vec3 minimum(FLT_MAX), maximum(-FLT_MAX);
+    for (const auto & chunk : chunks)
+    {
+        if (chunk.failed)
         {
-            std::cerr << "Number of vertices on face must be 3" << std::endl;
-            myfile.close();
+            std::cerr << "File " << filename << " : faces must have 3 valid vertex indices "
+                      << "and vertices 3 coordinates" << std::endl;
             return false;
         }
+        minimum = glm::min(minimum, chunk.minimum);
+        maximum = glm::max(maximum, chunk.maximum);
+    }
+    if (numberOfVertices > 0)
+    {
+        xpos = glm::vec2(minimum.x, maximum.x);
+        ypos = glm::vec2(minimum.y, maximum.y);
+        zpos = glm::vec2(minimum.z, maximum.z);
     }
 
-    for( int v = 0 ; v < numberOfVertices ; ++v )
+    // average of the normals of the faces around each vertex
+    normals.assign(numberOfVertices, glm::vec3(0.0f));
+    std::vector<unsigned int> facesPerVertex(numberOfVertices, 0);
+    for (std::size_t i = 0; i < indices.size(); i += 3)
     {
-        float sizeTmp = normalsTmp[v].size();
-        glm::vec3 tmp;
-        for(auto n : normalsTmp[v])
+        glm::vec3 normal = glm::normalize(glm::cross(vertices[indices[i + 1]] - vertices[indices[i]],
+                                                     vertices[indices[i + 2]] - vertices[indices[i]]));
+        for (std::size_t k = 0; k < 3; ++k)
         {
-            tmp += n;
+            normals[indices[i + k]] += normal;
+            ++facesPerVertex[indices[i + k]];
         }
-        tmp = tmp / sizeTmp;
-        normals[v] = tmp;
+    }
+    for (int v = 0; v < numberOfVertices; ++v)
+    {
+        if (facesPerVertex[v] > 0) normals[v] /= float(facesPerVertex[v]);
     }
 
-    myfile.close();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double megabytes = double(file.size()) / (1024.0 * 1024.0);
+    std::cout << "Loaded " << filename << " : " << megabytes << " MB in " << seconds * 1000.0
+              << " ms (" << megabytes / std::max(seconds, 1e-9) << " MB/s, "
+              << numberOfChunks << " chunks)" << std::endl;
     return true;
 }
 
 // ******************************************************************************************************
 // ******************************************************************************************************
 // ******************************************************************************************************
-// simplify vertices / normals of the mesh
+// binary cache (.offb)
+//
+// header | positions (vec3) | normals (vec3) | uvs (vec2) | thickness (float) | indices then lod
+// indices (16 or 32 bits, see indexWidth) | levels of detail (MeshLod)
+// sections follow each other without padding, all sizes are given by the header
+
+namespace {
+
+const char OFFB_MAGIC[4] = {'O', 'F', 'F', 'B'};
+const std::uint32_t OFFB_VERSION = 7;   // 7 : link condition in the LOD simplification
+
+struct OFFBHeader {
+    char magic[4];
+    std::uint32_t version;
+    // identify the source the cache was written from
+    std::uint64_t sourceSize;
+    std::int64_t sourceTime;
+    // content
+    std::uint32_t numberOfVertices;
+    std::uint32_t numberOfIndices;
+    std::uint32_t numberOfLodIndices;
+    std::uint32_t numberOfLods;
+    std::uint32_t indexWidth;
+    std::uint32_t atlasSize;
+    float box[6];
+};
+
+// size and modification time of the source, false if it doesn't exist
+bool source_stamp(const std::string & source, std::uint64_t & size, std::int64_t & time)
+{
+    std::error_code error;
+    size = std::filesystem::file_size(source, error);
+    if (error) return false;
+    auto lastWrite = std::filesystem::last_write_time(source, error);
+    if (error) return false;
+    time = static_cast<std::int64_t>(lastWrite.time_since_epoch().count());
+    return true;
+}
+
+} // namespace
 
-glm::vec4 Mesh::equation_plane(float x1, float y1, float z1,
-                               float x2, float y2, float z2,
-                               float x3, float y3, float z3)
+std::vector<std::string> Mesh::binary_cache_paths(const std::string & filename)
 {
-    float a1 = x2 - x1;
-    float b1 = y2 - y1;
-    float c1 = z2 - z1;
+    // next to the source first, then in a cache directory if the assets are read-only
+    std::filesystem::path source(filename);
+    std::vector<std::string> paths = {filename + "b"};
+
+    std::error_code error;
+    std::filesystem::path cacheDirectory = std::filesystem::temp_directory_path(error);
+    if (!error)
+    {
+        std::size_t key = std::hash<std::string>()(std::filesystem::absolute(source, error).string());
+        paths.push_back((cacheDirectory / "skin-texture-cache" /
+                         (source.stem().string() + "-" + std::to_string(key) + ".offb")).string());
+    }
+    return paths;
+}
+
+bool Mesh::load_OFFB_file(const std::string & filename, const std::string & source)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    std::uint64_t sourceSize; std::int64_t sourceTime;
+    if (!source_stamp(source, sourceSize, sourceTime)) return false;
+
+    MappedFile file(filename);
+    if (!file.is_open() || file.size() < sizeof(OFFBHeader)) return false;
+
+    OFFBHeader header;
+    std::memcpy(&header, file.data(), sizeof(OFFBHeader));
+    if (std::memcmp(header.magic, OFFB_MAGIC, 4) != 0 || header.version != OFFB_VERSION) return false;
+    if (header.sourceSize != sourceSize || header.sourceTime != sourceTime) return false;
+
+    const std::size_t V = header.numberOfVertices, I = header.numberOfIndices, W = header.indexWidth;
+    const std::size_t L = header.numberOfLodIndices, N = header.numberOfLods;
+    const std::size_t expectedSize = sizeof(OFFBHeader) + V * (2 * sizeof(glm::vec3) + sizeof(glm::vec2) + sizeof(float))
+                                   + (I + L) * W + N * sizeof(MeshLod);
+    if ((W != INDEX_16_BITS && W != INDEX_32_BITS) || file.size() != expectedSize || I % 3 != 0 || L % 3 != 0)
+    {
+        std::cerr << "Binary cache " << filename << " is corrupted, ignoring it" << std::endl;
+        return false;
+    }
+
+    const char * cursor = file.data() + sizeof(OFFBHeader);
+    indexed_vertices.resize(V);
+    std::memcpy(indexed_vertices.data(), cursor, V * sizeof(glm::vec3)); cursor += V * sizeof(glm::vec3);
+    indexed_normals.resize(V);
+    std::memcpy(indexed_normals.data(), cursor, V * sizeof(glm::vec3));  cursor += V * sizeof(glm::vec3);
+    indexed_uvs.resize(V);
+    std::memcpy(indexed_uvs.data(), cursor, V * sizeof(glm::vec2));      cursor += V * sizeof(glm::vec2);
+    vertex_thickness.resize(V);
+    std::memcpy(vertex_thickness.data(), cursor, V * sizeof(float));     cursor += V * sizeof(float);
+    indices.resize(I);
+    lod_indices.resize(L);
+    index_width = IndexWidth(W);
+    if (index_width == INDEX_32_BITS)
+    {
+        std::memcpy(indices.data(), cursor, I * sizeof(unsigned int));
+        std::memcpy(lod_indices.data(), cursor + I * sizeof(unsigned int), L * sizeof(unsigned int));
+    }
+    else
+    {
+        std::vector<unsigned short> packed(I + L);
+        std::memcpy(packed.data(), cursor, (I + L) * sizeof(unsigned short));
+        std::copy(packed.begin(), packed.begin() + I, indices.begin());
+        std::copy(packed.begin() + I, packed.end(), lod_indices.begin());
+    }
+    cursor += (I + L) * W;
+    lods.resize(N);
+    std::memcpy(lods.data(), cursor, N * sizeof(MeshLod));
+
+    // indices out of the vertices or ranges out of the indices : parsed again from the source
+    bool valid = std::all_of(indices.begin(), indices.end(), [V](unsigned int i) { return i < V; })
+              && std::all_of(lod_indices.begin(), lod_indices.end(), [V](unsigned int i) { return i < V; });
+    for (const MeshLod & lod : lods) valid = valid && std::size_t(lod.first) + lod.count <= I + L;
+    if (!valid)
+    {
+        std::cerr << "Binary cache " << filename << " is corrupted, ignoring it" << std::endl;
+        indexed_vertices.clear(); indexed_normals.clear(); indexed_uvs.clear(); vertex_thickness.clear();
+        indices.clear(); lod_indices.clear(); lods.clear();
+        return false;
+    }
 
-    float a2 = x3 - x1;
-    float b2 = y3 - y1;
-    float c2 = z3 - z1;
+    invalidate_adjacency();
+    compute_triangle_normals(indexed_vertices, indices, triangle_normals, triangle_areas);
 
-    float a = b1 * c2 - b2 * c1;
-    float b = a2 * c1 - a1 * c2;
-    float c = a1 * b2 - b1 * a2;
+    bounding_box.xpos = glm::vec2(header.box[0], header.box[1]);
+    bounding_box.ypos = glm::vec2(header.box[2], header.box[3]);
+    bounding_box.zpos = glm::vec2(header.box[4], header.box[5]);
+    atlas_size = header.atlasSize;
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Loaded " << filename << " (binary cache) in " << seconds * 1000.0 << " ms" << std::endl;
+    return true;
+}
+
+bool Mesh::save_OFFB_file(const std::string & filename, const std::string & source) const
+{
+    OFFBHeader header{};
+    std::memcpy(header.magic, OFFB_MAGIC, 4);
+    header.version = OFFB_VERSION;
+    if (!source_stamp(source, header.sourceSize, header.sourceTime)) return false;
+    header.numberOfVertices = static_cast<std::uint32_t>(indexed_vertices.size());
+    header.numberOfIndices = static_cast<std::uint32_t>(indices.size());
+    header.numberOfLodIndices = static_cast<std::uint32_t>(lod_indices.size());
+    header.numberOfLods = static_cast<std::uint32_t>(lods.size());
+    header.indexWidth = index_width;
+    header.atlasSize = atlas_size;
+    header.box[0] = bounding_box.xpos.x; header.box[1] = bounding_box.xpos.y;
+    header.box[2] = bounding_box.ypos.x; header.box[3] = bounding_box.ypos.y;
+    header.box[4] = bounding_box.zpos.x; header.box[5] = bounding_box.zpos.y;
+
+    if (indexed_normals.size() != indexed_vertices.size() || indexed_uvs.size() != indexed_vertices.size()
+        || vertex_thickness.size() != indexed_vertices.size())
+        return false;
+    std::vector<unsigned char> packedIndices;
+    pack_indices(packedIndices);
 
-    float d = (- a * x1 - b * y1 - c * z1);
-    return glm::vec4(a,b,c,d);
-}
\ No newline at end of file
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(filename).parent_path(), error);
+
+    // write aside then rename, so a concurrent load never sees a partial file
+    const std::string temporary = filename + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) return false;
+        file.write(reinterpret_cast<const char *>(&header), sizeof(OFFBHeader));
+        file.write(reinterpret_cast<const char *>(indexed_vertices.data()), indexed_vertices.size() * sizeof(glm::vec3));
+        file.write(reinterpret_cast<const char *>(indexed_normals.data()), indexed_normals.size() * sizeof(glm::vec3));
+        file.write(reinterpret_cast<const char *>(indexed_uvs.data()), indexed_uvs.size() * sizeof(glm::vec2));
+        file.write(reinterpret_cast<const char *>(vertex_thickness.data()), vertex_thickness.size() * sizeof(float));
+        file.write(reinterpret_cast<const char *>(packedIndices.data()), packedIndices.size());
+        file.write(reinterpret_cast<const char *>(lods.data()), lods.size() * sizeof(MeshLod));
+        if (!file.good())
+        {
+            file.close();
+            std::filesystem::remove(temporary, error);
+            return false;
+        }
+    }
+    std::filesystem::rename(temporary, filename, error);
+    if (error)
+    {
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+    std::cout << "Wrote binary cache " << filename << std::endl;
+    return true;
+}
@@ -0,0 +1,111 @@
+#include "MeshAdjacency.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+
+namespace {
+
+const std::size_t VERTEX_GRAIN = 2048;
+
+// more histograms means more parallelism for the counting sort but K * V counters
+const std::size_t MAX_HISTOGRAMS = 8;
+
+} // namespace
+
+void MeshAdjacency::clear()
+{
+    neighbor_offsets.clear(); neighbors.clear();
+    corner_offsets.clear(); corners.clear();
+}
+
+void MeshAdjacency::build(std::size_t numberOfVertices, const std::vector<unsigned int> & triangles)
+{
+    const std::size_t numberOfCorners = triangles.size();
+
+    // ------------------------------------------------------------------------
+    // vertex -> corners : stable counting sort of the corners by vertex.
+    // each slice of the index array gets its own histogram, the scan runs vertex-major so that
+    // slice k writes right after slice k-1 for every vertex and the lists stay sorted.
+    const std::size_t slices = std::max<std::size_t>(1, std::min<std::size_t>(
+            std::min<std::size_t>(worker_count(), MAX_HISTOGRAMS), numberOfCorners / (64 * 1024)));
+    const std::size_t sliceSize = (numberOfCorners + slices - 1) / slices;
+
+    std::vector<unsigned int> histograms(slices * numberOfVertices, 0);
+    parallel_for(0, slices, 1, [&](std::size_t first, std::size_t last) {
+        for (std::size_t k = first; k < last; ++k)
+        {
+            unsigned int * histogram = histograms.data() + k * numberOfVertices;
+            const std::size_t end = std::min(numberOfCorners, (k + 1) * sliceSize);
+            for (std::size_t c = k * sliceSize; c < end; ++c) ++histogram[triangles[c]];
+        }
+    });
+
+    corner_offsets.resize(numberOfVertices + 1);
+    unsigned int total = 0;
+    for (std::size_t v = 0; v < numberOfVertices; ++v)
+    {
+        corner_offsets[v] = total;
+        for (std::size_t k = 0; k < slices; ++k)
+        {
+            unsigned int & count = histograms[k * numberOfVertices + v];
+            unsigned int start = total;
+            total += count;
+            count = start; // the histogram becomes the write cursor of slice k
+        }
+    }
+    corner_offsets[numberOfVertices] = total;
+
+    corners.resize(numberOfCorners);
+    parallel_for(0, slices, 1, [&](std::size_t first, std::size_t last) {
+        for (std::size_t k = first; k < last; ++k)
+        {
+            unsigned int * cursor = histograms.data() + k * numberOfVertices;
+            const std::size_t end = std::min(numberOfCorners, (k + 1) * sliceSize);
+            for (std::size_t c = k * sliceSize; c < end; ++c) corners[cursor[triangles[c]]++] = unsigned(c);
+        }
+    });
+    histograms = std::vector<unsigned int>();
+
+    // ------------------------------------------------------------------------
+    // vertex -> vertices : every corner brings the two other vertices of its triangle.
+    // lists are sorted / deduplicated in place inside a 2 * corners wide scratch, then compacted.
+    std::vector<unsigned int> scratch(2 * numberOfCorners);
+    std::vector<unsigned int> counts(numberOfVertices);
+    parallel_for(0, numberOfVertices, VERTEX_GRAIN, [&](std::size_t first, std::size_t last) {
+        for (std::size_t v = first; v < last; ++v)
+        {
+            unsigned int * begin = scratch.data() + 2 * std::size_t(corner_offsets[v]);
+            unsigned int * out = begin;
+            for (unsigned int i = corner_offsets[v]; i < corner_offsets[v + 1]; ++i)
+            {
+                const unsigned int c = corners[i];
+                const unsigned int t = c - c % 3;
+                for (unsigned int k = 0; k < 3; ++k)
+                {
+                    // skip v itself, degenerate triangles included
+                    if (triangles[t + k] != v) *out++ = triangles[t + k];
+                }
+            }
+            std::sort(begin, out);
+            counts[v] = unsigned(std::unique(begin, out) - begin);
+        }
+    });
+
+    neighbor_offsets.resize(numberOfVertices + 1);
+    total = 0;
+    for (std::size_t v = 0; v < numberOfVertices; ++v)
+    {
+        neighbor_offsets[v] = total;
+        total += counts[v];
+    }
+    neighbor_offsets[numberOfVertices] = total;
+
+    neighbors.resize(total);
+    parallel_for(0, numberOfVertices, VERTEX_GRAIN, [&](std::size_t first, std::size_t last) {
+        for (std::size_t v = first; v < last; ++v)
+        {
+            const unsigned int * begin = scratch.data() + 2 * std::size_t(corner_offsets[v]);
+            std::copy(begin, begin + counts[v], neighbors.begin() + neighbor_offsets[v]);
+        }
+    });
+}
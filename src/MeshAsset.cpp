@@ -0,0 +1,265 @@
+#include "MeshAsset.hpp"
+
+std::mutex MeshAssetCache::mutex;
+std::unordered_map<std::string, std::weak_ptr<MeshAsset> > MeshAssetCache::assets;
+
+// ******************************************************************************************************
+// ******************************************************************************************************
+// ******************************************************************************************************
+// asset
+MeshAsset::MeshAsset(std::shared_ptr<Mesh> loaded)
+    : mesh(std::move(loaded))
+{
+    glGenVertexArrays(1, &VertexArrayID);
+    glBindVertexArray(VertexArrayID);
+
+    glGenBuffers(1, &vertexbuffer);
+    glGenBuffers(1, &uvbuffer);
+    glGenBuffers(1, &normalbuffer);
+    glGenBuffers(1, &bakedbuffer);
+    // Generate a buffer for the indices as well
+    glGenBuffers(1, &elementbuffer);
+    updateBuffers();
+}
+
+MeshAsset::~MeshAsset()
+{
+    glDeleteBuffers(1, &vertexbuffer);
+    glDeleteBuffers(1, &uvbuffer);
+    glDeleteBuffers(1, &normalbuffer);
+    glDeleteBuffers(1, &bakedbuffer);
+    glDeleteBuffers(1, &elementbuffer);
+    glDeleteVertexArrays(1, &VertexArrayID);
+}
+
+void MeshAsset::updateBuffers()
+{
+    if (mesh->vertex_format == VERTEX_PACKED)
+    {
+        // one interleaved buffer, the others are left empty
+        std::vector<unsigned char> packed;
+        mesh->pack_vertices(packed);
+        glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
+        glBufferData(GL_ARRAY_BUFFER, packed.size(), packed.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, uvbuffer);
+        glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, normalbuffer);
+        glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, bakedbuffer);
+        glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_STATIC_DRAW);
+    }
+    else
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
+        glBufferData(GL_ARRAY_BUFFER, mesh->indexed_vertices.size() * sizeof(glm::vec3), mesh->indexed_vertices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, uvbuffer);
+        glBufferData(GL_ARRAY_BUFFER, mesh->indexed_uvs.size() * sizeof(glm::vec2), mesh->indexed_uvs.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, normalbuffer);
+        glBufferData(GL_ARRAY_BUFFER, mesh->indexed_normals.size() * sizeof(glm::vec3), mesh->indexed_normals.data(), GL_STATIC_DRAW);
+        // thickness and occlusion, 1 where they weren't baked like the packed layout
+        std::vector<glm::vec2> baked(mesh->indexed_vertices.size(), glm::vec2(1.0f));
+        for (std::size_t v = 0; v < baked.size(); ++v)
+        {
+            if (v < mesh->vertex_thickness.size()) baked[v].x = mesh->vertex_thickness[v];
+            if (v < mesh->vertex_occlusion.size()) baked[v].y = mesh->vertex_occlusion[v];
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, bakedbuffer);
+        glBufferData(GL_ARRAY_BUFFER, baked.size() * sizeof(glm::vec2), baked.data(), GL_STATIC_DRAW);
+    }
+
+    glBindVertexArray(VertexArrayID);
+    setupVertexAttributes();
+    ++layoutVersion;
+    uploadIndices();
+}
+
+void MeshAsset::setupVertexAttributes() const
+{
+    if (mesh->vertex_format == VERTEX_PACKED)
+    {
+        const GLsizei stride = mesh->vertex_stride();
+        std::size_t offset = 0;
+        glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
+
+        // positions : unorm16 in the bounding box (the shader applies offset / scale) or float
+        glEnableVertexAttribArray(0);
+        if (mesh->quantized_positions)
+        {
+            glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride, reinterpret_cast<const void *>(offset));
+            offset += 4 * sizeof(GLushort);
+        }
+        else
+        {
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<const void *>(offset));
+            offset += 3 * sizeof(GLfloat);
+        }
+
+        // normals : octahedral, decoded by the shader (normal.z is 0 when the attribute is packed)
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_SHORT, GL_TRUE, stride, reinterpret_cast<const void *>(offset));
+        offset += 2 * sizeof(GLshort);
+
+        // uvs : unorm16, or the same value for every vertex
+        if (mesh->packed_uvs)
+        {
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(1, 2, GL_UNSIGNED_SHORT, GL_TRUE, stride, reinterpret_cast<const void *>(offset));
+            offset += 2 * sizeof(GLushort);
+        }
+        else
+        {
+            glDisableVertexAttribArray(1);
+            glm::vec2 uv = mesh->uv_constant();
+            glVertexAttrib2f(1, uv.x, uv.y);
+        }
+
+        // baked values : unorm8, thickness then occlusion
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 1, GL_UNSIGNED_BYTE, GL_TRUE, stride, reinterpret_cast<const void *>(offset));
+        glEnableVertexAttribArray(4);
+        glVertexAttribPointer(4, 1, GL_UNSIGNED_BYTE, GL_TRUE, stride, reinterpret_cast<const void *>(offset + 1));
+    }
+    else
+    {
+        // 1rst attribute buffer : vertices
+        glEnableVertexAttribArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
+        glVertexAttribPointer(
+                0,                  // attribute
+                3,                  // size
+                GL_FLOAT,           // type
+                GL_FALSE,           // normalized?
+                0,                  // stride
+                nullptr            // array buffer offset
+        );
+
+        // 2nd attribute buffer : UVs
+        glEnableVertexAttribArray(1);
+        glBindBuffer(GL_ARRAY_BUFFER, uvbuffer);
+        glVertexAttribPointer(
+                1,                                // attribute
+                2,                                // size
+                GL_FLOAT,                         // type
+                GL_FALSE,                         // normalized?
+                0,                                // stride
+                nullptr                          // array buffer offset
+        );
+
+        // 3rd attribute buffer : normals
+        glEnableVertexAttribArray(2);
+        glBindBuffer(GL_ARRAY_BUFFER, normalbuffer);
+        glVertexAttribPointer(
+                2,                                // attribute
+                3,                                // size
+                GL_FLOAT,                         // type
+                GL_FALSE,                         // normalized?
+                0,                                // stride
+                nullptr                          // array buffer offset
+        );
+
+        // 4th and 5th attributes : thickness and occlusion, interleaved
+        glBindBuffer(GL_ARRAY_BUFFER, bakedbuffer);
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), nullptr);
+        glEnableVertexAttribArray(4);
+        glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), reinterpret_cast<const void *>(sizeof(float)));
+    }
+
+    // Index buffer
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer);
+}
+
+void MeshAsset::setVertexFormat(VertexFormat format, bool quantize_positions)
+{
+    std::size_t before = std::size_t(mesh->vertex_stride()) * mesh->indexed_vertices.size();
+    mesh->select_vertex_format(format, quantize_positions);
+    updateBuffers();
+    std::cout << "Vertex format : " << mesh->vertex_stride() << " bytes per vertex ("
+              << before / 1024 << " KB -> " << std::size_t(mesh->vertex_stride()) * mesh->indexed_vertices.size() / 1024
+              << " KB)" << std::endl;
+}
+
+void MeshAsset::uploadIndices()
+{
+    // 16 or 32 bits depending on what the mesh selected
+    std::vector<unsigned char> packed;
+    mesh->pack_indices(packed);
+    indexType = (mesh->index_width == INDEX_32_BITS) ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+
+    glBindVertexArray(VertexArrayID);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, packed.size(), packed.data(), GL_STATIC_DRAW);
+
+    gpuBytes = std::size_t(mesh->vertex_stride()) * mesh->indexed_vertices.size() + packed.size();
+}
+
+void MeshAsset::forceIndexWidth(bool force_32_bits)
+{
+    mesh->select_index_width(force_32_bits);
+    uploadIndices();
+}
+
+// ******************************************************************************************************
+// ******************************************************************************************************
+// ******************************************************************************************************
+// cache
+std::shared_ptr<MeshAsset> MeshAssetCache::acquire(const std::string & path, std::shared_ptr<Mesh> mesh)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::shared_ptr<MeshAsset> asset = assets[path].lock();
+    if (!asset)
+    {
+        asset = std::make_shared<MeshAsset>(std::move(mesh));
+        assets[path] = asset;
+    }
+    return asset;
+}
+
+std::shared_ptr<MeshAsset> MeshAssetCache::acquire(const std::string & path)
+{
+    std::shared_ptr<MeshAsset> asset = find(path);
+    if (asset) return asset;
+    return acquire(path, std::make_shared<Mesh>(path.c_str()));
+}
+
+std::shared_ptr<MeshAsset> MeshAssetCache::find(const std::string & path)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = assets.find(path);
+    return (it != assets.end()) ? it->second.lock() : nullptr;
+}
+
+void MeshAssetCache::memory_usage(std::size_t & shared, std::size_t & unshared)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    shared = unshared = 0;
+    for (const auto & entry : assets)
+    {
+        std::shared_ptr<MeshAsset> asset = entry.second.lock();
+        if (!asset) continue;
+        // the local handle above is not a user of the asset
+        std::size_t handles = std::size_t(asset.use_count()) - 1;
+        std::size_t bytes = asset->getCpuBytes() + asset->getGpuBytes();
+        shared += bytes;
+        unshared += handles * bytes;
+    }
+}
+
+void MeshAssetCache::report(std::ostream & out)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::size_t cpu = 0, gpu = 0, unshared = 0;
+    for (const auto & entry : assets)
+    {
+        std::shared_ptr<MeshAsset> asset = entry.second.lock();
+        if (!asset) continue;
+        std::size_t handles = std::size_t(asset.use_count()) - 1;
+        out << "Mesh asset " << entry.first << " : " << handles << " handle(s), CPU "
+            << asset->getCpuBytes() / 1024 << " KB, GPU " << asset->getGpuBytes() / 1024 << " KB" << std::endl;
+        cpu += asset->getCpuBytes();
+        gpu += asset->getGpuBytes();
+        unshared += handles * (asset->getCpuBytes() + asset->getGpuBytes());
+    }
+    out << "Mesh assets : CPU " << cpu / 1024 << " KB + GPU " << gpu / 1024 << " KB (" << unshared / 1024
+        << " KB with one copy per renderer)" << std::endl;
+}
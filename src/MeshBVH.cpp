@@ -0,0 +1,751 @@
+#include "MeshBVH.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+#endif
+
+namespace {
+
+const unsigned int BINS = 16;
+const unsigned int MAX_LEAF_SIZE = 8;   // bigger leaves only when the triangles can't be told apart
+const unsigned int MAX_DEPTH = 60;      // traversal stacks hold 64 nodes
+const float TRAVERSAL_COST = 1.0f;      // cost of a node visit, relative to a triangle test
+const std::size_t BINNING_GRAIN = 16 * 1024;
+
+struct Bounds {
+    glm::vec3 min = glm::vec3(FLT_MAX);
+    glm::vec3 max = glm::vec3(-FLT_MAX);
+
+    void grow(const glm::vec3 & p) { min = glm::min(min, p); max = glm::max(max, p); }
+    void grow(const Bounds & b) { min = glm::min(min, b.min); max = glm::max(max, b.max); }
+    float area() const
+    {
+        glm::vec3 d = max - min;
+        return (d.x < 0.0f) ? 0.0f : 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+};
+
+struct Bin {
+    Bounds bounds;
+    unsigned int count = 0;
+};
+typedef std::array<Bin, 3 * BINS> Bins; // BINS per axis
+
+// triangles being sorted into the tree
+struct BuildInput {
+    std::vector<Bounds> bounds;
+    std::vector<glm::vec3> centroids;
+    std::vector<unsigned int> ids;
+};
+
+// node of the tree still to be built
+struct BuildTask {
+    unsigned int node, first, count, depth;
+};
+
+// split position : BINS per axis, the left side takes the bins up to @bin
+struct Split {
+    int axis = -1; // -1 : leaf, 3 : no usable bin, cut the range in the middle
+    unsigned int bin = 0;
+};
+
+// bounds of the triangles and of their centroids over ids[first, first + count)
+void range_bounds(const BuildInput & input, unsigned int first, unsigned int count, bool parallel,
+                  Bounds & bounds, Bounds & centroidBounds)
+{
+    const std::size_t chunks = parallel ? (count + BINNING_GRAIN - 1) / BINNING_GRAIN : 1;
+    const std::size_t grain = parallel ? BINNING_GRAIN : count;
+    std::vector<Bounds> partial(2 * chunks);
+    parallel_for(first, first + count, grain, [&](std::size_t begin, std::size_t end) {
+        Bounds & b = partial[2 * ((begin - first) / grain)];
+        Bounds & c = partial[2 * ((begin - first) / grain) + 1];
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            b.grow(input.bounds[input.ids[i]]);
+            c.grow(input.centroids[input.ids[i]]);
+        }
+    });
+    bounds = centroidBounds = Bounds();
+    for (std::size_t k = 0; k < chunks; ++k)
+    {
+        bounds.grow(partial[2 * k]);
+        centroidBounds.grow(partial[2 * k + 1]);
+    }
+}
+
+inline unsigned int bin_of(float centroid, float low, float scale)
+{
+    return std::min(BINS - 1, unsigned(std::max(0.0f, (centroid - low) * scale)));
+}
+
+// best SAH split of ids[first, first + count)
+Split find_split(const BuildInput & input, unsigned int first, unsigned int count, unsigned int depth, bool parallel,
+                 const Bounds & bounds, const Bounds & centroidBounds)
+{
+    Split split;
+    if (count <= 1 || depth >= MAX_DEPTH) return split;
+
+    glm::vec3 extent = centroidBounds.max - centroidBounds.min;
+    glm::vec3 scale;
+    for (int a = 0; a < 3; ++a) scale[a] = (extent[a] > 0.0f) ? float(BINS) / extent[a] : 0.0f;
+
+    // every axis in one pass over the triangles, one set of bins per chunk
+    const std::size_t chunks = parallel ? (count + BINNING_GRAIN - 1) / BINNING_GRAIN : 1;
+    const std::size_t grain = parallel ? BINNING_GRAIN : count;
+    std::vector<Bins> partial(chunks);
+    parallel_for(first, first + count, grain, [&](std::size_t begin, std::size_t end) {
+        Bins & bins = partial[(begin - first) / grain];
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            const unsigned int id = input.ids[i];
+            for (int a = 0; a < 3; ++a)
+            {
+                Bin & bin = bins[a * BINS + bin_of(input.centroids[id][a], centroidBounds.min[a], scale[a])];
+                bin.bounds.grow(input.bounds[id]);
+                ++bin.count;
+            }
+        }
+    });
+    Bins bins = partial[0];
+    for (std::size_t k = 1; k < chunks; ++k)
+    {
+        for (unsigned int b = 0; b < 3 * BINS; ++b)
+        {
+            bins[b].bounds.grow(partial[k][b].bounds);
+            bins[b].count += partial[k][b].count;
+        }
+    }
+
+    // sweep the bins from both sides : cost of every split plane
+    float bestCost = FLT_MAX;
+    for (int a = 0; a < 3; ++a)
+    {
+        if (scale[a] == 0.0f) continue;
+        const Bin * axisBins = &bins[a * BINS];
+        float rightArea[BINS]; unsigned int rightCount[BINS];
+        Bounds right; unsigned int n = 0;
+        for (unsigned int b = BINS - 1; b > 0; --b)
+        {
+            right.grow(axisBins[b].bounds); n += axisBins[b].count;
+            rightArea[b] = right.area(); rightCount[b] = n;
+        }
+        Bounds left; n = 0;
+        for (unsigned int b = 0; b + 1 < BINS; ++b)
+        {
+            left.grow(axisBins[b].bounds); n += axisBins[b].count;
+            if (n == 0 || rightCount[b + 1] == 0) continue;
+            float cost = left.area() * float(n) + rightArea[b + 1] * float(rightCount[b + 1]);
+            if (cost < bestCost) { bestCost = cost; split.axis = a; split.bin = b; }
+        }
+    }
+
+    // a leaf is cheaper than the best split : keep it, unless it would be too big
+    const float area = bounds.area();
+    const float leafCost = float(count);
+    const float splitCost = (split.axis >= 0 && area > 0.0f) ? TRAVERSAL_COST + bestCost / area : FLT_MAX;
+    if (splitCost >= leafCost && count <= MAX_LEAF_SIZE) return Split();
+    if (split.axis < 0) split.axis = 3;
+    return split;
+}
+
+// reorder ids[first, first + count) around @split, return the size of the left side
+unsigned int partition(BuildInput & input, unsigned int first, unsigned int count, const Split & split, const Bounds & centroidBounds)
+{
+    unsigned int * begin = input.ids.data() + first;
+    unsigned int left = count / 2;
+    if (split.axis < 3)
+    {
+        const int a = split.axis;
+        const float low = centroidBounds.min[a];
+        const float scale = float(BINS) / (centroidBounds.max[a] - centroidBounds.min[a]);
+        unsigned int * middle = std::partition(begin, begin + count, [&](unsigned int id) {
+            return bin_of(input.centroids[id][a], low, scale) <= split.bin;
+        });
+        left = unsigned(middle - begin);
+    }
+    // never an empty side
+    if (left == 0 || left == count) left = count / 2;
+    return left;
+}
+
+// build the subtree of ids[first, first + count) on one thread, nodes[0] is its root
+void build_subtree(BuildInput & input, unsigned int first, unsigned int count, unsigned int depth,
+                   std::vector<BuildTask> & stack, std::vector<Bounds> & bounds, std::vector<unsigned int> & leaves)
+{
+    // nodes as (bounds, first, count) : same layout as MeshBVH::Node once written
+    stack.clear();
+    stack.push_back({0, first, count, depth});
+    bounds.assign(1, Bounds());
+    leaves.assign(2, 0);
+    while (!stack.empty())
+    {
+        BuildTask task = stack.back(); stack.pop_back();
+        Bounds centroidBounds;
+        range_bounds(input, task.first, task.count, false, bounds[task.node], centroidBounds);
+        Split split = find_split(input, task.first, task.count, task.depth, false, bounds[task.node], centroidBounds);
+        if (split.axis < 0)
+        {
+            leaves[2 * task.node] = task.first;
+            leaves[2 * task.node + 1] = task.count;
+            continue;
+        }
+        unsigned int left = partition(input, task.first, task.count, split, centroidBounds);
+        unsigned int child = unsigned(bounds.size());
+        bounds.resize(child + 2);
+        leaves.resize(2 * (child + 2), 0);
+        leaves[2 * task.node] = child;
+        leaves[2 * task.node + 1] = 0;
+        stack.push_back({child + 1, task.first + left, task.count - left, task.depth + 1});
+        stack.push_back({child, task.first, left, task.depth + 1});
+    }
+}
+
+} // namespace
+
+void MeshBVH::clear()
+{
+    nodes.clear();
+    leafTriangles.clear();
+}
+
+std::size_t MeshBVH::memory_usage() const
+{
+    return nodes.capacity() * sizeof(Node) + leafTriangles.capacity() * sizeof(Triangle);
+}
+
+void MeshBVH::build(const std::vector<glm::vec3> & vertices, const std::vector<unsigned int> & triangles)
+{
+    auto start = std::chrono::steady_clock::now();
+    clear();
+    const unsigned int numberOfTriangles = unsigned(triangles.size() / 3);
+    if (numberOfTriangles == 0) return;
+
+    BuildInput input;
+    input.bounds.resize(numberOfTriangles);
+    input.centroids.resize(numberOfTriangles);
+    input.ids.resize(numberOfTriangles);
+    parallel_for(0, numberOfTriangles, BINNING_GRAIN, [&](std::size_t first, std::size_t last) {
+        for (std::size_t t = first; t < last; ++t)
+        {
+            Bounds b;
+            for (int k = 0; k < 3; ++k) b.grow(vertices[triangles[3 * t + k]]);
+            input.bounds[t] = b;
+            input.centroids[t] = 0.5f * (b.min + b.max);
+            input.ids[t] = unsigned(t);
+        }
+    });
+
+    // upper levels : one node at a time, binning in parallel, until the nodes are small enough
+    // to give every worker a few subtrees
+    const unsigned int subtreeSize = std::max(4096u, numberOfTriangles / (8 * worker_count()));
+    std::vector<BuildTask> subtrees, pending = {{0, 0, numberOfTriangles, 0}};
+    nodes.resize(1);
+    while (!pending.empty())
+    {
+        BuildTask task = pending.back(); pending.pop_back();
+        if (task.count <= subtreeSize) { subtrees.push_back(task); continue; }
+
+        Bounds bounds, centroidBounds;
+        range_bounds(input, task.first, task.count, true, bounds, centroidBounds);
+        Split split = find_split(input, task.first, task.count, task.depth, true, bounds, centroidBounds);
+        Node & node = nodes[task.node];
+        node.min = bounds.min; node.max = bounds.max;
+        if (split.axis < 0)
+        {
+            node.first = task.first; node.count = task.count;
+            continue;
+        }
+        unsigned int left = partition(input, task.first, task.count, split, centroidBounds);
+        unsigned int child = unsigned(nodes.size());
+        nodes[task.node].first = child; nodes[task.node].count = 0;
+        nodes.resize(child + 2);
+        pending.push_back({child, task.first, left, task.depth + 1});
+        pending.push_back({child + 1, task.first + left, task.count - left, task.depth + 1});
+    }
+
+    // subtrees : independent ranges of ids, built in parallel into their own arrays
+    std::vector<std::vector<Node> > subtreeNodes(subtrees.size());
+    parallel_for(0, subtrees.size(), 1, [&](std::size_t first, std::size_t last) {
+        std::vector<BuildTask> stack;
+        std::vector<Bounds> bounds;
+        std::vector<unsigned int> leaves;
+        for (std::size_t s = first; s < last; ++s)
+        {
+            build_subtree(input, subtrees[s].first, subtrees[s].count, subtrees[s].depth, stack, bounds, leaves);
+            std::vector<Node> & local = subtreeNodes[s];
+            local.resize(bounds.size());
+            for (std::size_t n = 0; n < bounds.size(); ++n)
+                local[n] = {bounds[n].min, leaves[2 * n], bounds[n].max, leaves[2 * n + 1]};
+        }
+    });
+
+    // append the subtrees : local node n > 0 goes to base + n - 1, the root replaces the placeholder
+    for (std::size_t s = 0; s < subtrees.size(); ++s)
+    {
+        const std::vector<Node> & local = subtreeNodes[s];
+        const unsigned int base = unsigned(nodes.size());
+        auto rebase = [base](Node node) {
+            if (node.count == 0) node.first = base + node.first - 1;
+            return node;
+        };
+        nodes[subtrees[s].node] = rebase(local[0]);
+        for (std::size_t n = 1; n < local.size(); ++n) nodes.push_back(rebase(local[n]));
+    }
+
+    // triangles in leaf order
+    leafTriangles.resize(numberOfTriangles);
+    parallel_for(0, numberOfTriangles, BINNING_GRAIN, [&](std::size_t first, std::size_t last) {
+        for (std::size_t i = first; i < last; ++i)
+        {
+            const unsigned int id = input.ids[i];
+            const glm::vec3 & p0 = vertices[triangles[3 * id]];
+            leafTriangles[i] = {p0, vertices[triangles[3 * id + 1]] - p0, vertices[triangles[3 * id + 2]] - p0, id};
+        }
+    });
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "BVH : " << numberOfTriangles << " triangles, " << nodes.size() << " nodes in " << ms << " ms" << std::endl;
+}
+
+// ******************************************************************************************************
+// ******************************************************************************************************
+// ******************************************************************************************************
+// single ray traversal : nearest child first, far child on a stack with its entry distance
+
+namespace {
+
+inline bool hit_box(const glm::vec3 & min, const glm::vec3 & max, const glm::vec3 & origin, const glm::vec3 & inverse,
+                    float tmin, float tmax, float & tnear)
+{
+    glm::vec3 t0 = (min - origin) * inverse, t1 = (max - origin) * inverse;
+    glm::vec3 low = glm::min(t0, t1), high = glm::max(t0, t1);
+    tnear = std::max(std::max(low.x, low.y), std::max(low.z, tmin));
+    float tfar = std::min(std::min(high.x, high.y), std::min(high.z, tmax));
+    return tnear <= tfar;
+}
+
+// Moller-Trumbore, both sides
+template <typename Triangle>
+inline bool hit_triangle(const Triangle & triangle, const glm::vec3 & origin, const glm::vec3 & direction,
+                         float tmin, float tmax, float & t, float & u, float & v)
+{
+    glm::vec3 p = glm::cross(direction, triangle.e2);
+    float det = glm::dot(triangle.e1, p);
+    if (det == 0.0f) return false;
+    float inverse = 1.0f / det;
+    glm::vec3 s = origin - triangle.v0;
+    u = glm::dot(s, p) * inverse;
+    if (u < 0.0f || u > 1.0f) return false;
+    glm::vec3 q = glm::cross(s, triangle.e1);
+    v = glm::dot(direction, q) * inverse;
+    if (v < 0.0f || u + v > 1.0f) return false;
+    t = glm::dot(triangle.e2, q) * inverse;
+    return t >= tmin && t <= tmax;
+}
+
+} // namespace
+
+bool MeshBVH::intersect(const Ray & ray, RayHit & hit) const
+{
+    hit = RayHit();
+    const glm::vec3 inverse = 1.0f / ray.direction;
+    float tmax = ray.tmax, tnear;
+    if (nodes.empty() || !hit_box(nodes[0].min, nodes[0].max, ray.origin, inverse, ray.tmin, tmax, tnear)) return false;
+
+    unsigned int stack[64]; float stackNear[64];
+    unsigned int size = 0, current = 0;
+    while (true)
+    {
+        const Node & node = nodes[current];
+        if (node.count > 0)
+        {
+            float t, u, v;
+            for (unsigned int i = node.first; i < node.first + node.count; ++i)
+            {
+                if (hit_triangle(leafTriangles[i], ray.origin, ray.direction, ray.tmin, tmax, t, u, v))
+                {
+                    tmax = t;
+                    hit.t = t; hit.u = u; hit.v = v;
+                    hit.triangle = leafTriangles[i].id;
+                }
+            }
+        }
+        else
+        {
+            float nearLeft, nearRight;
+            const Node & left = nodes[node.first];
+            const Node & right = nodes[node.first + 1];
+            bool hitLeft = hit_box(left.min, left.max, ray.origin, inverse, ray.tmin, tmax, nearLeft);
+            bool hitRight = hit_box(right.min, right.max, ray.origin, inverse, ray.tmin, tmax, nearRight);
+            if (hitLeft && hitRight)
+            {
+                bool leftFirst = nearLeft <= nearRight;
+                current = leftFirst ? node.first : node.first + 1;
+                stack[size] = leftFirst ? node.first + 1 : node.first;
+                stackNear[size++] = leftFirst ? nearRight : nearLeft;
+                continue;
+            }
+            if (hitLeft || hitRight)
+            {
+                current = hitLeft ? node.first : node.first + 1;
+                continue;
+            }
+        }
+        // next node on the stack that is still in front of the closest hit
+        do
+        {
+            if (size == 0) return hit.triangle != NO_HIT;
+            current = stack[--size];
+        } while (stackNear[size] > tmax);
+    }
+}
+
+bool MeshBVH::occluded(const Ray & ray) const
+{
+    const glm::vec3 inverse = 1.0f / ray.direction;
+    float tnear;
+    if (nodes.empty() || !hit_box(nodes[0].min, nodes[0].max, ray.origin, inverse, ray.tmin, ray.tmax, tnear)) return false;
+
+    unsigned int stack[64];
+    unsigned int size = 0, current = 0;
+    while (true)
+    {
+        const Node & node = nodes[current];
+        if (node.count > 0)
+        {
+            float t, u, v;
+            for (unsigned int i = node.first; i < node.first + node.count; ++i)
+            {
+                if (hit_triangle(leafTriangles[i], ray.origin, ray.direction, ray.tmin, ray.tmax, t, u, v)) return true;
+            }
+        }
+        else
+        {
+            const Node & left = nodes[node.first];
+            const Node & right = nodes[node.first + 1];
+            bool hitLeft = hit_box(left.min, left.max, ray.origin, inverse, ray.tmin, ray.tmax, tnear);
+            bool hitRight = hit_box(right.min, right.max, ray.origin, inverse, ray.tmin, ray.tmax, tnear);
+            if (hitLeft && hitRight) stack[size++] = node.first + 1;
+            if (hitLeft || hitRight)
+            {
+                current = hitLeft ? node.first : node.first + 1;
+                continue;
+            }
+        }
+        if (size == 0) return false;
+        current = stack[--size];
+    }
+}
+
+// ******************************************************************************************************
+// ******************************************************************************************************
+// ******************************************************************************************************
+// 4-ray packets : one SSE lane per ray, a node is visited when any active ray enters it
+
+#if defined(__SSE2__)
+
+namespace {
+
+struct Packet {
+    __m128 origin[3], direction[3], inverse[3];
+    __m128 tmin, tmax;
+};
+
+inline void load_packet(const Ray rays[4], Packet & packet)
+{
+    for (int a = 0; a < 3; ++a)
+    {
+        packet.origin[a] = _mm_setr_ps(rays[0].origin[a], rays[1].origin[a], rays[2].origin[a], rays[3].origin[a]);
+        packet.direction[a] = _mm_setr_ps(rays[0].direction[a], rays[1].direction[a], rays[2].direction[a], rays[3].direction[a]);
+        packet.inverse[a] = _mm_div_ps(_mm_set1_ps(1.0f), packet.direction[a]);
+    }
+    packet.tmin = _mm_setr_ps(rays[0].tmin, rays[1].tmin, rays[2].tmin, rays[3].tmin);
+    packet.tmax = _mm_setr_ps(rays[0].tmax, rays[1].tmax, rays[2].tmax, rays[3].tmax);
+}
+
+// lanes entering the box, with their entry distance
+inline __m128 packet_box(const glm::vec3 & min, const glm::vec3 & max, const Packet & packet, __m128 & tnear)
+{
+    __m128 low = packet.tmin, high = packet.tmax;
+    for (int a = 0; a < 3; ++a)
+    {
+        __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(min[a]), packet.origin[a]), packet.inverse[a]);
+        __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(max[a]), packet.origin[a]), packet.inverse[a]);
+        low = _mm_max_ps(low, _mm_min_ps(t0, t1));
+        high = _mm_min_ps(high, _mm_max_ps(t0, t1));
+    }
+    tnear = low;
+    return _mm_cmple_ps(low, high);
+}
+
+// lanes hitting the triangle in [tmin, tmax], Moller-Trumbore on 4 rays
+template <typename Triangle>
+inline __m128 packet_triangle(const Triangle & triangle, const Packet & packet, __m128 & t, __m128 & u, __m128 & v)
+{
+    const __m128 e1[3] = {_mm_set1_ps(triangle.e1.x), _mm_set1_ps(triangle.e1.y), _mm_set1_ps(triangle.e1.z)};
+    const __m128 e2[3] = {_mm_set1_ps(triangle.e2.x), _mm_set1_ps(triangle.e2.y), _mm_set1_ps(triangle.e2.z)};
+    const __m128 * d = packet.direction;
+    auto cross = [](const __m128 * a, const __m128 * b, __m128 * out) {
+        out[0] = _mm_sub_ps(_mm_mul_ps(a[1], b[2]), _mm_mul_ps(a[2], b[1]));
+        out[1] = _mm_sub_ps(_mm_mul_ps(a[2], b[0]), _mm_mul_ps(a[0], b[2]));
+        out[2] = _mm_sub_ps(_mm_mul_ps(a[0], b[1]), _mm_mul_ps(a[1], b[0]));
+    };
+    auto dot = [](const __m128 * a, const __m128 * b) {
+        return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a[0], b[0]), _mm_mul_ps(a[1], b[1])), _mm_mul_ps(a[2], b[2]));
+    };
+
+    __m128 p[3], q[3], s[3];
+    cross(d, e2, p);
+    __m128 inverse = _mm_div_ps(_mm_set1_ps(1.0f), dot(e1, p)); // det 0 : inf / nan, rejected below
+    s[0] = _mm_sub_ps(packet.origin[0], _mm_set1_ps(triangle.v0.x));
+    s[1] = _mm_sub_ps(packet.origin[1], _mm_set1_ps(triangle.v0.y));
+    s[2] = _mm_sub_ps(packet.origin[2], _mm_set1_ps(triangle.v0.z));
+    u = _mm_mul_ps(dot(s, p), inverse);
+    cross(s, e1, q);
+    v = _mm_mul_ps(dot(d, q), inverse);
+    t = _mm_mul_ps(dot(e2, q), inverse);
+
+    const __m128 zero = _mm_setzero_ps();
+    __m128 mask = _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmpge_ps(v, zero));
+    mask = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+    mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(t, packet.tmin), _mm_cmple_ps(t, packet.tmax)));
+    return mask;
+}
+
+inline __m128 select(__m128 mask, __m128 a, __m128 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// smallest entry distance of the lanes in @mask
+inline float nearest(__m128 mask, __m128 tnear)
+{
+    __m128 t = select(mask, tnear, _mm_set1_ps(FLT_MAX));
+    t = _mm_min_ps(t, _mm_shuffle_ps(t, t, _MM_SHUFFLE(2, 3, 0, 1)));
+    t = _mm_min_ps(t, _mm_shuffle_ps(t, t, _MM_SHUFFLE(1, 0, 3, 2)));
+    return _mm_cvtss_f32(t);
+}
+
+// largest lane
+inline float largest(__m128 t)
+{
+    t = _mm_max_ps(t, _mm_shuffle_ps(t, t, _MM_SHUFFLE(2, 3, 0, 1)));
+    t = _mm_max_ps(t, _mm_shuffle_ps(t, t, _MM_SHUFFLE(1, 0, 3, 2)));
+    return _mm_cvtss_f32(t);
+}
+
+} // namespace
+
+void MeshBVH::intersect4(const Ray rays[4], RayHit hits[4]) const
+{
+    for (int r = 0; r < 4; ++r) hits[r] = RayHit();
+    if (nodes.empty()) return;
+
+    Packet packet;
+    load_packet(rays, packet);
+    __m128 bestT = _mm_set1_ps(FLT_MAX), bestU = _mm_setzero_ps(), bestV = _mm_setzero_ps();
+    __m128 bestId = _mm_castsi128_ps(_mm_set1_epi32(int(NO_HIT)));
+
+    __m128 tnear;
+    if (_mm_movemask_ps(packet_box(nodes[0].min, nodes[0].max, packet, tnear)) == 0) return;
+
+    unsigned int stack[64]; float stackNear[64];
+    unsigned int size = 0, current = 0;
+    while (true)
+    {
+        const Node & node = nodes[current];
+        if (node.count > 0)
+        {
+            __m128 t, u, v;
+            for (unsigned int i = node.first; i < node.first + node.count; ++i)
+            {
+                __m128 mask = packet_triangle(leafTriangles[i], packet, t, u, v);
+                if (_mm_movemask_ps(mask) == 0) continue;
+                packet.tmax = select(mask, t, packet.tmax);
+                bestT = select(mask, t, bestT);
+                bestU = select(mask, u, bestU);
+                bestV = select(mask, v, bestV);
+                bestId = select(mask, _mm_castsi128_ps(_mm_set1_epi32(int(leafTriangles[i].id))), bestId);
+            }
+        }
+        else
+        {
+            __m128 nearLeft, nearRight;
+            const Node & left = nodes[node.first];
+            const Node & right = nodes[node.first + 1];
+            __m128 maskLeft = packet_box(left.min, left.max, packet, nearLeft);
+            __m128 maskRight = packet_box(right.min, right.max, packet, nearRight);
+            bool hitLeft = _mm_movemask_ps(maskLeft) != 0, hitRight = _mm_movemask_ps(maskRight) != 0;
+            if (hitLeft && hitRight)
+            {
+                float l = nearest(maskLeft, nearLeft), r = nearest(maskRight, nearRight);
+                bool leftFirst = l <= r;
+                current = leftFirst ? node.first : node.first + 1;
+                stack[size] = leftFirst ? node.first + 1 : node.first;
+                stackNear[size++] = leftFirst ? r : l;
+                continue;
+            }
+            if (hitLeft || hitRight)
+            {
+                current = hitLeft ? node.first : node.first + 1;
+                continue;
+            }
+        }
+        // skip the nodes every ray has found a closer hit than
+        const float farthest = largest(packet.tmax);
+        do
+        {
+            if (size == 0)
+            {
+                alignas(16) float t[4], u[4], v[4]; alignas(16) unsigned int id[4];
+                _mm_store_ps(t, bestT); _mm_store_ps(u, bestU); _mm_store_ps(v, bestV);
+                _mm_store_ps(reinterpret_cast<float *>(id), bestId);
+                for (int r = 0; r < 4; ++r) hits[r] = {t[r], id[r], u[r], v[r]};
+                return;
+            }
+            current = stack[--size];
+        } while (stackNear[size] > farthest);
+    }
+}
+
+void MeshBVH::occluded4(const Ray rays[4], bool occluded[4]) const
+{
+    for (int r = 0; r < 4; ++r) occluded[r] = false;
+    if (nodes.empty()) return;
+
+    Packet packet;
+    load_packet(rays, packet);
+    // rays that found a hit leave the packet : their tmax goes below any entry distance
+    const __m128 done = _mm_set1_ps(-FLT_MAX);
+    int found = 0;
+
+    __m128 tnear;
+    if (_mm_movemask_ps(packet_box(nodes[0].min, nodes[0].max, packet, tnear)) == 0) return;
+
+    unsigned int stack[64];
+    unsigned int size = 0, current = 0;
+    while (true)
+    {
+        const Node & node = nodes[current];
+        if (node.count > 0)
+        {
+            __m128 t, u, v;
+            for (unsigned int i = node.first; i < node.first + node.count; ++i)
+            {
+                __m128 mask = packet_triangle(leafTriangles[i], packet, t, u, v);
+                if (_mm_movemask_ps(mask) == 0) continue;
+                found |= _mm_movemask_ps(mask);
+                packet.tmax = select(mask, done, packet.tmax);
+                packet.tmin = select(mask, _mm_set1_ps(FLT_MAX), packet.tmin);
+                if (found == 0xf) break;
+            }
+            if (found == 0xf) break;
+        }
+        else
+        {
+            const Node & left = nodes[node.first];
+            const Node & right = nodes[node.first + 1];
+            bool hitLeft = _mm_movemask_ps(packet_box(left.min, left.max, packet, tnear)) != 0;
+            bool hitRight = _mm_movemask_ps(packet_box(right.min, right.max, packet, tnear)) != 0;
+            if (hitLeft && hitRight) stack[size++] = node.first + 1;
+            if (hitLeft || hitRight)
+            {
+                current = hitLeft ? node.first : node.first + 1;
+                continue;
+            }
+        }
+        if (size == 0) break;
+        current = stack[--size];
+    }
+    for (int r = 0; r < 4; ++r) occluded[r] = (found >> r) & 1;
+}
+
+#else
+
+void MeshBVH::intersect4(const Ray rays[4], RayHit hits[4]) const
+{
+    for (int r = 0; r < 4; ++r) intersect(rays[r], hits[r]);
+}
+
+void MeshBVH::occluded4(const Ray rays[4], bool occluded[4]) const
+{
+    for (int r = 0; r < 4; ++r) occluded[r] = MeshBVH::occluded(rays[r]);
+}
+
+#endif
+
+// ******************************************************************************************************
+// ******************************************************************************************************
+// ******************************************************************************************************
+// benchmark
+
+void MeshBVH::benchmark(std::ostream & out) const
+{
+    if (nodes.empty()) return;
+
+    const glm::vec3 center = 0.5f * (nodes[0].min + nodes[0].max);
+    const float radius = 0.5f * glm::length(nodes[0].max - nodes[0].min);
+    const unsigned int side = 512;
+    const std::size_t numberOfRays = std::size_t(side) * side;
+
+    // camera rays : the whole mesh in view, 2 x 2 pixels per packet
+    std::vector<Ray> camera(numberOfRays);
+    const glm::vec3 eye = center + radius * glm::vec3(0.3f, 0.4f, 2.5f);
+    const glm::vec3 forward = glm::normalize(center - eye);
+    const glm::vec3 right = glm::normalize(glm::cross(forward, glm::vec3(0.0f, 1.0f, 0.0f)));
+    const glm::vec3 up = glm::cross(right, forward);
+    for (unsigned int y = 0; y < side; ++y)
+    {
+        for (unsigned int x = 0; x < side; ++x)
+        {
+            std::size_t packet = (std::size_t(y / 2) * (side / 2) + x / 2) * 4 + (y % 2) * 2 + x % 2;
+            float px = (float(x) + 0.5f) / float(side) * 2.0f - 1.0f, py = (float(y) + 0.5f) / float(side) * 2.0f - 1.0f;
+            camera[packet].origin = eye;
+            camera[packet].direction = forward + 0.45f * (px * right + py * up);
+        }
+    }
+
+    // random rays : random points of the bounds towards random directions (ambient occlusion like)
+    std::vector<Ray> random(numberOfRays);
+    std::mt19937 generator(7);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (Ray & ray : random)
+    {
+        glm::vec3 a(unit(generator), unit(generator), unit(generator));
+        ray.origin = nodes[0].min + a * (nodes[0].max - nodes[0].min);
+        float z = 2.0f * unit(generator) - 1.0f, phi = 6.2831853f * unit(generator);
+        float r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+        ray.direction = glm::vec3(r * std::cos(phi), r * std::sin(phi), z);
+    }
+
+    auto measure = [&](const std::vector<Ray> & rays, int query, std::size_t & hits) {
+        hits = 0;
+        auto start = std::chrono::steady_clock::now();
+        if (query == 0) { RayHit hit; for (const Ray & ray : rays) hits += intersect(ray, hit); }
+        if (query == 1) { RayHit hit[4]; for (std::size_t r = 0; r < rays.size(); r += 4) { intersect4(&rays[r], hit); for (int k = 0; k < 4; ++k) hits += hit[k].triangle != NO_HIT; } }
+        if (query == 2) { for (const Ray & ray : rays) hits += occluded(ray); }
+        if (query == 3) { bool hit[4]; for (std::size_t r = 0; r < rays.size(); r += 4) { occluded4(&rays[r], hit); for (int k = 0; k < 4; ++k) hits += hit[k]; } }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return float(double(rays.size()) / seconds * 1e-6);
+    };
+
+    out << "BVH benchmark : " << leafTriangles.size() << " triangles, " << nodes.size() << " nodes, "
+        << numberOfRays << " rays, one thread" << std::endl;
+    out << "rays   | closest | closest x4 | any    | any x4 (Mrays/s) | hit" << std::endl;
+    const char * names[2] = {"camera", "random"};
+    const std::vector<Ray> * sets[2] = {&camera, &random};
+    for (int s = 0; s < 2; ++s)
+    {
+        std::size_t hits = 0;
+        out << names[s];
+        for (int query = 0; query < 4; ++query) out << " | " << measure(*sets[s], query, hits);
+        out << " | " << 100.0f * float(hits) / float(numberOfRays) << " %" << std::endl;
+    }
+}
@@ -0,0 +1,201 @@
+#include "Mesh.hpp"
+#include "MeshMath.hpp"
+#include "Parallel.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// ******************************************************************************************************
+// ******************************************************************************************************
+// ******************************************************************************************************
+// per-vertex values baked with rays against the BVH of the mesh
+//
+// every vertex shoots a fixed set of cosine weighted directions (Hammersley points, rotated by a
+// hash of the vertex position so neighbouring vertices don't band, and the copies of a vertex
+// along the uv seams get the same value) in packets of 4 : the rays of a
+// vertex start from the same point and go the same way, the packets stay coherent. The result
+// only depends on the mesh, never on the number of threads : vertices are split between the
+// threads with work stealing (parallel_for_stealing), a thread keeps neighbouring vertices.
+
+namespace {
+
+const unsigned int BAKE_GRAIN = 256;
+
+float radical_inverse(unsigned int i)
+{
+    i = (i << 16u) | (i >> 16u);
+    i = ((i & 0x55555555u) << 1u) | ((i & 0xAAAAAAAAu) >> 1u);
+    i = ((i & 0x33333333u) << 2u) | ((i & 0xCCCCCCCCu) >> 2u);
+    i = ((i & 0x0F0F0F0Fu) << 4u) | ((i & 0xF0F0F0F0u) >> 4u);
+    i = ((i & 0x00FF00FFu) << 8u) | ((i & 0xFF00FF00u) >> 8u);
+    return float(i) * 2.3283064365386963e-10f;
+}
+
+// [0, 1) from the vertex position
+float hash(const glm::vec3 & p)
+{
+    std::uint32_t bits[3];
+    std::memcpy(bits, &p, sizeof(bits));
+    std::uint32_t v = bits[0] ^ (bits[1] * 0x9e3779b9u) ^ (bits[2] * 0x85ebca6bu);
+    v ^= v >> 16; v *= 0x7feb352du;
+    v ^= v >> 15; v *= 0x846ca68bu;
+    v ^= v >> 16;
+    return float(v >> 8) * (1.0f / 16777216.0f);
+}
+
+// cosine weighted directions around +z, sample i of @count
+glm::vec3 cosine_direction(unsigned int i, unsigned int count, float rotation)
+{
+    float u = (float(i) + 0.5f) / float(count);
+    float phi = 2.0f * 3.14159265f * (radical_inverse(i) + rotation);
+    float r = std::sqrt(u);
+    return glm::vec3(r * std::cos(phi), r * std::sin(phi), std::sqrt(std::max(0.0f, 1.0f - u)));
+}
+
+// the winding of the source decides where the normals point : -1 when they point outward
+// (positive signed volume), 1 when they point inward
+float inward_sign(const std::vector<glm::vec3> & vertices, const std::vector<unsigned int> & triangles)
+{
+    double volume = 0.0;
+    for (std::size_t t = 0; t < triangles.size(); t += 3)
+    {
+        const glm::vec3 & p0 = vertices[triangles[t]];
+        volume += glm::dot(p0, glm::cross(vertices[triangles[t + 1]] - p0, vertices[triangles[t + 2]] - p0));
+    }
+    return (volume < 0.0) ? 1.0f : -1.0f;
+}
+
+// samples [first, first + 4) of the hemisphere around the unit vector @n, from @origin
+void hemisphere_packet(const glm::vec3 & origin, const glm::vec3 & n, unsigned int first, unsigned int samples,
+                       float rotation, float tmin, float tmax, Ray rays[4])
+{
+    glm::vec3 t, b;
+    basis(n, t, b);
+    for (unsigned int k = 0; k < 4; ++k)
+    {
+        glm::vec3 d = cosine_direction(first + k, samples, rotation);
+        rays[k].origin = origin;
+        rays[k].direction = t * d.x + b * d.y + n * d.z;
+        rays[k].tmin = tmin;
+        rays[k].tmax = tmax;
+    }
+}
+
+} // namespace
+
+void Mesh::bake_thickness(unsigned int samples)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    const std::size_t numberOfVertices = indexed_vertices.size();
+    vertex_thickness.assign(numberOfVertices, 1.0f);
+    if (indices.empty() || indexed_normals.size() != numberOfVertices) return;
+
+    const MeshBVH & tree = bvh();
+    samples = std::max(4u, (samples + 3) / 4 * 4);
+    const float diagonal = glm::length(bounding_box.dimension());
+    const float offset = 1e-4f * diagonal;       // start below the surface
+    const float tmin = 1e-3f * diagonal;         // ignore the triangles around the vertex
+    const float maxDistance = 0.5f * diagonal;   // rays leaving through an opening
+
+    const float inward = inward_sign(indexed_vertices, indices);
+
+    // mean distance to the other side of the mesh, inward around the normal
+    std::vector<float> distances(numberOfVertices, maxDistance);
+    parallel_for_stealing(0, numberOfVertices, BAKE_GRAIN, [&](std::size_t first, std::size_t last) {
+        Ray rays[4];
+        RayHit hits[4];
+        for (std::size_t v = first; v < last; ++v)
+        {
+            float length = glm::length(indexed_normals[v]);
+            if (length == 0.0f) continue;
+            const glm::vec3 n = indexed_normals[v] * (inward / length);
+            const float rotation = hash(indexed_vertices[v]);
+
+            float sum = 0.0f;
+            for (unsigned int s = 0; s < samples; s += 4)
+            {
+                hemisphere_packet(indexed_vertices[v] + n * offset, n, s, samples, rotation, tmin, maxDistance, rays);
+                for (unsigned int k = 0; k < 4; ++k) hits[k] = RayHit();
+                tree.intersect4(rays, hits);
+                for (unsigned int k = 0; k < 4; ++k) sum += (hits[k].triangle == NO_HIT) ? maxDistance : hits[k].t;
+            }
+            distances[v] = sum / float(samples);
+        }
+    });
+
+    // relative to the thick parts (95th percentile) so the shader doesn't depend on the scale
+    std::vector<float> sorted(distances);
+    std::nth_element(sorted.begin(), sorted.begin() + sorted.size() * 95 / 100, sorted.end());
+    const float reference = std::max(sorted[sorted.size() * 95 / 100], 1e-6f * diagonal);
+    for (std::size_t v = 0; v < numberOfVertices; ++v) vertex_thickness[v] = std::min(distances[v] / reference, 1.0f);
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Thickness : " << numberOfVertices << " vertices x " << samples << " rays in " << ms << " ms" << std::endl;
+}
+
+void Mesh::bake_occlusion(unsigned int samples, float radius, unsigned int threads)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    const std::size_t numberOfVertices = indexed_vertices.size();
+    vertex_occlusion.assign(numberOfVertices, 1.0f);
+    if (indices.empty() || indexed_normals.size() != numberOfVertices) return;
+
+    const MeshBVH & tree = bvh();
+    samples = std::max(4u, (samples + 3) / 4 * 4);
+    const float diagonal = glm::length(bounding_box.dimension());
+    const float offset = 1e-4f * diagonal;       // start above the surface
+    const float tmin = 1e-3f * diagonal;         // ignore the triangles around the vertex
+    const float tmax = radius * diagonal;        // only close geometry darkens (creases, between fingers)
+    const float outward = -inward_sign(indexed_vertices, indices);
+
+    // fraction of the outward hemisphere that reaches @tmax, rays weighted by the cosine
+    parallel_for_stealing(0, numberOfVertices, BAKE_GRAIN, [&](std::size_t first, std::size_t last) {
+        Ray rays[4];
+        bool occluded[4];
+        for (std::size_t v = first; v < last; ++v)
+        {
+            float length = glm::length(indexed_normals[v]);
+            if (length == 0.0f) continue;
+            const glm::vec3 n = indexed_normals[v] * (outward / length);
+            const float rotation = hash(indexed_vertices[v]);
+
+            unsigned int open = 0;
+            for (unsigned int s = 0; s < samples; s += 4)
+            {
+                hemisphere_packet(indexed_vertices[v] + n * offset, n, s, samples, rotation, tmin, tmax, rays);
+                tree.occluded4(rays, occluded);
+                for (unsigned int k = 0; k < 4; ++k) open += occluded[k] ? 0 : 1;
+            }
+            vertex_occlusion[v] = float(open) / float(samples);
+        }
+    }, threads);
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Ambient occlusion : " << numberOfVertices << " vertices x " << samples << " rays in " << ms << " ms" << std::endl;
+}
+
+void Mesh::benchmark_occlusion(std::ostream & out, unsigned int samples, float radius)
+{
+    bvh(); // not part of the timings
+    const std::vector<float> previous = vertex_occlusion;
+    std::vector<float> reference;
+    const unsigned int maxThreads = std::max(worker_count(), 4u);
+
+    out << "Ambient occlusion bake, " << indexed_vertices.size() << " vertices x " << samples << " rays ("
+        << worker_count() << " hardware threads) :" << std::endl;
+    double single = 0.0;
+    for (unsigned int threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        auto start = std::chrono::steady_clock::now();
+        bake_occlusion(samples, radius, threads);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (threads == 1) { single = ms; reference = vertex_occlusion; }
+        out << "  " << threads << " threads : " << ms << " ms, x" << single / std::max(ms, 1e-9)
+            << (vertex_occlusion == reference ? "" : " (differs from 1 thread)") << std::endl;
+    }
+    vertex_occlusion = previous;
+}
@@ -0,0 +1,41 @@
+#include "MeshLoader.hpp"
+
+#include <chrono>
+#include <exception>
+#include <iostream>
+
+void MeshLoader::load(const std::string & name)
+{
+    if (pending.valid()) pending.wait();
+
+    filename = name;
+    mesh.reset();
+    finished = false;
+    milliseconds = 0.0;
+    pending = std::async(std::launch::async, [this, name]() {
+        auto start = std::chrono::steady_clock::now();
+        auto loaded = std::make_shared<Mesh>(name.c_str());
+        milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return loaded;
+    });
+}
+
+bool MeshLoader::ready()
+{
+    if (finished) return true;
+    if (!pending.valid()) return false;
+    if (pending.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return false;
+
+    // an exception of the worker (out of memory...) is a failed load
+    try
+    {
+        mesh = pending.get();
+    }
+    catch (const std::exception & e)
+    {
+        std::cerr << "Mesh " << filename << " could not be loaded : " << e.what() << std::endl;
+        mesh.reset();
+    }
+    finished = true;
+    return true;
+}
@@ -0,0 +1,278 @@
+#include "Mesh.hpp"
+
+#include <type_traits>
+
+// ******************************************************************************************************
+// ******************************************************************************************************
+// ******************************************************************************************************
+// GPU friendly ordering of the triangles and vertices
+//
+// 1. Tipsify (Sander, Nehab, Barczak 2007) reorders the triangles for a post-transform cache
+//    of a given size by fanning around the most recently used vertices.
+// 2. the Tipsify sequence is cut in clusters and the clusters are sorted so that the ones
+//    facing away from the center of the mesh are drawn first (linear-speed overdraw
+//    optimisation from the same paper) : they occlude the inner ones and early-z rejects the
+//    expensive skin fragments behind them.
+// 3. vertices are renumbered in order of first use so the vertex fetch walks memory forward.
+
+namespace {
+
+// simulate a FIFO post-transform cache and return the number of transformed vertices
+std::size_t count_cache_misses(const unsigned int * triangles, std::size_t numberOfIndices,
+                               std::size_t numberOfVertices, unsigned int cache_size,
+                               std::vector<unsigned int> & timestamps)
+{
+    timestamps.assign(numberOfVertices, 0);
+    unsigned int time = cache_size + 1;
+    std::size_t misses = 0;
+    for (std::size_t i = 0; i < numberOfIndices; ++i)
+    {
+        unsigned int v = triangles[i];
+        if (time - timestamps[v] > cache_size)
+        {
+            timestamps[v] = time++;
+            ++misses;
+        }
+    }
+    return misses;
+}
+
+} // namespace
+
+float Mesh::compute_ACMR(unsigned int cache_size) const
+{
+    if (indices.empty()) return 0.0f;
+    std::vector<unsigned int> timestamps;
+    std::size_t misses = count_cache_misses(indices.data(), indices.size(), indexed_vertices.size(), cache_size, timestamps);
+    return float(misses) / float(getNumberOfTriangles());
+}
+
+float Mesh::compute_ATVR(unsigned int cache_size) const
+{
+    if (indices.empty()) return 0.0f;
+    std::vector<unsigned int> timestamps;
+    std::size_t misses = count_cache_misses(indices.data(), indices.size(), indexed_vertices.size(), cache_size, timestamps);
+
+    // only count the vertices referenced by the triangles
+    std::vector<bool> used(indexed_vertices.size(), false);
+    std::size_t numberOfUsed = 0;
+    for (unsigned int v : indices)
+    {
+        if (!used[v]) { used[v] = true; ++numberOfUsed; }
+    }
+    return float(misses) / float(numberOfUsed);
+}
+
+void Mesh::optimize_for_gpu(unsigned int cache_size)
+{
+    if (indices.empty()) return;
+
+    float acmrBefore = compute_ACMR(cache_size), atvrBefore = compute_ATVR(cache_size);
+
+    std::vector<unsigned int> clusters;
+    optimize_vertex_cache(cache_size, clusters);
+    optimize_overdraw(clusters);
+    optimize_vertex_fetch();
+
+    std::cout << "Vertex cache (" << cache_size << " entries) : ACMR " << acmrBefore << " -> " << compute_ACMR(cache_size)
+              << ", ATVR " << atvrBefore << " -> " << compute_ATVR(cache_size) << " (" << clusters.size()
+              << " overdraw clusters)" << std::endl;
+}
+
+void Mesh::optimize_vertex_cache(unsigned int cache_size, std::vector<unsigned int> & clusters)
+{
+    const std::size_t numberOfVertices = indexed_vertices.size();
+    const std::size_t numberOfTriangles = getNumberOfTriangles();
+    const MeshAdjacency & ring = adjacency();
+
+    // live triangles of each vertex, cache timestamps, dead-end stack
+    std::vector<unsigned int> live(numberOfVertices), timestamps(numberOfVertices, 0);
+    for (std::size_t v = 0; v < numberOfVertices; ++v) live[v] = ring.corners_end(v) - ring.corners_begin(v);
+    std::vector<unsigned int> deadEnd;
+    std::vector<bool> emitted(numberOfTriangles, false);
+    std::vector<unsigned int> candidates;
+
+    std::vector<unsigned int> output;
+    output.reserve(indices.size());
+    clusters.clear();
+
+    unsigned int time = cache_size + 1;
+    std::size_t cursor = 0;
+    long fanning = 0;
+    while (fanning >= 0 && cursor <= numberOfVertices)
+    {
+        // emit every live triangle around the fanning vertex
+        candidates.clear();
+        for (const unsigned int * c = ring.corners_begin(fanning); c != ring.corners_end(fanning); ++c)
+        {
+            const unsigned int t = *c / 3;
+            if (emitted[t]) continue;
+            emitted[t] = true;
+            for (unsigned int k = 0; k < 3; ++k)
+            {
+                unsigned int v = indices[3 * t + k];
+                output.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                --live[v];
+                if (time - timestamps[v] > cache_size) timestamps[v] = time++;
+            }
+        }
+
+        // next fanning vertex : the candidate that will still be in cache after its fan
+        long next = -1; long priority = -1;
+        for (unsigned int v : candidates)
+        {
+            if (live[v] == 0) continue;
+            long p = 0;
+            if (time - timestamps[v] + 2 * live[v] <= cache_size) p = time - timestamps[v];
+            if (p > priority) { priority = p; next = v; }
+        }
+
+        if (next < 0)
+        {
+            // dead end : most recent vertex with live triangles, else the next one in input order
+            while (!deadEnd.empty() && next < 0)
+            {
+                unsigned int v = deadEnd.back(); deadEnd.pop_back();
+                if (live[v] > 0) next = v;
+            }
+            while (next < 0 && cursor < numberOfVertices)
+            {
+                if (live[cursor] > 0) next = long(cursor);
+                ++cursor;
+            }
+        }
+        fanning = next;
+    }
+
+    // triangles of isolated or unreachable vertices (none on a valid mesh) keep their order
+    for (std::size_t t = 0; t < numberOfTriangles; ++t)
+    {
+        if (!emitted[t]) output.insert(output.end(), indices.begin() + 3 * t, indices.begin() + 3 * t + 3);
+    }
+    indices.swap(output);
+
+    // cluster boundaries : triangles whose 3 vertices all miss the cache start a new cluster
+    // (hard boundaries), clusters are then split where the local ACMR gets close to the
+    // global one (soft boundaries, threshold of the paper)
+    const float threshold = 1.05f;
+    const float globalACMR = compute_ACMR(cache_size);
+    std::fill(timestamps.begin(), timestamps.end(), 0);
+    time = cache_size + 1;
+    std::size_t clusterStart = 0, clusterMisses = 0;
+    for (std::size_t t = 0; t < numberOfTriangles; ++t)
+    {
+        unsigned int misses = 0;
+        for (unsigned int k = 0; k < 3; ++k)
+        {
+            unsigned int v = indices[3 * t + k];
+            if (time - timestamps[v] > cache_size) { timestamps[v] = time++; ++misses; }
+        }
+        std::size_t size = t - clusterStart;
+        bool hard = (misses == 3);
+        bool soft = size > 0 && float(clusterMisses) / float(size) <= globalACMR * threshold && size >= 64;
+        if (t == 0 || hard || soft)
+        {
+            clusters.push_back(unsigned(t));
+            clusterStart = t;
+            clusterMisses = 0;
+        }
+        clusterMisses += misses;
+    }
+
+    invalidate_adjacency();
+}
+
+void Mesh::optimize_overdraw(const std::vector<unsigned int> & clusters)
+{
+    if (clusters.size() < 2) return;
+
+    const std::size_t numberOfTriangles = getNumberOfTriangles();
+
+    // area weighted centroid of the whole mesh
+    glm::vec3 meshCentroid(0.0f); float meshArea = 0.0f;
+    std::vector<glm::vec3> centroids(numberOfTriangles);
+    std::vector<glm::vec3> weightedNormals(numberOfTriangles);
+    for (std::size_t t = 0; t < numberOfTriangles; ++t)
+    {
+        const glm::vec3 & p0 = indexed_vertices[indices[3 * t]];
+        const glm::vec3 & p1 = indexed_vertices[indices[3 * t + 1]];
+        const glm::vec3 & p2 = indexed_vertices[indices[3 * t + 2]];
+        glm::vec3 c = glm::cross(p1 - p0, p2 - p0); // length is twice the area
+        float area = glm::length(c) * 0.5f;
+        centroids[t] = (p0 + p1 + p2) / 3.0f;
+        weightedNormals[t] = c * 0.5f;
+        meshCentroid += centroids[t] * area;
+        meshArea += area;
+    }
+    if (meshArea > 0.0f) meshCentroid /= meshArea;
+
+    // sort key of a cluster : how much it faces away from the center
+    struct Cluster { unsigned int first, last; float key; };
+    std::vector<Cluster> sorted(clusters.size());
+    for (std::size_t c = 0; c < clusters.size(); ++c)
+    {
+        unsigned int first = clusters[c];
+        unsigned int last = (c + 1 < clusters.size()) ? clusters[c + 1] : unsigned(numberOfTriangles);
+        glm::vec3 centroid(0.0f), normal(0.0f); float area = 0.0f;
+        for (unsigned int t = first; t < last; ++t)
+        {
+            float a = glm::length(weightedNormals[t]);
+            centroid += centroids[t] * a;
+            normal += weightedNormals[t];
+            area += a;
+        }
+        if (area > 0.0f) centroid /= area;
+        float length = glm::length(normal);
+        float key = (length > 0.0f) ? glm::dot(centroid - meshCentroid, normal / length) : 0.0f;
+        sorted[c] = {first, last, key};
+    }
+    std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster & a, const Cluster & b) { return a.key > b.key; });
+
+    std::vector<unsigned int> output;
+    output.reserve(indices.size());
+    for (const Cluster & cluster : sorted)
+    {
+        output.insert(output.end(), indices.begin() + 3 * cluster.first, indices.begin() + 3 * cluster.last);
+    }
+    indices.swap(output);
+    invalidate_adjacency();
+}
+
+void Mesh::optimize_vertex_fetch()
+{
+    const std::size_t numberOfVertices = indexed_vertices.size();
+    const unsigned int unset = ~0u;
+
+    // new index of each vertex : order of first use, unused vertices at the end
+    std::vector<unsigned int> remap(numberOfVertices, unset);
+    unsigned int next = 0;
+    for (unsigned int & v : indices)
+    {
+        if (remap[v] == unset) remap[v] = next++;
+        v = remap[v];
+    }
+    for (std::size_t v = 0; v < numberOfVertices; ++v)
+    {
+        if (remap[v] == unset) remap[v] = next++;
+    }
+    for (unsigned int & v : lod_indices) v = remap[v];
+
+    auto permute = [&remap](auto & attribute) {
+        if (attribute.size() != remap.size()) return;
+        typename std::decay<decltype(attribute)>::type reordered(attribute.size());
+        for (std::size_t v = 0; v < remap.size(); ++v) reordered[remap[v]] = attribute[v];
+        attribute.swap(reordered);
+    };
+    permute(indexed_vertices);
+    permute(indexed_normals);
+    permute(indexed_uvs);
+    permute(valence_field);
+    permute(vertex_thickness);
+    permute(vertex_occlusion);
+
+    // triangles moved : refresh the per-triangle caches
+    compute_triangle_normals(indexed_vertices, indices, triangle_normals, triangle_areas);
+    invalidate_adjacency();
+}
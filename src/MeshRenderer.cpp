@@ -1,117 +1,57 @@
 #include "MeshRenderer.hpp"
 
-MeshRenderer::MeshRenderer(unsigned int shaderID, unsigned int depthShaderID, Mesh& mesh)
-    : VertexArrayID(0), vertexbuffer(0), uvbuffer(0), normalbuffer(0), elementbuffer(0)
+UniformRing * MeshRenderer::uniformRing = nullptr;
+int MeshRenderer::viewportHeight = 0;
+
+MeshRenderer::MeshRenderer(unsigned int shaderID, unsigned int depthShaderID, std::shared_ptr<MeshAsset> meshAsset)
+    : asset(std::move(meshAsset))
 {
-    tridimodel = mesh;
     model = glm::mat4(1.0f);
 
-    glGenVertexArrays(1, &VertexArrayID);
-    glBindVertexArray(VertexArrayID);
-    
     programID = shaderID;
     depthProgramID = depthShaderID;
-
-    glGenBuffers(1, &vertexbuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
-    glBufferData(GL_ARRAY_BUFFER, tridimodel.indexed_vertices.size() * sizeof(glm::vec3), &tridimodel.indexed_vertices[0], GL_STATIC_DRAW);
-
-    glGenBuffers(1, &uvbuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, uvbuffer);
-    glBufferData(GL_ARRAY_BUFFER, tridimodel.indexed_uvs.size() * sizeof(glm::vec2), &tridimodel.indexed_uvs[0], GL_STATIC_DRAW);
-
-    glGenBuffers(1, &normalbuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, normalbuffer);
-    glBufferData(GL_ARRAY_BUFFER, tridimodel.indexed_normals.size() * sizeof(glm::vec3), &tridimodel.indexed_normals[0], GL_STATIC_DRAW);
-
-    // Generate a buffer for the indices as well
-    glGenBuffers(1, &elementbuffer);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, tridimodel.indices.size() * sizeof(unsigned short), &tridimodel.indices[0] , GL_STATIC_DRAW);
-
-    // Get a handle for our "LightPosition" uniform
-    glUseProgram(programID);
-
-    // 1rst attribute buffer : vertices
-    glEnableVertexAttribArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
-    glVertexAttribPointer(
-            0,                  // attribute
-            3,                  // size
-            GL_FLOAT,           // type
-            GL_FALSE,           // normalized?
-            0,                  // stride
-            nullptr            // array buffer offset
-    );
-
-    // 2nd attribute buffer : UVs
-    glEnableVertexAttribArray(1);
-    glBindBuffer(GL_ARRAY_BUFFER, uvbuffer);
-    glVertexAttribPointer(
-            1,                                // attribute
-            2,                                // size
-            GL_FLOAT,                         // type
-            GL_FALSE,                         // normalized?
-            0,                                // stride
-            nullptr                          // array buffer offset
-    );
-
-    // 3rd attribute buffer : normals
-    glEnableVertexAttribArray(2);
-    glBindBuffer(GL_ARRAY_BUFFER, normalbuffer);
-    glVertexAttribPointer(
-            2,                                // attribute
-            3,                                // size
-            GL_FLOAT,                         // type
-            GL_FALSE,                         // normalized?
-            0,                                // stride
-            nullptr                          // array buffer offset
-    );
-
-    // Index buffer
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer);
-
 }
 
 MeshRenderer::~MeshRenderer() = default;
 
 
-void MeshRenderer::draw(unsigned int ShaderID, Camera & camera, LightSource & light)
+void MeshRenderer::draw(unsigned int ShaderID, Camera & camera, LightSource & /*light : in the frame block*/)
 {
     //createDepthMapFromLight(light);
     //createDepthMapFromEye(camera);
 
     // Use our shader
     glUseProgram(ShaderID);
-    // Model matrix : an identity matrix (model will be at the origin)
-    glm::mat4 ModelMatrix      = glm::mat4(1.0f);
-    float decalageX = -(tridimodel.bounding_box.xpos.y - ((tridimodel.bounding_box.xpos.y + abs(tridimodel.bounding_box.xpos.x)) / 2.0f) ); 
-    float decalageY = -(tridimodel.bounding_box.ypos.y - ((tridimodel.bounding_box.ypos.y + abs(tridimodel.bounding_box.ypos.x)) / 2.0f) ); 
-    float decalageZ = -(tridimodel.bounding_box.zpos.y - ((tridimodel.bounding_box.zpos.y + abs(tridimodel.bounding_box.zpos.x)) / 2.0f) ); 
-    ModelMatrix = glm::scale(ModelMatrix, glm::vec3(1.0/(tridimodel.bounding_box.ypos.y+decalageY)));
-    ModelMatrix = glm::translate(ModelMatrix, glm::vec3(decalageX + 0.5, decalageY, decalageZ -0.5) );
 
-    // Send our transformation to the currently bound shader,
-    glUniformMatrix4fv(glGetUniformLocation(ShaderID, "projection"), 1, GL_FALSE, &camera.projection[0][0]);
-    glUniformMatrix4fv(glGetUniformLocation(ShaderID, "modelGlobal"), 1, GL_FALSE, &ModelMatrix[0][0]);
-    glUniformMatrix4fv(glGetUniformLocation(ShaderID, "view"), 1, GL_FALSE, &camera.GetViewMatrix()[0][0]);
-    glUniformMatrix4fv(glGetUniformLocation(ShaderID, "model"), 1, GL_FALSE, &model[0][0]);
-
-    //glm::vec3 lightPos = glm::vec3(0.0f+cos((double)lightPlacement)*4.0f,4.0f,0.0f+sin((double)lightPlacement)*4.0f);
-    glUniform3f(glGetUniformLocation(ShaderID, "lightPos"), light.position.x, light.position.y, light.position.z);
-    glUniform3f(glGetUniformLocation(ShaderID, "viewPos"), camera.Position.x, camera.Position.y, camera.Position.z);
-    glUniform3f(glGetUniformLocation(ShaderID, "lightColor"), light.color.x, light.color.y, light.color.z);
-    glUniform3f(glGetUniformLocation(ShaderID, "objectColor"), color.x, color.y, color.z);
-
-    glBindVertexArray(VertexArrayID);
+    // camera and light are in the frame block, only the object block changes between draws
+    ObjectUniforms object = objectUniforms(model, color);
+    if (uniformRing != nullptr) uniformRing->bind(OBJECT_BLOCK_BINDING, &object, sizeof(object));
+
+    // level of detail : a range of the element buffer
+    currentLod = automaticLod ? selectLod(camera, model) : 0;
+    unsigned int first = 0;
+    drawCount = asset->mesh->indices.size();
+    if (currentLod < asset->mesh->lods.size())
+    {
+        first = asset->mesh->lods[currentLod].first;
+        drawCount = asset->mesh->lods[currentLod].count;
+    }
+
+    // mirrored models turn the triangles around
+    bool mirrored = glm::determinant(model) < 0.0f;
+    if (mirrored) glFrontFace(GL_CW);
+
+    glBindVertexArray(asset->VertexArrayID);
     // Draw the triangles !
     glDrawElements(
                 GL_TRIANGLES,      // mode
-                tridimodel.indices.size(),    // count
-                GL_UNSIGNED_SHORT,   // type
-                nullptr           // element array buffer offset
+                drawCount,    // count
+                asset->indexType,   // type
+                reinterpret_cast<const void *>(std::size_t(first) * asset->mesh->index_width) // element array buffer offset
                 );
 
+    if (mirrored) glFrontFace(GL_CCW);
+
     /*glDisableVertexAttribArray(0);
     glDisableVertexAttribArray(1);
     glDisableVertexAttribArray(2);*/
@@ -120,30 +60,156 @@ void MeshRenderer::draw(unsigned int ShaderID, Camera & camera, LightSource & li
     //glUniformMatrix4fv(glGetUniformLocation(depthProgramID, "model"), 1, GL_FALSE, &model[0][0]);
 }
 
+void MeshRenderer::drawInstanced(unsigned int ShaderID, Camera & camera, LightSource & /*light : in the frame block*/, const std::vector<MeshInstance> & instances)
+{
+    instancedDraws = 0;
+    if (instances.empty()) return;
+    if (instanceVertexArrayID == 0 || instanceLayout != asset->getLayoutVersion()) createInstanceArray();
+
+    glUseProgram(ShaderID);
+
+    // model and colour come from the instance buffer, the object block only carries the vertex format
+    ObjectUniforms object = objectUniforms(glm::mat4(1.0f), glm::vec3(1.0f));
+    if (uniformRing != nullptr) uniformRing->bind(OBJECT_BLOCK_BINDING, &object, sizeof(object));
+
+    // group of an instance : level of detail * 2 + mirrored, sorted with a counting sort
+    const std::vector<MeshLod> & lods = asset->mesh->lods;
+    const unsigned int numberOfGroups = 2 * std::max<unsigned int>(1, lods.size());
+    instanceGroups.resize(instances.size());
+    std::vector<unsigned int> groupStart(numberOfGroups + 1, 0);
+    for (std::size_t i = 0; i < instances.size(); ++i)
+    {
+        unsigned int lod = (automaticLod && !lods.empty()) ? selectLod(camera, instances[i].model) : 0;
+        unsigned int mirrored = glm::determinant(instances[i].model) < 0.0f ? 1 : 0;
+        instanceGroups[i] = 2 * lod + mirrored;
+        ++groupStart[instanceGroups[i] + 1];
+    }
+    for (unsigned int g = 0; g < numberOfGroups; ++g) groupStart[g + 1] += groupStart[g];
+
+    instanceAttributes.resize(instances.size());
+    std::vector<unsigned int> cursor(groupStart.begin(), groupStart.end() - 1);
+    for (std::size_t i = 0; i < instances.size(); ++i)
+    {
+        InstanceAttributes & attributes = instanceAttributes[cursor[instanceGroups[i]]++];
+        attributes.model = instances[i].model;
+        attributes.color = instances[i].color;
+    }
+
+    // orphan the buffer so the upload never waits for the previous frame
+    glBindBuffer(GL_ARRAY_BUFFER, instancebuffer);
+    std::size_t bytes = instanceAttributes.size() * sizeof(InstanceAttributes);
+    if (bytes > instanceCapacity) instanceCapacity = std::max(bytes, 2 * instanceCapacity);
+    glBufferData(GL_ARRAY_BUFFER, instanceCapacity, nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, instanceAttributes.data());
+
+    glBindVertexArray(instanceVertexArrayID);
+    for (unsigned int g = 0; g < numberOfGroups; ++g)
+    {
+        unsigned int count = groupStart[g + 1] - groupStart[g];
+        if (count == 0) continue;
+        unsigned int lod = g / 2;
+        unsigned int first = lods.empty() ? 0 : lods[lod].first;
+        unsigned int indexCount = lods.empty() ? unsigned(asset->mesh->indices.size()) : lods[lod].count;
+
+        glFrontFace((g % 2) ? GL_CW : GL_CCW);
+        glDrawElementsInstancedBaseInstance(
+                GL_TRIANGLES,
+                indexCount,
+                asset->indexType,
+                reinterpret_cast<const void *>(std::size_t(first) * asset->mesh->index_width),
+                count,
+                groupStart[g]);
+        ++instancedDraws;
+    }
+    glFrontFace(GL_CCW);
+}
+
+ObjectUniforms MeshRenderer::objectUniforms(const glm::mat4 & transform, const glm::vec3 & c) const
+{
+    // packed vertices : positions relative to the bounding box, octahedral normals
+    const Mesh & mesh = *asset->mesh;
+    ObjectUniforms object = {};
+    object.model = transform;
+    object.objectColor = c;
+    object.positionOffset = mesh.position_offset();
+    object.positionScale = mesh.position_scale();
+    object.octahedralNormals = (mesh.vertex_format == VERTEX_PACKED);
+    return object;
+}
+
+void MeshRenderer::createInstanceArray()
+{
+    if (instanceVertexArrayID == 0)
+    {
+        glGenVertexArrays(1, &instanceVertexArrayID);
+        glGenBuffers(1, &instancebuffer);
+    }
+    glBindVertexArray(instanceVertexArrayID);
+
+    // mesh attributes, same layout as the vertex array of the asset
+    asset->setupVertexAttributes();
+    instanceLayout = asset->getLayoutVersion();
+
+    // instance attributes : model matrix (8 to 11), color (15)
+    glBindBuffer(GL_ARRAY_BUFFER, instancebuffer);
+    const GLsizei stride = sizeof(InstanceAttributes);
+    for (GLuint c = 0; c < 4; ++c)
+    {
+        glEnableVertexAttribArray(8 + c);
+        glVertexAttribPointer(8 + c, 4, GL_FLOAT, GL_FALSE, stride,
+                              reinterpret_cast<const void *>(offsetof(InstanceAttributes, model) + c * sizeof(glm::vec4)));
+        glVertexAttribDivisor(8 + c, 1);
+    }
+    glEnableVertexAttribArray(15);
+    glVertexAttribPointer(15, 3, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<const void *>(offsetof(InstanceAttributes, color)));
+    glVertexAttribDivisor(15, 1);
+}
+
+unsigned int MeshRenderer::selectLod(const Camera & camera, const glm::mat4 & transform) const
+{
+    if (asset->mesh->lods.size() < 2) return 0;
+
+    // bounding sphere of the mesh in world space
+    const BOX & box = asset->mesh->bounding_box;
+    glm::vec3 center(0.5f * (box.xpos.x + box.xpos.y), 0.5f * (box.ypos.x + box.ypos.y), 0.5f * (box.zpos.x + box.zpos.y));
+    glm::vec3 halfSize(0.5f * (box.xpos.y - box.xpos.x), 0.5f * (box.ypos.y - box.ypos.x), 0.5f * (box.zpos.y - box.zpos.x));
+    float scale = std::max(glm::length(glm::vec3(transform[0])), std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+    glm::vec3 worldCenter = glm::vec3(transform * glm::vec4(center, 1.0f));
+    float radius = glm::length(halfSize) * scale;
+
+    // pixels covered by one model unit at the front of the sphere (everything if the camera is inside)
+    float distance = glm::length(worldCenter - camera.Position) - radius;
+    if (distance <= 0.0f) return 0;
+    const float height = float(viewportHeight > 0 ? unsigned(viewportHeight) : SCR_HEIGHT);
+    float pixelsPerUnit = scale * camera.projection[1][1] * 0.5f * height / distance;
+
+    return asset->mesh->select_lod(lodPixelError / pixelsPerUnit);
+}
+
 void MeshRenderer::updateBuffers()
 {
-    glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
-    glBufferData(GL_ARRAY_BUFFER, tridimodel.indexed_vertices.size() * sizeof(glm::vec3), &tridimodel.indexed_vertices[0], GL_STATIC_DRAW);
-    glBindBuffer(GL_ARRAY_BUFFER, uvbuffer);
-    glBufferData(GL_ARRAY_BUFFER, tridimodel.indexed_uvs.size() * sizeof(glm::vec2), &tridimodel.indexed_uvs[0], GL_STATIC_DRAW);
-    glBindBuffer(GL_ARRAY_BUFFER, normalbuffer);
-    glBufferData(GL_ARRAY_BUFFER, tridimodel.indexed_normals.size() * sizeof(glm::vec3), &tridimodel.indexed_normals[0], GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, tridimodel.indices.size() * sizeof(unsigned short), &tridimodel.indices[0] , GL_STATIC_DRAW);
+    asset->updateBuffers();
+}
+
+void MeshRenderer::forceIndexWidth(bool force_32_bits)
+{
+    asset->forceIndexWidth(force_32_bits);
 }
 
 void MeshRenderer::cleanUp()
 {
-    // Cleanup VBO and shader
-    glDeleteBuffers(1, &vertexbuffer);
-    glDeleteBuffers(1, &uvbuffer);
-    glDeleteBuffers(1, &normalbuffer);
-    glDeleteBuffers(1, &elementbuffer);
+    // Cleanup VBO (with the last renderer of the asset) and shader
+    asset.reset();
+    if (instanceVertexArrayID != 0)
+    {
+        glDeleteBuffers(1, &instancebuffer);
+        glDeleteVertexArrays(1, &instanceVertexArrayID);
+        instanceVertexArrayID = instancebuffer = 0;
+    }
 
     //***********************************************//
     glDeleteProgram(programID);
     glDeleteProgram(depthProgramID);
-    glDeleteVertexArrays(1, &VertexArrayID);
 }
 /*
 void MeshRenderer::createDepthMapFromLight(LightSource &light) const {
@@ -152,10 +218,10 @@ void MeshRenderer::createDepthMapFromLight(LightSource &light) const {
 
     // Model matrix : an identity matrix (model will be at the origin)
     glm::mat4 ModelMatrix      = glm::mat4(1.0f);
-    float decalageX = -(tridimodel.bounding_box.xpos.y - ((tridimodel.bounding_box.xpos.y + abs(tridimodel.bounding_box.xpos.x)) / 2.0f) );
-    float decalageY = -(tridimodel.bounding_box.ypos.y - ((tridimodel.bounding_box.ypos.y + abs(tridimodel.bounding_box.ypos.x)) / 2.0f) );
-    float decalageZ = -(tridimodel.bounding_box.zpos.y - ((tridimodel.bounding_box.zpos.y + abs(tridimodel.bounding_box.zpos.x)) / 2.0f) );
-    ModelMatrix = glm::scale(ModelMatrix, glm::vec3(1.0/(tridimodel.bounding_box.ypos.y+decalageY)));
+    float decalageX = -(asset->mesh->bounding_box.xpos.y - ((asset->mesh->bounding_box.xpos.y + abs(asset->mesh->bounding_box.xpos.x)) / 2.0f) );
+    float decalageY = -(asset->mesh->bounding_box.ypos.y - ((asset->mesh->bounding_box.ypos.y + abs(asset->mesh->bounding_box.ypos.x)) / 2.0f) );
+    float decalageZ = -(asset->mesh->bounding_box.zpos.y - ((asset->mesh->bounding_box.zpos.y + abs(asset->mesh->bounding_box.zpos.x)) / 2.0f) );
+    ModelMatrix = glm::scale(ModelMatrix, glm::vec3(1.0/(asset->mesh->bounding_box.ypos.y+decalageY)));
     ModelMatrix = glm::translate(ModelMatrix, glm::vec3(decalageX + 0.5, decalageY, decalageZ -0.5) );
 
     // Send our transformation to the currently bound shader,
@@ -170,7 +236,7 @@ void MeshRenderer::createDepthMapFromLight(LightSource &light) const {
 
     // 1rst attribute buffer : vertices
     glEnableVertexAttribArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, asset->vertexbuffer);
     glVertexAttribPointer(
             0,                  // attribute
             3,                  // size
@@ -180,13 +246,13 @@ void MeshRenderer::createDepthMapFromLight(LightSource &light) const {
             nullptr            // array buffer offset
     );
     // Index buffer
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, asset->elementbuffer);
 
     // Draw the triangles !
     glDrawElements(
             GL_TRIANGLES,      // mode
-            tridimodel.indices.size(),    // count
-            GL_UNSIGNED_SHORT,   // type
+            asset->mesh->indices.size(),    // count
+            asset->indexType,   // type
             nullptr           // element array buffer offset
     );
 
@@ -204,10 +270,10 @@ void MeshRenderer::createDepthMapFromEye(Camera &eye) {
 
     // Model matrix : an identity matrix (model will be at the origin)
     glm::mat4 ModelMatrix      = glm::mat4(1.0f);
-    float decalageX = -(tridimodel.bounding_box.xpos.y - ((tridimodel.bounding_box.xpos.y + abs(tridimodel.bounding_box.xpos.x)) / 2.0f) );
-    float decalageY = -(tridimodel.bounding_box.ypos.y - ((tridimodel.bounding_box.ypos.y + abs(tridimodel.bounding_box.ypos.x)) / 2.0f) );
-    float decalageZ = -(tridimodel.bounding_box.zpos.y - ((tridimodel.bounding_box.zpos.y + abs(tridimodel.bounding_box.zpos.x)) / 2.0f) );
-    ModelMatrix = glm::scale(ModelMatrix, glm::vec3(1.0/(tridimodel.bounding_box.ypos.y+decalageY)));
+    float decalageX = -(asset->mesh->bounding_box.xpos.y - ((asset->mesh->bounding_box.xpos.y + abs(asset->mesh->bounding_box.xpos.x)) / 2.0f) );
+    float decalageY = -(asset->mesh->bounding_box.ypos.y - ((asset->mesh->bounding_box.ypos.y + abs(asset->mesh->bounding_box.ypos.x)) / 2.0f) );
+    float decalageZ = -(asset->mesh->bounding_box.zpos.y - ((asset->mesh->bounding_box.zpos.y + abs(asset->mesh->bounding_box.zpos.x)) / 2.0f) );
+    ModelMatrix = glm::scale(ModelMatrix, glm::vec3(1.0/(asset->mesh->bounding_box.ypos.y+decalageY)));
     ModelMatrix = glm::translate(ModelMatrix, glm::vec3(decalageX + 0.5, decalageY, decalageZ -0.5) );
 
     glm::mat4 projCam = eye.projection;
@@ -224,7 +290,7 @@ void MeshRenderer::createDepthMapFromEye(Camera &eye) {
 
     // 1rst attribute buffer : vertices
     glEnableVertexAttribArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, asset->vertexbuffer);
     glVertexAttribPointer(
             0,                  // attribute
             3,                  // size
@@ -234,13 +300,13 @@ void MeshRenderer::createDepthMapFromEye(Camera &eye) {
             nullptr            // array buffer offset
     );
     // Index buffer
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, asset->elementbuffer);
 
     // Draw the triangles !
     glDrawElements(
             GL_TRIANGLES,      // mode
-            tridimodel.indices.size(),    // count
-            GL_UNSIGNED_SHORT,   // type
+            asset->mesh->indices.size(),    // count
+            asset->indexType,   // type
             nullptr           // element array buffer offset
     );
 
@@ -0,0 +1,302 @@
+#include "Mesh.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <queue>
+
+// ******************************************************************************************************
+// ******************************************************************************************************
+// ******************************************************************************************************
+// simplify vertices / normals of the mesh : quadric error metrics (Garland & Heckbert 1997)
+//
+// every vertex carries the sum of the squared distances to the planes of its triangles, an edge
+// collapse merges the quadrics of its two vertices. Collapses are half-edge collapses : the removed
+// vertex moves onto the kept one, so every level of detail is a new index list over the vertices of
+// the full mesh and all levels share one vertex buffer.
+
+namespace {
+
+// symmetric 4x4 matrix, upper triangle
+struct Quadric {
+    double a[10] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+
+    void add_plane(const glm::vec4 & p)
+    {
+        a[0] += p.x * p.x; a[1] += p.x * p.y; a[2] += p.x * p.z; a[3] += p.x * p.w;
+        a[4] += p.y * p.y; a[5] += p.y * p.z; a[6] += p.y * p.w;
+        a[7] += p.z * p.z; a[8] += p.z * p.w;
+        a[9] += p.w * p.w;
+    }
+
+    Quadric & operator+=(const Quadric & q)
+    {
+        for (int i = 0; i < 10; ++i) a[i] += q.a[i];
+        return *this;
+    }
+
+    // squared distance of @p to the planes
+    double error(const glm::vec3 & p) const
+    {
+        double x = p.x, y = p.y, z = p.z;
+        return a[0] * x * x + 2 * a[1] * x * y + 2 * a[2] * x * z + 2 * a[3] * x
+             + a[4] * y * y + 2 * a[5] * y * z + 2 * a[6] * y
+             + a[7] * z * z + 2 * a[8] * z
+             + a[9];
+    }
+};
+
+struct Collapse {
+    double cost;
+    unsigned int from, to;
+    unsigned int stampFrom, stampTo;
+    bool operator<(const Collapse & other) const { return cost > other.cost; } // min-heap
+};
+
+// decimate @indices down to @target_triangles with half-edge collapses, @out_error receives
+// the largest distance a collapse moved the surface
+void simplify(const std::vector<glm::vec3> & P, const std::vector<unsigned int> & indices,
+              const MeshAdjacency & ring, std::vector<Quadric> quadrics, const std::vector<bool> & locked,
+              std::size_t target_triangles, std::vector<unsigned int> & out_indices, float & out_error)
+{
+    const std::size_t numberOfVertices = P.size();
+    const std::size_t numberOfTriangles = indices.size() / 3;
+
+    // triangles around each vertex, updated by the collapses
+    std::vector<std::vector<unsigned int> > vertexTriangles(numberOfVertices);
+    for (std::size_t v = 0; v < numberOfVertices; ++v)
+    {
+        for (const unsigned int * c = ring.corners_begin(v); c != ring.corners_end(v); ++c)
+            vertexTriangles[v].push_back(*c / 3);
+    }
+
+    std::vector<unsigned int> triangles(indices);
+    std::vector<bool> removed(numberOfTriangles, false);
+    std::vector<unsigned int> stamps(numberOfVertices, 0);
+
+    // a collapse of @from onto @to is refused if it flips or degenerates a remaining triangle
+    auto collapse_is_valid = [&](unsigned int from, unsigned int to) {
+        for (unsigned int t : vertexTriangles[from])
+        {
+            if (removed[t]) continue;
+            const unsigned int * tri = &triangles[3 * t];
+            if (tri[0] == to || tri[1] == to || tri[2] == to) continue; // disappears
+            glm::vec3 p[3], q[3];
+            for (int k = 0; k < 3; ++k) { p[k] = P[tri[k]]; q[k] = (tri[k] == from) ? P[to] : P[tri[k]]; }
+            glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+            glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+            if (glm::dot(before, after) <= 0.2f * glm::length(before) * glm::length(after)) return false;
+        }
+        return true;
+    };
+
+    // link condition (Dey et al. 1999) : the vertices adjacent to both ends of the edge must be the
+    // apexes of the triangles on it, otherwise the collapse pinches the surface into a non-manifold
+    // edge or folds two sheets onto each other
+    std::vector<unsigned int> linkFrom, linkTo;
+    auto link_condition = [&](unsigned int from, unsigned int to) {
+        linkFrom.clear(); linkTo.clear();
+        std::size_t onEdge = 0;
+        for (unsigned int t : vertexTriangles[from])
+        {
+            if (removed[t]) continue;
+            const unsigned int * tri = &triangles[3 * t];
+            if (tri[0] == to || tri[1] == to || tri[2] == to) ++onEdge;
+            for (int k = 0; k < 3; ++k) if (tri[k] != from && tri[k] != to) linkFrom.push_back(tri[k]);
+        }
+        for (unsigned int t : vertexTriangles[to])
+        {
+            if (removed[t]) continue;
+            const unsigned int * tri = &triangles[3 * t];
+            for (int k = 0; k < 3; ++k) if (tri[k] != from && tri[k] != to) linkTo.push_back(tri[k]);
+        }
+        std::sort(linkFrom.begin(), linkFrom.end());
+        linkFrom.erase(std::unique(linkFrom.begin(), linkFrom.end()), linkFrom.end());
+        std::sort(linkTo.begin(), linkTo.end());
+        linkTo.erase(std::unique(linkTo.begin(), linkTo.end()), linkTo.end());
+        std::size_t common = 0;
+        for (std::size_t i = 0, j = 0; i < linkFrom.size() && j < linkTo.size(); )
+        {
+            if (linkFrom[i] < linkTo[j]) ++i;
+            else if (linkTo[j] < linkFrom[i]) ++j;
+            else { ++common; ++i; ++j; }
+        }
+        return onEdge > 0 && common == onEdge;
+    };
+
+    std::priority_queue<Collapse> queue;
+    auto push_edge = [&](unsigned int u, unsigned int v) {
+        double cost = 0.0;
+        Quadric q = quadrics[u]; q += quadrics[v];
+        if (!locked[u] && (locked[v] || q.error(P[v]) <= q.error(P[u])))
+        {
+            cost = q.error(P[v]);
+            queue.push({cost, u, v, stamps[u], stamps[v]});
+        }
+        else if (!locked[v])
+        {
+            cost = q.error(P[u]);
+            queue.push({cost, v, u, stamps[v], stamps[u]});
+        }
+    };
+    for (unsigned int u = 0; u < numberOfVertices; ++u)
+    {
+        for (const unsigned int * w = ring.neighbors_begin(u); w != ring.neighbors_end(u); ++w)
+        {
+            if (*w > u) push_edge(u, *w);
+        }
+    }
+
+    std::size_t liveTriangles = numberOfTriangles;
+    double maxError = 0.0;
+    std::vector<unsigned int> neighbors;
+    while (liveTriangles > target_triangles && !queue.empty())
+    {
+        Collapse collapse = queue.top(); queue.pop();
+        const unsigned int from = collapse.from, to = collapse.to;
+        if (collapse.stampFrom != stamps[from] || collapse.stampTo != stamps[to]) continue; // outdated
+        if (!link_condition(from, to) || !collapse_is_valid(from, to)) continue;
+
+        // move every triangle of @from onto @to, drop the ones that contained both
+        for (unsigned int t : vertexTriangles[from])
+        {
+            if (removed[t]) continue;
+            unsigned int * tri = &triangles[3 * t];
+            if (tri[0] == to || tri[1] == to || tri[2] == to)
+            {
+                removed[t] = true;
+                --liveTriangles;
+                continue;
+            }
+            for (int k = 0; k < 3; ++k) if (tri[k] == from) tri[k] = to;
+            vertexTriangles[to].push_back(t);
+        }
+        vertexTriangles[from].clear();
+        quadrics[to] += quadrics[from];
+        ++stamps[from]; ++stamps[to];
+        maxError = std::max(maxError, collapse.cost);
+
+        // costs of the edges around @to changed : the queued ones are outdated by its stamp, push
+        // them again with the merged quadric (edges between other vertices keep their cost)
+        neighbors.clear();
+        std::vector<unsigned int> & around = vertexTriangles[to];
+        around.erase(std::remove_if(around.begin(), around.end(), [&](unsigned int t) { return removed[t]; }), around.end());
+        for (unsigned int t : around)
+        {
+            for (int k = 0; k < 3; ++k) if (triangles[3 * t + k] != to) neighbors.push_back(triangles[3 * t + k]);
+        }
+        std::sort(neighbors.begin(), neighbors.end());
+        neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+        for (unsigned int w : neighbors) push_edge(to, w);
+    }
+
+    // remaining triangles in their original order, which keeps most of the vertex cache ordering
+    out_indices.clear();
+    out_indices.reserve(3 * liveTriangles);
+    for (std::size_t t = 0; t < numberOfTriangles; ++t)
+    {
+        if (!removed[t]) out_indices.insert(out_indices.end(), triangles.begin() + 3 * t, triangles.begin() + 3 * t + 3);
+    }
+    out_error = float(std::sqrt(std::max(maxError, 0.0)));
+}
+
+} // namespace
+
+void Mesh::build_lod_chain(unsigned int levels, float ratio)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    lods.assign(1, MeshLod{0, unsigned(indices.size()), 0.0f});
+    lod_indices.clear();
+    if (levels <= 1 || indices.empty()) return;
+
+    const std::size_t numberOfVertices = indexed_vertices.size();
+    const MeshAdjacency & ring = adjacency();
+    const std::vector<glm::vec3> & P = indexed_vertices;
+
+    // quadric of every vertex : planes of its triangles, gathered in parallel
+    // vertices on a border (edge with a single triangle) never move, this keeps holes and the
+    // wrist opening of the hands in place
+    std::vector<Quadric> quadrics(numberOfVertices);
+    std::vector<char> border(numberOfVertices, 0);
+    parallel_for(0, numberOfVertices, 2048, [&](std::size_t first, std::size_t last) {
+        for (std::size_t v = first; v < last; ++v)
+        {
+            for (const unsigned int * c = ring.corners_begin(v); c != ring.corners_end(v); ++c)
+            {
+                const unsigned int * t = &indices[*c - *c % 3];
+                glm::vec4 plane = equation_plane(P[t[0]].x, P[t[0]].y, P[t[0]].z,
+                                                 P[t[1]].x, P[t[1]].y, P[t[1]].z,
+                                                 P[t[2]].x, P[t[2]].y, P[t[2]].z);
+                float length = glm::length(glm::vec3(plane));
+                if (length > 0.0f) quadrics[v].add_plane(plane / length);
+            }
+            for (const unsigned int * w = ring.neighbors_begin(v); w != ring.neighbors_end(v) && !border[v]; ++w)
+            {
+                unsigned int shared = 0;
+                for (const unsigned int * c = ring.corners_begin(v); c != ring.corners_end(v); ++c)
+                {
+                    const unsigned int * t = &indices[*c - *c % 3];
+                    if (t[0] == *w || t[1] == *w || t[2] == *w) ++shared;
+                }
+                border[v] = (shared == 1);
+            }
+        }
+    });
+    const std::vector<bool> locked(border.begin(), border.end());
+
+    // each level is decimated from the full mesh, all levels at the same time
+    std::vector<std::vector<unsigned int> > levelIndices(levels - 1);
+    std::vector<float> levelErrors(levels - 1, 0.0f);
+    parallel_for(0, levels - 1, 1, [&](std::size_t first, std::size_t last) {
+        for (std::size_t l = first; l < last; ++l)
+        {
+            std::size_t target = std::size_t(float(getNumberOfTriangles()) * std::pow(ratio, float(l + 1)));
+            simplify(P, indices, ring, quadrics, locked, std::max<std::size_t>(target, 4), levelIndices[l], levelErrors[l]);
+        }
+    });
+
+    for (std::size_t l = 0; l + 1 < levels; ++l)
+    {
+        // a level that couldn't be simplified further is not worth a draw range
+        if (levelIndices[l].size() >= lods.back().count) continue;
+        lods.push_back(MeshLod{unsigned(indices.size() + lod_indices.size()), unsigned(levelIndices[l].size()),
+                               std::max(levelErrors[l], lods.back().error)});
+        lod_indices.insert(lod_indices.end(), levelIndices[l].begin(), levelIndices[l].end());
+    }
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "LOD chain :";
+    for (const MeshLod & lod : lods) std::cout << " " << lod.count / 3 << " (" << lod.error << ")";
+    std::cout << " triangles (error) in " << ms << " ms" << std::endl;
+}
+
+unsigned int Mesh::select_lod(float max_error) const
+{
+    // errors grow with the level : keep the coarsest one that is still accurate enough
+    unsigned int level = 0;
+    while (level + 1 < lods.size() && lods[level + 1].error <= max_error) ++level;
+    return level;
+}
+
+// calculate plane equation using 3 vertices
+glm::vec4 Mesh::equation_plane(float x1, float y1, float z1,
+                               float x2, float y2, float z2,
+                               float x3, float y3, float z3) const
+{
+    float a1 = x2 - x1;
+    float b1 = y2 - y1;
+    float c1 = z2 - z1;
+
+    float a2 = x3 - x1;
+    float b2 = y3 - y1;
+    float c2 = z3 - z1;
+
+    float a = b1 * c2 - b2 * c1;
+    float b = a2 * c1 - a1 * c2;
+    float c = a1 * b2 - b1 * a2;
+
+    float d = (- a * x1 - b * y1 - c * z1);
+    return glm::vec4(a,b,c,d);
+}
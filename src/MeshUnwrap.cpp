@@ -0,0 +1,293 @@
+#include "Mesh.hpp"
+#include "MeshMath.hpp"
+#include "Parallel.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+
+// ******************************************************************************************************
+// ******************************************************************************************************
+// ******************************************************************************************************
+// uv atlas : charts grown over the triangles, projected on a plane and packed in a square
+//
+// a chart grows from a seed triangle across its edges to the triangles facing less than
+// CHART_ANGLE away from the seed, and is projected along the seed normal : no triangle of a chart
+// folds over (each one faces the plane), none is stretched more than 1 / cos(CHART_ANGLE). The
+// projections are turned along their principal axis and packed on shelves at the same texel
+// density, as large as fits, with @padding texels around each one for the filtering and mipmaps.
+//
+// a vertex gets one copy per chart it is in. The levels of detail keep their vertices : a coarse
+// triangle takes the chart most of its corners are in, the corners outside of it get a copy
+// projected on it (clamped to its rectangle), close enough at the distances those levels are drawn.
+
+namespace {
+
+const std::size_t UNWRAP_GRAIN = 4096;
+const float CHART_ANGLE = 60.0f;           // degrees
+const unsigned int NONE = ~0u;
+
+struct Chart {
+    glm::vec3 t, b;            // projection axes
+    glm::vec2 low, high;       // bounds of the projection
+    glm::ivec2 origin, size;   // texels in the atlas, padding included
+};
+
+// place @charts (ordered by decreasing height) on shelves of a @size atlas at @scale texels per
+// unit, false when they don't fit
+bool pack_shelves(std::vector<Chart> & charts, const std::vector<unsigned int> & order, float scale,
+                  unsigned int size, unsigned int padding)
+{
+    int x = 0, y = 0, shelf = 0;
+    for (unsigned int c : order)
+    {
+        Chart & chart = charts[c];
+        chart.size = glm::ivec2(glm::ceil((chart.high - chart.low) * scale)) + int(2 * padding);
+        if (chart.size.x > int(size)) return false;
+        if (x + chart.size.x > int(size))
+        {
+            x = 0;
+            y += shelf;
+            shelf = 0;
+        }
+        if (y + chart.size.y > int(size)) return false;
+        chart.origin = glm::ivec2(x, y);
+        x += chart.size.x;
+        shelf = std::max(shelf, chart.size.y);
+    }
+    return true;
+}
+
+} // namespace
+
+void Mesh::unwrap_uvs(unsigned int size, unsigned int padding)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    const std::size_t numberOfTriangles = getNumberOfTriangles();
+    const std::size_t numberOfVertices = indexed_vertices.size();
+    if (numberOfTriangles == 0) return;
+    if (triangle_normals.size() != numberOfTriangles)
+        compute_triangle_normals(indexed_vertices, indices, triangle_normals, triangle_areas);
+
+    // triangle across each edge (the first one on non-manifold edges)
+    const MeshAdjacency & around = adjacency();
+    std::vector<unsigned int> across(3 * numberOfTriangles, NONE);
+    parallel_for(0, numberOfTriangles, UNWRAP_GRAIN, [&](std::size_t first, std::size_t last) {
+        for (std::size_t t = first; t < last; ++t)
+        {
+            for (unsigned int e = 0; e < 3; ++e)
+            {
+                const unsigned int a = indices[3 * t + e], b = indices[3 * t + (e + 1) % 3];
+                for (const unsigned int * c = around.corners_begin(a); c != around.corners_end(a); ++c)
+                {
+                    const unsigned int u = *c / 3;
+                    if (u == t) continue;
+                    if (indices[3 * u] == b || indices[3 * u + 1] == b || indices[3 * u + 2] == b)
+                    {
+                        across[3 * t + e] = u;
+                        break;
+                    }
+                }
+            }
+        }
+    });
+
+    // grow the charts, seeds in triangle order
+    const float minimumCosine = std::cos(glm::radians(CHART_ANGLE));
+    std::vector<unsigned int> chartOf(numberOfTriangles, NONE), stack;
+    std::vector<Chart> charts;
+    for (std::size_t seed = 0; seed < numberOfTriangles; ++seed)
+    {
+        if (chartOf[seed] != NONE) continue;
+        const glm::vec3 axis = triangle_areas[seed] > 0.0f ? triangle_normals[seed] : glm::vec3(0.0f, 0.0f, 1.0f);
+        const unsigned int chart = unsigned(charts.size());
+        Chart projection;
+        basis(axis, projection.t, projection.b);
+        charts.push_back(projection);
+
+        chartOf[seed] = chart;
+        stack.push_back(unsigned(seed));
+        while (!stack.empty())
+        {
+            const unsigned int t = stack.back();
+            stack.pop_back();
+            for (unsigned int e = 0; e < 3; ++e)
+            {
+                const unsigned int u = across[3 * t + e];
+                if (u == NONE || chartOf[u] != NONE) continue;
+                if (triangle_areas[u] > 0.0f && glm::dot(triangle_normals[u], axis) < minimumCosine) continue;
+                chartOf[u] = chart;
+                stack.push_back(u);
+            }
+        }
+    }
+    const std::size_t numberOfCharts = charts.size();
+
+    // one copy per (vertex, chart) : the full mesh first, then what the levels of detail add
+    std::vector<std::vector<unsigned int> > chartsOfVertex(numberOfVertices);
+    std::vector<unsigned int> copySource, copyChart;
+    std::unordered_map<std::uint64_t, unsigned int> copies;
+    auto copy_of = [&](unsigned int v, unsigned int chart) {
+        auto inserted = copies.emplace(std::uint64_t(v) * numberOfCharts + chart, unsigned(copySource.size()));
+        if (inserted.second)
+        {
+            copySource.push_back(v);
+            copyChart.push_back(chart);
+        }
+        return inserted.first->second;
+    };
+    for (std::size_t t = 0; t < numberOfTriangles; ++t)
+    {
+        for (unsigned int k = 0; k < 3; ++k)
+        {
+            unsigned int & v = indices[3 * t + k];
+            const std::size_t before = copySource.size();
+            unsigned int copy = copy_of(v, chartOf[t]);
+            if (copySource.size() != before) chartsOfVertex[v].push_back(chartOf[t]);
+            v = copy;
+        }
+    }
+    const std::size_t fullCopies = copySource.size();
+    for (std::size_t t = 0; t < lod_indices.size() / 3; ++t)
+    {
+        unsigned int * corners = &lod_indices[3 * t];
+        unsigned int chart = NONE, best = 0;
+        for (unsigned int k = 0; k < 3; ++k)
+        {
+            for (unsigned int candidate : chartsOfVertex[corners[k]])
+            {
+                unsigned int count = 0;
+                for (unsigned int j = 0; j < 3; ++j)
+                {
+                    const auto & list = chartsOfVertex[corners[j]];
+                    count += std::find(list.begin(), list.end(), candidate) != list.end();
+                }
+                if (count > best) { best = count; chart = candidate; }
+            }
+        }
+        if (chart == NONE) chart = 0;
+        for (unsigned int k = 0; k < 3; ++k) corners[k] = copy_of(corners[k], chart);
+    }
+    // vertices no triangle uses stay, without a chart
+    for (std::size_t v = 0; v < numberOfVertices; ++v)
+    {
+        if (chartsOfVertex[v].empty())
+        {
+            copySource.push_back(unsigned(v));
+            copyChart.push_back(NONE);
+        }
+    }
+    const std::size_t numberOfCopies = copySource.size();
+
+    // projection of every copy, then the principal axis and bounds of each chart
+    std::vector<glm::vec2> projected(numberOfCopies, glm::vec2(0.0f));
+    parallel_for(0, numberOfCopies, UNWRAP_GRAIN, [&](std::size_t first, std::size_t last) {
+        for (std::size_t k = first; k < last; ++k)
+        {
+            if (copyChart[k] == NONE) continue;
+            const Chart & chart = charts[copyChart[k]];
+            const glm::vec3 & p = indexed_vertices[copySource[k]];
+            projected[k] = glm::vec2(glm::dot(p, chart.t), glm::dot(p, chart.b));
+        }
+    });
+    std::vector<glm::vec3> moments(numberOfCharts, glm::vec3(0.0f));   // xx, yy, xy around the mean
+    std::vector<glm::vec2> means(numberOfCharts, glm::vec2(0.0f));
+    std::vector<unsigned int> counts(numberOfCharts, 0);
+    for (std::size_t k = 0; k < fullCopies; ++k)
+    {
+        means[copyChart[k]] += projected[k];
+        ++counts[copyChart[k]];
+    }
+    for (std::size_t c = 0; c < numberOfCharts; ++c) means[c] /= float(std::max(counts[c], 1u));
+    for (std::size_t k = 0; k < fullCopies; ++k)
+    {
+        glm::vec2 d = projected[k] - means[copyChart[k]];
+        moments[copyChart[k]] += glm::vec3(d.x * d.x, d.y * d.y, d.x * d.y);
+    }
+    for (std::size_t c = 0; c < numberOfCharts; ++c)
+    {
+        // turn the axes so the chart is the longest along the first one
+        const float angle = 0.5f * std::atan2(2.0f * moments[c].z, moments[c].x - moments[c].y);
+        const float cosine = std::cos(angle), sine = std::sin(angle);
+        Chart & chart = charts[c];
+        const glm::vec3 t = chart.t * cosine + chart.b * sine, b = chart.b * cosine - chart.t * sine;
+        chart.t = t;
+        chart.b = b;
+        chart.low = glm::vec2(FLT_MAX);
+        chart.high = glm::vec2(-FLT_MAX);
+    }
+    parallel_for(0, numberOfCopies, UNWRAP_GRAIN, [&](std::size_t first, std::size_t last) {
+        for (std::size_t k = first; k < last; ++k)
+        {
+            if (copyChart[k] == NONE) continue;
+            const Chart & chart = charts[copyChart[k]];
+            const glm::vec3 & p = indexed_vertices[copySource[k]];
+            projected[k] = glm::vec2(glm::dot(p, chart.t), glm::dot(p, chart.b));
+        }
+    });
+    for (std::size_t k = 0; k < fullCopies; ++k)
+    {
+        Chart & chart = charts[copyChart[k]];
+        chart.low = glm::min(chart.low, projected[k]);
+        chart.high = glm::max(chart.high, projected[k]);
+    }
+
+    // largest texel density that fits : bisection between nothing and a perfect packing
+    std::vector<unsigned int> order(numberOfCharts);
+    std::iota(order.begin(), order.end(), 0u);
+    std::sort(order.begin(), order.end(), [&charts](unsigned int a, unsigned int b) {
+        return charts[a].high.y - charts[a].low.y > charts[b].high.y - charts[b].low.y;
+    });
+    double boxes = 0.0;
+    for (const Chart & chart : charts) boxes += double(chart.high.x - chart.low.x) * double(chart.high.y - chart.low.y);
+    float low = 0.0f, high = float(size) / float(std::sqrt(std::max(boxes, 1e-12)));
+    for (int i = 0; i < 32; ++i)
+    {
+        const float scale = 0.5f * (low + high);
+        (pack_shelves(charts, order, scale, size, padding) ? low : high) = scale;
+    }
+    const float scale = low;
+    pack_shelves(charts, order, scale, size, padding);
+
+    // copies of the attributes, the uvs in the atlas
+    auto duplicate = [&](auto & attribute) {
+        if (attribute.size() != numberOfVertices) return;
+        typename std::decay<decltype(attribute)>::type copied(numberOfCopies);
+        for (std::size_t k = 0; k < numberOfCopies; ++k) copied[k] = attribute[copySource[k]];
+        attribute.swap(copied);
+    };
+    duplicate(indexed_vertices);
+    duplicate(indexed_normals);
+    duplicate(valence_field);
+    duplicate(vertex_thickness);
+    duplicate(vertex_occlusion);
+    indexed_uvs.assign(numberOfCopies, glm::vec2(0.0f));
+    parallel_for(0, numberOfCopies, UNWRAP_GRAIN, [&](std::size_t first, std::size_t last) {
+        for (std::size_t k = first; k < last; ++k)
+        {
+            if (copyChart[k] == NONE) continue;
+            const Chart & chart = charts[copyChart[k]];
+            glm::vec2 texel = glm::vec2(chart.origin) + float(padding) + (projected[k] - chart.low) * scale;
+            // copies of the levels of detail may fall out of the chart
+            texel = glm::clamp(texel, glm::vec2(chart.origin), glm::vec2(chart.origin + chart.size));
+            indexed_uvs[k] = texel / float(size);
+        }
+    });
+    atlas_size = size;
+
+    invalidate_bvh();
+    optimize_vertex_fetch();
+
+    double covered = 0.0;
+    for (std::size_t t = 0; t < numberOfTriangles; ++t)
+    {
+        const glm::vec2 a = indexed_uvs[indices[3 * t]], b = indexed_uvs[indices[3 * t + 1]], c = indexed_uvs[indices[3 * t + 2]];
+        covered += 0.5 * std::abs(double(b.x - a.x) * (c.y - a.y) - double(b.y - a.y) * (c.x - a.x));
+    }
+    auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "UV atlas : " << numberOfCharts << " charts in " << size << "x" << size << " texels ("
+              << 100.0 * covered << "% covered), " << numberOfVertices << " -> "
+              << numberOfCopies << " vertices in " << ms << " ms" << std::endl;
+}
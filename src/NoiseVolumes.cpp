@@ -0,0 +1,140 @@
+#include "NoiseVolumes.hpp"
+#include "Parallel.hpp"
+#include "SkinNoise.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+// ******************************************************************************************************
+// ******************************************************************************************************
+// ******************************************************************************************************
+// bake
+NoiseVolumes::Texels NoiseVolumes::compute(int size)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    Texels texels;
+    texels.size = size;
+    const std::size_t slice = std::size_t(size) * size;
+    texels.fbm.resize(slice * size);
+    texels.simplex.resize(slice * size);
+
+    // one z slice per task, texels sample the center of their cell
+    parallel_for(0, std::size_t(size), 1, [&](std::size_t first, std::size_t last) {
+        std::vector<glm::vec3> points(slice), shifted(slice);
+        std::vector<float> values(slice), sum(slice), weights(slice);
+        for (std::size_t z = first; z < last; ++z)
+        {
+            // FBM : tileable by construction
+            for (std::size_t i = 0; i < slice; ++i)
+            {
+                glm::vec3 cell(float(i % size), float(i / size), float(z));
+                points[i] = (cell + 0.5f) / float(size) * FBM_TILE;
+            }
+            SkinNoise::fbmTiled(points.data(), slice, values.data(), FBM_TILE);
+            for (std::size_t i = 0; i < slice; ++i)
+            {
+                float v = std::min(std::max(values[i], 0.0f), 1.0f);
+                texels.fbm[z * slice + i] = std::uint8_t(std::lround(v * 255.0f));
+            }
+
+            // snoise : the copies shifted by a tile along each axis blended, the weight of a copy
+            // goes to 1 on the side it continues
+            std::fill(sum.begin(), sum.end(), 0.0f);
+            std::fill(weights.begin(), weights.end(), 0.0f);
+            for (int corner = 0; corner < 8; ++corner)
+            {
+                const glm::vec3 shift(float(corner & 1), float((corner >> 1) & 1), float((corner >> 2) & 1));
+                for (std::size_t i = 0; i < slice; ++i)
+                {
+                    glm::vec3 cell(float(i % size), float(i / size), float(z));
+                    points[i] = (cell + 0.5f) / float(size);
+                    shifted[i] = (points[i] - shift) * SIMPLEX_TILE;
+                }
+                SkinNoise::simplex3D(shifted.data(), slice, values.data());
+                for (std::size_t i = 0; i < slice; ++i)
+                {
+                    glm::vec3 w = glm::mix(1.0f - points[i], points[i], shift);
+                    float weight = w.x * w.y * w.z;
+                    sum[i] += weight * values[i];
+                    weights[i] += weight * weight;
+                }
+            }
+            for (std::size_t i = 0; i < slice; ++i)
+            {
+                float v = std::min(std::max(sum[i] / std::sqrt(weights[i]), -1.0f), 1.0f);
+                texels.simplex[z * slice + i] = std::int8_t(std::lround(v * 127.0f));
+            }
+        }
+    });
+
+    texels.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return texels;
+}
+
+void NoiseVolumes::bake(int textureSize)
+{
+    if (pending.valid()) pending.wait();
+    pending = std::async(std::launch::async, &NoiseVolumes::compute, textureSize);
+}
+
+// ******************************************************************************************************
+// ******************************************************************************************************
+// ******************************************************************************************************
+// textures
+bool NoiseVolumes::update()
+{
+    if (!pending.valid() || pending.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return ready();
+
+    Texels texels = pending.get();
+    destroy();
+    size = texels.size;
+    milliseconds = texels.milliseconds;
+
+    auto upload = [this](GLuint & texture, GLenum internalFormat, GLenum type, const void * data) {
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_3D, texture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage3D(GL_TEXTURE_3D, 0, internalFormat, size, size, size, 0, GL_RED, type, data);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glGenerateMipmap(GL_TEXTURE_3D);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_REPEAT);
+    };
+    upload(fbmTexture, GL_R8, GL_UNSIGNED_BYTE, texels.fbm.data());
+    upload(simplexTexture, GL_R8_SNORM, GL_BYTE, texels.simplex.data());
+    glBindTexture(GL_TEXTURE_3D, 0);
+
+    std::cout << "Noise volumes : 2 x " << size << "^3 texels baked in " << milliseconds << " ms on "
+              << worker_count() << " threads (" << SkinNoise::pathName(SkinNoise::path()) << ")" << std::endl;
+    return true;
+}
+
+void NoiseVolumes::bind() const
+{
+    glActiveTexture(GL_TEXTURE0 + FBM_UNIT);
+    glBindTexture(GL_TEXTURE_3D, fbmTexture);
+    glActiveTexture(GL_TEXTURE0 + SIMPLEX_UNIT);
+    glBindTexture(GL_TEXTURE_3D, simplexTexture);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void NoiseVolumes::destroy()
+{
+    if (fbmTexture != 0) glDeleteTextures(1, &fbmTexture);
+    if (simplexTexture != 0) glDeleteTextures(1, &simplexTexture);
+    fbmTexture = simplexTexture = 0;
+}
+
+std::size_t NoiseVolumes::getGpuBytes() const
+{
+    if (!ready()) return 0;
+    // 1 byte per texel, the mipmaps add 1/7
+    std::size_t texels = std::size_t(size) * size * size;
+    return 2 * (texels + texels / 7);
+}
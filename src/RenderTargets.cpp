@@ -0,0 +1,96 @@
+#include "RenderTargets.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// ******************************************************************************************************
+// ******************************************************************************************************
+// ******************************************************************************************************
+// allocation
+bool RenderTargets::resize(int newWidth, int newHeight)
+{
+    if (newWidth <= 0 || newHeight <= 0 || (newWidth == width && newHeight == height)) return false;
+    width = newWidth;
+    height = newHeight;
+
+    if (framebuffer == 0)
+    {
+        glGenFramebuffers(1, &framebuffer);
+        glGenTextures(1, &color);
+        glGenTextures(1, &mask);
+        glGenTextures(1, &depth);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    // scene colour and light mask
+    for (GLuint texture : {color, mask})
+    {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, mask, 0);
+    GLenum attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, attachments);
+
+    // depth and stencil (a texture : the god rays upsampling reads it)
+    glBindTexture(GL_TEXTURE_2D, depth);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, width, height, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "Framebuffer not complete!" << std::endl;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    updateRenderSize();
+    std::cout << "Render targets : " << width << "x" << height << std::endl;
+    return true;
+}
+
+// ******************************************************************************************************
+// ******************************************************************************************************
+// ******************************************************************************************************
+// render scale
+void RenderTargets::setRenderScale(float scale)
+{
+    renderScale = glm::clamp(scale, 0.01f, 1.0f);
+    updateRenderSize();
+}
+
+void RenderTargets::updateRenderSize()
+{
+    renderWidth = std::max(1, std::min(width, int(std::lround(float(width) * renderScale))));
+    renderHeight = std::max(1, std::min(height, int(std::lround(float(height) * renderScale))));
+}
+
+glm::vec2 RenderTargets::getUvScale() const
+{
+    if (width == 0 || height == 0) return glm::vec2(1.0f);
+    return glm::vec2(float(renderWidth) / float(width), float(renderHeight) / float(height));
+}
+
+void RenderTargets::bind() const
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, renderWidth, renderHeight);
+}
+
+void RenderTargets::destroy()
+{
+    if (framebuffer != 0)
+    {
+        glDeleteFramebuffers(1, &framebuffer);
+        GLuint textures[3] = {color, mask, depth};
+        glDeleteTextures(3, textures);
+    }
+    framebuffer = color = mask = depth = 0;
+    width = height = renderWidth = renderHeight = 0;
+}
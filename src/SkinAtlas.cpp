@@ -0,0 +1,305 @@
+#include "SkinAtlas.hpp"
+#include "Parallel.hpp"
+#include "SkinNoise.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+// ******************************************************************************************************
+// ******************************************************************************************************
+// ******************************************************************************************************
+// bake
+//
+// the atlas is cut in bands of rows, a thread rasterizes every triangle crossing its band (texel
+// centers inside the triangle, the first triangle wins) then evaluates the noise of the texels in
+// batches. The gutters around the charts take the colour of their closest texels so the filtering
+// and the first mipmaps don't bring in the background.
+
+namespace {
+
+const int BAND_ROWS = 16;
+const int DILATE_PASSES = 4;     // the padding of Mesh::unwrap_uvs
+
+// the constants of fragment_shader.glsl
+const float subsurface_scale = 1.1f;
+const float subsurface_frequency = 2.2f;
+const float skin_frequency = 50.0f;
+const float base_skin_amt = 0.98f;
+const glm::vec3 subsurface_color(0.639f, 0.058f, 0.0f);
+const glm::vec3 surface_col(1.0f, 1.0f, 1.0f);
+
+// colour of the skin at the world positions @fragPos : rgb the part without the object colour,
+// a the weight of the object colour (see SkinAtlas.hpp)
+void skin_colour(const std::vector<glm::vec3> & fragPos, const SkinAtlasParameters & parameters,
+                 std::vector<glm::vec4> & out)
+{
+    const std::size_t count = fragPos.size();
+    std::vector<glm::vec3> points(count);
+    std::vector<float> subsurfaceDistance(count), skinValue(count), freckDistance(count, 1.0f);
+
+    for (std::size_t i = 0; i < count; ++i) points[i] = fragPos[i] * 10.0f * subsurface_frequency;
+    SkinNoise::simplex3D(points.data(), count, subsurfaceDistance.data());
+    for (std::size_t i = 0; i < count; ++i) points[i] = fragPos[i] * 10.0f * skin_frequency;
+    SkinNoise::simplex3D(points.data(), count, skinValue.data());
+
+    const bool freckles = parameters.freckleScale > 0.0f;
+    if (freckles)
+    {
+        std::vector<glm::vec2> freckPoints(count);
+        for (std::size_t i = 0; i < count; ++i)
+            freckPoints[i] = glm::vec2(fragPos[i].z, fragPos[i].y) / fragPos[i].x * parameters.freckleFrequency;
+        SkinNoise::simplex2D(freckPoints.data(), count, freckDistance.data());
+    }
+
+    out.resize(count);
+    const float subsurface_radius = subsurface_scale / 2.0f;
+    const float freck_radius = parameters.freckleScale / 2.0f;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        float subsurface = 1.0f - std::min(1.0f, subsurfaceDistance[i] / subsurface_radius);
+        float skin = skinValue[i] / 42.0f;
+        float freck = freckles ? 1.0f - std::min(1.0f, (0.5f + 0.5f * freckDistance[i]) / freck_radius) : 0.0f;
+
+        // col = mix(mix(mix(subsurface_color * subsurface, SkinColor, base_skin_amt), surface_col, skin), freck_col, freck)
+        glm::vec3 rest = subsurface_color * subsurface * (1.0f - base_skin_amt);
+        rest = (rest * (1.0f - skin) + surface_col * skin) * (1.0f - freck) + parameters.freckleColor * freck;
+        out[i] = glm::vec4(rest, base_skin_amt * (1.0f - skin) * (1.0f - freck));
+    }
+}
+
+} // namespace
+
+SkinAtlas::Texels SkinAtlas::compute(std::shared_ptr<const Mesh> mesh, SkinAtlasParameters parameters)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    Texels texels;
+    const int size = int(mesh->atlas_size);
+    texels.size = size;
+    if (size == 0) return texels;
+    const std::size_t numberOfTexels = std::size_t(size) * size;
+    const std::vector<unsigned int> & indices = mesh->indices;
+    const std::vector<glm::vec2> & uvs = mesh->indexed_uvs;
+    const std::vector<glm::vec3> & positions = mesh->indexed_vertices;
+
+    // triangles crossing each band
+    const int bands = (size + BAND_ROWS - 1) / BAND_ROWS;
+    std::vector<std::vector<unsigned int> > bandTriangles(bands);
+    for (std::size_t t = 0; t < indices.size() / 3; ++t)
+    {
+        float low = FLT_MAX, high = -FLT_MAX;
+        for (unsigned int k = 0; k < 3; ++k)
+        {
+            low = std::min(low, uvs[indices[3 * t + k]].y * size);
+            high = std::max(high, uvs[indices[3 * t + k]].y * size);
+        }
+        int first = std::max(0, int(std::ceil(low - 0.5f))), last = std::min(size - 1, int(std::floor(high - 0.5f)));
+        for (int band = first / BAND_ROWS; first <= last && band <= last / BAND_ROWS; ++band)
+            bandTriangles[band].push_back(unsigned(t));
+    }
+
+    std::vector<glm::vec4> colours(numberOfTexels, glm::vec4(0.0f));
+    std::vector<std::uint8_t> inside(numberOfTexels, 0);
+    parallel_for_stealing(0, std::size_t(bands), 1, [&](std::size_t firstBand, std::size_t lastBand) {
+        std::vector<std::size_t> covered;
+        std::vector<glm::vec3> fragPos;
+        std::vector<glm::vec4> values;
+        for (std::size_t band = firstBand; band < lastBand; ++band)
+        {
+            const int rowBegin = int(band) * BAND_ROWS, rowEnd = std::min(size, rowBegin + BAND_ROWS);
+            covered.clear();
+            fragPos.clear();
+            for (unsigned int t : bandTriangles[band])
+            {
+                const glm::vec2 a = uvs[indices[3 * t]] * float(size), b = uvs[indices[3 * t + 1]] * float(size),
+                                c = uvs[indices[3 * t + 2]] * float(size);
+                const float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+                if (area == 0.0f) continue;
+                const glm::vec3 pa = glm::vec3(parameters.model * glm::vec4(positions[indices[3 * t]], 1.0f));
+                const glm::vec3 pb = glm::vec3(parameters.model * glm::vec4(positions[indices[3 * t + 1]], 1.0f));
+                const glm::vec3 pc = glm::vec3(parameters.model * glm::vec4(positions[indices[3 * t + 2]], 1.0f));
+
+                const glm::vec2 low = glm::min(a, glm::min(b, c)), high = glm::max(a, glm::max(b, c));
+                const int x0 = std::max(0, int(std::ceil(low.x - 0.5f))), x1 = std::min(size - 1, int(std::floor(high.x - 0.5f)));
+                const int y0 = std::max(rowBegin, int(std::ceil(low.y - 0.5f))), y1 = std::min(rowEnd - 1, int(std::floor(high.y - 0.5f)));
+                for (int y = y0; y <= y1; ++y)
+                {
+                    for (int x = x0; x <= x1; ++x)
+                    {
+                        const glm::vec2 p(float(x) + 0.5f, float(y) + 0.5f);
+                        const float wa = ((b.x - p.x) * (c.y - p.y) - (b.y - p.y) * (c.x - p.x)) / area;
+                        const float wb = ((c.x - p.x) * (a.y - p.y) - (c.y - p.y) * (a.x - p.x)) / area;
+                        const float wc = 1.0f - wa - wb;
+                        const std::size_t texel = std::size_t(y) * size + x;
+                        if (wa < -1e-5f || wb < -1e-5f || wc < -1e-5f || inside[texel]) continue;
+                        inside[texel] = 1;
+                        covered.push_back(texel);
+                        fragPos.push_back(pa * wa + pb * wb + pc * wc);
+                    }
+                }
+            }
+            skin_colour(fragPos, parameters, values);
+            for (std::size_t i = 0; i < covered.size(); ++i) colours[covered[i]] = values[i];
+        }
+    });
+
+    // gutters : average of the filled neighbours, one ring per pass, the rest is the mean colour
+    std::vector<glm::vec4> nextColours(colours);
+    std::vector<std::uint8_t> filled(inside), nextFilled(inside);
+    for (int pass = 0; pass < DILATE_PASSES; ++pass)
+    {
+        parallel_for(0, std::size_t(size), BAND_ROWS, [&](std::size_t firstRow, std::size_t lastRow) {
+            for (std::size_t y = firstRow; y < lastRow; ++y)
+            {
+                for (int x = 0; x < size; ++x)
+                {
+                    const std::size_t texel = y * size + x;
+                    if (filled[texel]) continue;
+                    glm::vec4 sum(0.0f);
+                    int count = 0;
+                    for (int dy = -1; dy <= 1; ++dy)
+                    {
+                        for (int dx = -1; dx <= 1; ++dx)
+                        {
+                            const int nx = x + dx, ny = int(y) + dy;
+                            if (nx < 0 || ny < 0 || nx >= size || ny >= size) continue;
+                            const std::size_t neighbour = std::size_t(ny) * size + nx;
+                            if (filled[neighbour]) { sum += colours[neighbour]; ++count; }
+                        }
+                    }
+                    if (count > 0)
+                    {
+                        nextColours[texel] = sum / float(count);
+                        nextFilled[texel] = 1;
+                    }
+                }
+            }
+        });
+        colours = nextColours;
+        filled = nextFilled;
+    }
+    glm::dvec4 mean(0.0);
+    std::size_t numberOfCovered = 0;
+    for (std::size_t texel = 0; texel < numberOfTexels; ++texel)
+    {
+        if (!inside[texel]) continue;
+        mean += glm::dvec4(colours[texel]);
+        ++numberOfCovered;
+    }
+    const glm::vec4 background = numberOfCovered > 0 ? glm::vec4(mean / double(numberOfCovered)) : glm::vec4(0.0f);
+
+    texels.rgba.resize(4 * numberOfTexels);
+    parallel_for(0, numberOfTexels, std::size_t(BAND_ROWS) * size, [&](std::size_t first, std::size_t last) {
+        for (std::size_t texel = first; texel < last; ++texel)
+        {
+            const glm::vec4 colour = filled[texel] ? colours[texel] : background;
+            const glm::vec3 rgb = (glm::vec3(colour) - COLOR_LOW) / (COLOR_HIGH - COLOR_LOW);
+            texels.rgba[4 * texel + 0] = std::uint8_t(std::lround(glm::clamp(rgb.r, 0.0f, 1.0f) * 255.0f));
+            texels.rgba[4 * texel + 1] = std::uint8_t(std::lround(glm::clamp(rgb.g, 0.0f, 1.0f) * 255.0f));
+            texels.rgba[4 * texel + 2] = std::uint8_t(std::lround(glm::clamp(rgb.b, 0.0f, 1.0f) * 255.0f));
+            texels.rgba[4 * texel + 3] = std::uint8_t(std::lround(glm::clamp(colour.a, 0.0f, 1.0f) * 255.0f));
+        }
+    });
+
+    texels.covered = numberOfCovered;
+    texels.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return texels;
+}
+
+void SkinAtlas::start(const std::shared_ptr<const Mesh> & mesh, const SkinAtlasParameters & parameters, std::uint64_t version)
+{
+    pendingMesh = mesh;
+    pendingVersion = version;
+    pending = std::async(std::launch::async, &SkinAtlas::compute, mesh, parameters);
+}
+
+void SkinAtlas::request(const std::shared_ptr<const Mesh> & mesh, const SkinAtlasParameters & parameters,
+                        std::uint64_t version)
+{
+    if (pending.valid())
+    {
+        // bake these parameters next, unless they are the ones being baked
+        if (mesh == pendingMesh && version == pendingVersion) queuedMesh.reset();
+        else
+        {
+            queuedMesh = mesh;
+            queuedParameters = parameters;
+            queuedVersion = version;
+        }
+        return;
+    }
+    if (!current(mesh, version)) start(mesh, parameters, version);
+}
+
+// ******************************************************************************************************
+// ******************************************************************************************************
+// ******************************************************************************************************
+// texture
+bool SkinAtlas::update()
+{
+    if (pending.valid() && pending.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+    {
+        Texels texels = pending.get();
+        if (texels.size > 0)
+        {
+            if (texture == 0 || texels.size != size)
+            {
+                destroy();
+                size = texels.size;
+                glGenTextures(1, &texture);
+                glBindTexture(GL_TEXTURE_2D, texture);
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, texels.rgba.data());
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            }
+            else
+            {
+                // same size : refill the storage
+                glBindTexture(GL_TEXTURE_2D, texture);
+                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size, size, GL_RGBA, GL_UNSIGNED_BYTE, texels.rgba.data());
+            }
+            glGenerateMipmap(GL_TEXTURE_2D);
+            glBindTexture(GL_TEXTURE_2D, 0);
+
+            bakedMesh = pendingMesh;
+            bakedVersion = pendingVersion;
+            covered = texels.covered;
+            milliseconds = texels.milliseconds;
+            std::cout << "Skin atlas : " << size << "x" << size << " (" << covered << " texels covered) baked in "
+                      << milliseconds << " ms on " << worker_count() << " threads" << std::endl;
+        }
+        pendingMesh.reset();
+    }
+    if (!pending.valid() && queuedMesh)
+    {
+        std::shared_ptr<const Mesh> mesh = std::move(queuedMesh);
+        queuedMesh.reset();
+        if (!current(mesh, queuedVersion)) start(mesh, queuedParameters, queuedVersion);
+    }
+    return ready();
+}
+
+void SkinAtlas::bind() const
+{
+    glActiveTexture(GL_TEXTURE0 + UNIT);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void SkinAtlas::destroy()
+{
+    if (texture != 0) glDeleteTextures(1, &texture);
+    texture = 0;
+    bakedMesh.reset();
+}
+
+std::size_t SkinAtlas::getGpuBytes() const
+{
+    if (!ready()) return 0;
+    // 4 bytes per texel, the mipmaps add 1/3
+    std::size_t texels = std::size_t(size) * size;
+    return 4 * (texels + texels / 3);
+}
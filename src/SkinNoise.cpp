@@ -0,0 +1,358 @@
+#include "SkinNoise.hpp"
+#include "SkinNoiseKernels.hpp"
+
+#include <chrono>
+#include <random>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+    #include <emmintrin.h>
+    #define SKIN_NOISE_SSE2
+#endif
+
+namespace {
+
+#if defined(SKIN_NOISE_SSE2)
+// 4 lanes
+struct SSELanes {
+    __m128 v;
+
+    static const int width = 4;
+    SSELanes() = default;
+    SSELanes(__m128 x) : v(x) {}
+    SSELanes(float x) : v(_mm_set1_ps(x)) {}
+    static SSELanes load(const float * p) { return _mm_load_ps(p); }
+    static void store(float * p, SSELanes x) { _mm_store_ps(p, x.v); }
+};
+inline SSELanes operator+(SSELanes a, SSELanes b) { return _mm_add_ps(a.v, b.v); }
+inline SSELanes operator-(SSELanes a, SSELanes b) { return _mm_sub_ps(a.v, b.v); }
+inline SSELanes operator*(SSELanes a, SSELanes b) { return _mm_mul_ps(a.v, b.v); }
+inline SSELanes operator/(SSELanes a, SSELanes b) { return _mm_div_ps(a.v, b.v); }
+inline SSELanes vmin(SSELanes a, SSELanes b) { return _mm_min_ps(a.v, b.v); }
+inline SSELanes vmax(SSELanes a, SSELanes b) { return _mm_max_ps(a.v, b.v); }
+inline SSELanes vabs(SSELanes x) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), x.v); }
+inline SSELanes vstep(SSELanes edge, SSELanes x) { return _mm_and_ps(_mm_cmpnlt_ps(x.v, edge.v), _mm_set1_ps(1.0f)); }
+
+// SSE2 has no floor : truncate and step down the negative values that moved up (|x| < 2^31)
+inline SSELanes vfloor(SSELanes x)
+{
+    __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(x.v));
+    return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, x.v), _mm_set1_ps(1.0f)));
+}
+
+__m128d sin_pd(__m128d x)
+{
+    // k = round(x 2 / pi), odd quadrants take the cosine, k & 2 flips the sign
+    __m128i k = _mm_cvtpd_epi32(_mm_mul_pd(x, _mm_set1_pd(TWO_OVER_PI)));
+    __m128d kd = _mm_cvtepi32_pd(k);
+    __m128d r = _mm_sub_pd(x, _mm_mul_pd(kd, _mm_set1_pd(PI_OVER_2[0])));
+    r = _mm_sub_pd(r, _mm_mul_pd(kd, _mm_set1_pd(PI_OVER_2[1])));
+    r = _mm_sub_pd(r, _mm_mul_pd(kd, _mm_set1_pd(PI_OVER_2[2])));
+    __m128d z = _mm_mul_pd(r, r);
+
+    __m128d s = _mm_set1_pd(SIN_KERNEL[5]), c = _mm_set1_pd(COS_KERNEL[5]);
+    for (int i = 4; i >= 0; --i)
+    {
+        s = _mm_add_pd(_mm_mul_pd(s, z), _mm_set1_pd(SIN_KERNEL[i]));
+        c = _mm_add_pd(_mm_mul_pd(c, z), _mm_set1_pd(COS_KERNEL[i]));
+    }
+    s = _mm_add_pd(r, _mm_mul_pd(_mm_mul_pd(r, z), s));
+    c = _mm_add_pd(_mm_sub_pd(_mm_set1_pd(1.0), _mm_mul_pd(_mm_set1_pd(0.5), z)), _mm_mul_pd(_mm_mul_pd(z, z), c));
+
+    __m128i q = _mm_shuffle_epi32(k, _MM_SHUFFLE(1, 1, 0, 0)); // k of each lane in its low 32 bits
+    __m128d odd = _mm_castsi128_pd(_mm_cmpeq_epi32(_mm_and_si128(q, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+    __m128d value = _mm_or_pd(_mm_and_pd(odd, c), _mm_andnot_pd(odd, s));
+    __m128d sign = _mm_castsi128_pd(_mm_slli_epi64(_mm_and_si128(q, _mm_set1_epi32(2)), 62));
+    return _mm_xor_pd(value, sign);
+}
+
+inline SSELanes vsin(SSELanes x)
+{
+    __m128d low = _mm_cvtps_pd(x.v), high = _mm_cvtps_pd(_mm_movehl_ps(x.v, x.v));
+    return _mm_movelh_ps(_mm_cvtpd_ps(sin_pd(low)), _mm_cvtpd_ps(sin_pd(high)));
+}
+#endif
+
+// batches of every path and the one in use
+struct Paths {
+    SkinNoiseBatch batches[3];
+    bool available[3] = {true, false, false};
+    SkinNoisePath current = NOISE_SCALAR;
+
+    Paths()
+    {
+        batches[NOISE_SCALAR] = make_batch<ScalarLanes>();
+        batches[NOISE_SSE2] = batches[NOISE_AVX2] = batches[NOISE_SCALAR];
+#if defined(SKIN_NOISE_SSE2)
+        batches[NOISE_SSE2] = make_batch<SSELanes>();
+        available[NOISE_SSE2] = true;
+        current = NOISE_SSE2;
+#endif
+        if (make_avx2_batch(batches[NOISE_AVX2]))
+        {
+            available[NOISE_AVX2] = true;
+            current = NOISE_AVX2;
+        }
+    }
+};
+
+Paths & paths()
+{
+    static Paths instance;
+    return instance;
+}
+
+const SkinNoiseBatch & batch()
+{
+    Paths & p = paths();
+    return p.batches[p.current];
+}
+
+} // namespace
+
+// ******************************************************************************************************
+// ******************************************************************************************************
+// ******************************************************************************************************
+// functions
+float SkinNoise::noise3D(const glm::vec3 & p)
+{
+    return noise3(ScalarLanes(p.x), ScalarLanes(p.y), ScalarLanes(p.z)).v;
+}
+
+float SkinNoise::fbm(const glm::vec3 & p, int octaves)
+{
+    return fbm3(ScalarLanes(p.x), ScalarLanes(p.y), ScalarLanes(p.z), octaves).v;
+}
+
+float SkinNoise::simplex3D(const glm::vec3 & p)
+{
+    return simplex3(ScalarLanes(p.x), ScalarLanes(p.y), ScalarLanes(p.z)).v;
+}
+
+float SkinNoise::simplex2D(const glm::vec2 & p)
+{
+    return simplex2(ScalarLanes(p.x), ScalarLanes(p.y)).v;
+}
+
+void SkinNoise::noise3D(const glm::vec3 * points, std::size_t count, float * out)
+{
+    batch().noise3D(points, count, out);
+}
+
+void SkinNoise::fbm(const glm::vec3 * points, std::size_t count, float * out, int octaves)
+{
+    batch().fbm(points, count, out, octaves);
+}
+
+void SkinNoise::fbmTiled(const glm::vec3 * points, std::size_t count, float * out, float tile, int octaves)
+{
+    batch().fbmTiled(points, count, out, tile, octaves);
+}
+
+void SkinNoise::simplex3D(const glm::vec3 * points, std::size_t count, float * out)
+{
+    batch().simplex3D(points, count, out);
+}
+
+void SkinNoise::simplex2D(const glm::vec2 * points, std::size_t count, float * out)
+{
+    batch().simplex2D(points, count, out);
+}
+
+// ******************************************************************************************************
+// ******************************************************************************************************
+// ******************************************************************************************************
+// paths
+SkinNoisePath SkinNoise::path()
+{
+    return paths().current;
+}
+
+const char * SkinNoise::pathName(SkinNoisePath path)
+{
+    switch (path)
+    {
+        case NOISE_SSE2: return "SSE2";
+        case NOISE_AVX2: return "AVX2";
+        default: return "scalar";
+    }
+}
+
+void SkinNoise::setPath(SkinNoisePath path)
+{
+    Paths & p = paths();
+    while (!p.available[path]) path = SkinNoisePath(path - 1);
+    p.current = path;
+}
+
+// ******************************************************************************************************
+// ******************************************************************************************************
+// ******************************************************************************************************
+// conformance and benchmark
+namespace {
+
+// every function on the same points
+struct NoiseValues {
+    std::vector<float> noise3D, fbm, simplex3D, simplex2D;
+
+    void evaluate(const SkinNoiseBatch & batch, const std::vector<glm::vec3> & points, const std::vector<glm::vec2> & points2D)
+    {
+        noise3D.resize(points.size()); fbm.resize(points.size()); simplex3D.resize(points.size());
+        simplex2D.resize(points2D.size());
+        batch.noise3D(points.data(), points.size(), noise3D.data());
+        batch.fbm(points.data(), points.size(), fbm.data(), 6);
+        batch.simplex3D(points.data(), points.size(), simplex3D.data());
+        batch.simplex2D(points2D.data(), points2D.size(), simplex2D.data());
+    }
+};
+
+// reference values at a few points : the GLSL source compiled as C++ over glm, in float with a
+// correctly rounded sin
+struct Reference {
+    glm::vec3 p;
+    float noise3D, fbm, simplex3D, simplex2D; // simplex2D at p.xy
+};
+const Reference REFERENCES[] = {
+    {{0.25f, 0.5f, 0.75f}, 0.425529063f, 0.0535516553f, -0.26721549f, -0.0829799026f},
+    {{1.3f, -2.7f, 4.1f}, 0.445960969f, 0.142320976f, 0.112952709f, -0.698246837f},
+    {{-12.5f, 33.25f, 7.75f}, 0.677358627f, 0.41558364f, -0.126944274f, -0.13491258f},
+    {{24.2f, 5.5f, -17.3f}, 0.478576899f, 0.652577043f, 0.34980768f, -0.0273932647f},
+    {{123.4f, -56.7f, 89.1f}, 0.682161689f, 0.502345741f, 0.186906025f, -0.129305691f},
+    {{-512.3f, 271.8f, -999.9f}, 0.0697467029f, 0.691394627f, -0.205869436f, 0.130402148f},
+};
+
+float largest_difference(const std::vector<float> & a, const std::vector<float> & b)
+{
+    float largest = 0.0f;
+    for (std::size_t i = 0; i < a.size(); ++i) largest = std::max(largest, std::abs(a[i] - b[i]));
+    return largest;
+}
+
+} // namespace
+
+bool SkinNoise::conformance(std::ostream & out)
+{
+    const float tolerance = 1e-5f;
+    Paths & p = paths();
+
+    std::vector<glm::vec3> points;
+    std::vector<glm::vec2> points2D;
+    for (const Reference & reference : REFERENCES)
+    {
+        points.push_back(reference.p);
+        points2D.push_back(glm::vec2(reference.p));
+    }
+    const std::size_t numberOfReferences = points.size();
+
+    // random points over the range the shader uses (FragPos * 10 * frequency)
+    std::mt19937 generator(1234);
+    std::uniform_real_distribution<float> coordinate(-1000.0f, 1000.0f);
+    for (int i = 0; i < 4096; ++i)
+    {
+        points.push_back(glm::vec3(coordinate(generator), coordinate(generator), coordinate(generator)));
+        points2D.push_back(glm::vec2(points.back()));
+    }
+
+    NoiseValues scalar;
+    scalar.evaluate(p.batches[NOISE_SCALAR], points, points2D);
+
+    bool passed = true;
+    out << "Skin noise conformance (tolerance " << tolerance << ") :" << std::endl;
+    for (int path = NOISE_SCALAR; path <= NOISE_AVX2; ++path)
+    {
+        if (!p.available[path])
+        {
+            out << "  " << pathName(SkinNoisePath(path)) << " : not available" << std::endl;
+            continue;
+        }
+        NoiseValues values;
+        values.evaluate(p.batches[path], points, points2D);
+
+        // against the references
+        float referenceError = 0.0f;
+        for (std::size_t i = 0; i < numberOfReferences; ++i)
+        {
+            const Reference & reference = REFERENCES[i];
+            referenceError = std::max({referenceError, std::abs(values.noise3D[i] - reference.noise3D),
+                                       std::abs(values.fbm[i] - reference.fbm), std::abs(values.simplex3D[i] - reference.simplex3D),
+                                       std::abs(values.simplex2D[i] - reference.simplex2D)});
+        }
+
+        // against the scalar path
+        float noiseError = largest_difference(values.noise3D, scalar.noise3D);
+        float fbmError = largest_difference(values.fbm, scalar.fbm);
+        float simplex3DError = largest_difference(values.simplex3D, scalar.simplex3D);
+        float simplex2DError = largest_difference(values.simplex2D, scalar.simplex2D);
+        bool ok = std::max({referenceError, noiseError, fbmError, simplex3DError, simplex2DError}) <= tolerance;
+        passed = passed && ok;
+
+        out << "  " << pathName(SkinNoisePath(path)) << " : references " << referenceError << ", against scalar on "
+            << points.size() << " points : Noise3D " << noiseError << ", FBM " << fbmError << ", snoise "
+            << simplex3DError << ", noise " << simplex2DError << (ok ? " ok" : " FAILED") << std::endl;
+    }
+
+    // tiled FBM : the plain one inside the tile (away from the last cell of the coarsest octave)
+    // and the same one tile further
+    const float tile = 50.0f;
+    std::uniform_real_distribution<float> inside(0.0f, 0.8f * tile);
+    std::vector<glm::vec3> tilePoints(1024), nextTile(1024);
+    for (std::size_t i = 0; i < tilePoints.size(); ++i)
+    {
+        tilePoints[i] = glm::vec3(inside(generator), inside(generator), inside(generator));
+        nextTile[i] = tilePoints[i] + glm::vec3(tile, -tile, 2.0f * tile);
+    }
+    std::vector<float> plain(tilePoints.size()), tiled(tilePoints.size()), repeated(tilePoints.size());
+    fbm(tilePoints.data(), tilePoints.size(), plain.data());
+    fbmTiled(tilePoints.data(), tilePoints.size(), tiled.data(), tile);
+    fbmTiled(nextTile.data(), nextTile.size(), repeated.data(), tile);
+    float insideError = largest_difference(tiled, plain), repeatError = largest_difference(tiled, repeated);
+    // one tile further the coordinates round differently : looser tolerance
+    bool tiledOk = insideError <= tolerance && repeatError <= 1e-3f;
+    passed = passed && tiledOk;
+    out << "  tiled FBM : against FBM " << insideError << ", one tile further " << repeatError
+        << (tiledOk ? " ok" : " FAILED") << std::endl;
+    return passed;
+}
+
+void SkinNoise::benchmark(std::ostream & out)
+{
+    Paths & p = paths();
+    const std::size_t numberOfPoints = 1 << 16;
+    std::mt19937 generator(5678);
+    std::uniform_real_distribution<float> coordinate(-1000.0f, 1000.0f);
+    std::vector<glm::vec3> points(numberOfPoints);
+    std::vector<glm::vec2> points2D(numberOfPoints);
+    for (std::size_t i = 0; i < numberOfPoints; ++i)
+    {
+        points[i] = glm::vec3(coordinate(generator), coordinate(generator), coordinate(generator));
+        points2D[i] = glm::vec2(points[i]);
+    }
+    std::vector<float> values(numberOfPoints);
+
+    // Mpoints/s of @run, repeated for at least 50 ms
+    auto measure = [&](auto && run) {
+        std::size_t evaluated = 0;
+        auto start = std::chrono::steady_clock::now();
+        double seconds = 0.0;
+        do
+        {
+            run();
+            evaluated += numberOfPoints;
+            seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        } while (seconds < 0.05);
+        return double(evaluated) / seconds * 1e-6;
+    };
+
+    out << "Skin noise, Mpoints/s (Noise3D / FBM 6 octaves / snoise / noise) :" << std::endl;
+    for (int path = NOISE_SCALAR; path <= NOISE_AVX2; ++path)
+    {
+        if (!p.available[path]) continue;
+        const SkinNoiseBatch & b = p.batches[path];
+        double noise = measure([&] { b.noise3D(points.data(), numberOfPoints, values.data()); });
+        double fbm = measure([&] { b.fbm(points.data(), numberOfPoints, values.data(), 6); });
+        double simplex3D = measure([&] { b.simplex3D(points.data(), numberOfPoints, values.data()); });
+        double simplex2D = measure([&] { b.simplex2D(points2D.data(), numberOfPoints, values.data()); });
+        out << "  " << pathName(SkinNoisePath(path)) << " : " << noise << " / " << fbm << " / " << simplex3D
+            << " / " << simplex2D << (path == p.current ? " (in use)" : "") << std::endl;
+    }
+}
@@ -0,0 +1,97 @@
+#include "SkinNoiseKernels.hpp"
+
+// compiled with AVX2 enabled (see CMakeLists.txt), only called once the CPU was checked
+#if defined(__AVX2__)
+    #include <immintrin.h>
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+    #endif
+
+namespace {
+
+// 8 lanes
+struct AVXLanes {
+    __m256 v;
+
+    static const int width = 8;
+    AVXLanes() = default;
+    AVXLanes(__m256 x) : v(x) {}
+    AVXLanes(float x) : v(_mm256_set1_ps(x)) {}
+    static AVXLanes load(const float * p) { return _mm256_load_ps(p); }
+    static void store(float * p, AVXLanes x) { _mm256_store_ps(p, x.v); }
+};
+inline AVXLanes operator+(AVXLanes a, AVXLanes b) { return _mm256_add_ps(a.v, b.v); }
+inline AVXLanes operator-(AVXLanes a, AVXLanes b) { return _mm256_sub_ps(a.v, b.v); }
+inline AVXLanes operator*(AVXLanes a, AVXLanes b) { return _mm256_mul_ps(a.v, b.v); }
+inline AVXLanes operator/(AVXLanes a, AVXLanes b) { return _mm256_div_ps(a.v, b.v); }
+inline AVXLanes vfloor(AVXLanes x) { return _mm256_floor_ps(x.v); }
+inline AVXLanes vmin(AVXLanes a, AVXLanes b) { return _mm256_min_ps(a.v, b.v); }
+inline AVXLanes vmax(AVXLanes a, AVXLanes b) { return _mm256_max_ps(a.v, b.v); }
+inline AVXLanes vabs(AVXLanes x) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), x.v); }
+inline AVXLanes vstep(AVXLanes edge, AVXLanes x)
+{
+    return _mm256_and_ps(_mm256_cmp_ps(x.v, edge.v, _CMP_NLT_UQ), _mm256_set1_ps(1.0f));
+}
+
+// same as sin_pd in SkinNoise.cpp, 4 doubles
+__m256d sin_pd(__m256d x)
+{
+    // k = round(x 2 / pi), odd quadrants take the cosine, k & 2 flips the sign
+    __m128i k = _mm256_cvtpd_epi32(_mm256_mul_pd(x, _mm256_set1_pd(TWO_OVER_PI)));
+    __m256d kd = _mm256_cvtepi32_pd(k);
+    __m256d r = _mm256_sub_pd(x, _mm256_mul_pd(kd, _mm256_set1_pd(PI_OVER_2[0])));
+    r = _mm256_sub_pd(r, _mm256_mul_pd(kd, _mm256_set1_pd(PI_OVER_2[1])));
+    r = _mm256_sub_pd(r, _mm256_mul_pd(kd, _mm256_set1_pd(PI_OVER_2[2])));
+    __m256d z = _mm256_mul_pd(r, r);
+
+    __m256d s = _mm256_set1_pd(SIN_KERNEL[5]), c = _mm256_set1_pd(COS_KERNEL[5]);
+    for (int i = 4; i >= 0; --i)
+    {
+        s = _mm256_add_pd(_mm256_mul_pd(s, z), _mm256_set1_pd(SIN_KERNEL[i]));
+        c = _mm256_add_pd(_mm256_mul_pd(c, z), _mm256_set1_pd(COS_KERNEL[i]));
+    }
+    s = _mm256_add_pd(r, _mm256_mul_pd(_mm256_mul_pd(r, z), s));
+    c = _mm256_add_pd(_mm256_sub_pd(_mm256_set1_pd(1.0), _mm256_mul_pd(_mm256_set1_pd(0.5), z)),
+                      _mm256_mul_pd(_mm256_mul_pd(z, z), c));
+
+    __m256i q = _mm256_cvtepi32_epi64(k);
+    __m256d odd = _mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(q, _mm256_set1_epi64x(1)), _mm256_set1_epi64x(1)));
+    __m256d value = _mm256_blendv_pd(s, c, odd);
+    __m256d sign = _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_and_si256(q, _mm256_set1_epi64x(2)), 62));
+    return _mm256_xor_pd(value, sign);
+}
+
+inline AVXLanes vsin(AVXLanes x)
+{
+    __m256d low = _mm256_cvtps_pd(_mm256_castps256_ps128(x.v)), high = _mm256_cvtps_pd(_mm256_extractf128_ps(x.v, 1));
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(sin_pd(low))), _mm256_cvtpd_ps(sin_pd(high)), 1);
+}
+
+bool cpu_has_avx2()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0 && (_xgetbv(0) & 6) == 6;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+} // namespace
+
+bool make_avx2_batch(SkinNoiseBatch & batch)
+{
+    if (!cpu_has_avx2()) return false;
+    batch = make_batch<AVXLanes>();
+    return true;
+}
+
+#else
+
+bool make_avx2_batch(SkinNoiseBatch &)
+{
+    return false;
+}
+
+#endif
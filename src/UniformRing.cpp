@@ -0,0 +1,95 @@
+#include "UniformRing.hpp"
+
+#include <cstring>
+#include <iostream>
+
+void UniformRing::create(std::size_t bytesPerFrame, unsigned int framesInFlight)
+{
+    destroy();
+
+    GLint offsetAlignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+    alignment = std::size_t(offsetAlignment);
+    regionSize = (bytesPerFrame + alignment - 1) / alignment * alignment;
+    fences.assign(framesInFlight, nullptr);
+
+    // coherent : writes are visible to the GPU without explicit flushes
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferStorage(GL_UNIFORM_BUFFER, regionSize * framesInFlight, nullptr, flags);
+    mapping = static_cast<unsigned char *>(glMapBufferRange(GL_UNIFORM_BUFFER, 0, regionSize * framesInFlight, flags));
+    if (mapping == nullptr) std::cerr << "Uniform ring : persistent mapping failed" << std::endl;
+    current = 0;
+    cursor = 0;
+}
+
+void UniformRing::destroy()
+{
+    for (GLsync & fence : fences)
+    {
+        if (fence != nullptr) glDeleteSync(fence);
+        fence = nullptr;
+    }
+    if (buffer != 0)
+    {
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glUnmapBuffer(GL_UNIFORM_BUFFER);
+        glDeleteBuffers(1, &buffer);
+    }
+    buffer = 0;
+    mapping = nullptr;
+}
+
+void UniformRing::beginFrame()
+{
+    current = (current + 1) % fences.size();
+    cursor = 0;
+    frameBlock.clear();
+
+    GLsync & fence = fences[current];
+    if (fence == nullptr) return;
+    GLenum status = glClientWaitSync(fence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED)
+    {
+        ++stalls;
+        while (status == GL_TIMEOUT_EXPIRED) status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+void UniformRing::endFrame()
+{
+    fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void UniformRing::bind(GLuint binding, const void * data, std::size_t size)
+{
+    if (mapping == nullptr) return;
+
+    if (cursor + size > regionSize)
+    {
+        // the frame outgrew its region : let the GPU finish what it was given and start over
+        if (overflows++ == 0) std::cerr << "Uniform ring : frame larger than " << regionSize << " bytes" << std::endl;
+        glFinish();
+        cursor = 0;
+        // the frame block was at the start of the region : written again for the next draws
+        if (!frameBlock.empty() && binding != FRAME_BLOCK_BINDING) write(FRAME_BLOCK_BINDING, frameBlock.data(), frameBlock.size());
+    }
+
+    write(binding, data, size);
+    if (binding == FRAME_BLOCK_BINDING)
+    {
+        const unsigned char * bytes = static_cast<const unsigned char *>(data);
+        frameBlock.assign(bytes, bytes + size);
+    }
+}
+
+void UniformRing::write(GLuint binding, const void * data, std::size_t size)
+{
+    const std::size_t offset = current * regionSize + cursor;
+    std::memcpy(mapping + offset, data, size);
+    glBindBufferRange(GL_UNIFORM_BUFFER, binding, buffer, GLintptr(offset), GLsizeiptr(size));
+    cursor += (size + alignment - 1) / alignment * alignment;
+}
@@ -9,6 +9,7 @@
 #include <imgui_impl_opengl3.h>
 #include <cstdio>
 #include <string>
+#include <unordered_map>
 
 #ifdef __linux__
     #include <unistd.h>
@@ -21,7 +22,19 @@
 // include project files
 #include "Mesh.hpp"
 #include "MeshRenderer.hpp"
+#include "MeshLoader.hpp"
 #include "Camera.hpp"
+#include "DynamicResolution.hpp"
+#include "GodRays.hpp"
+#include "GpuTimer.hpp"
+#include "LightVisibility.hpp"
+#include "NoiseVolumes.hpp"
+#include "RenderTargets.hpp"
+#include "SkinAtlas.hpp"
+#include "SkinParameters.hpp"
+#include "UniformRing.hpp"
+#include "ShaderVariants.hpp"
+#include "SkinNoise.hpp"
 
 
 // settings
@@ -57,51 +70,11 @@ void CherryTheme() ;
 void renderGui(LightSource & light, Camera & mainCamera);
 
 
-unsigned int quadVAO;
-unsigned int quadVBO;
-void renderQuad()
-{
-    if (quadVAO == 0)
-    {
-        float quadVertices[] = {
-                // positions        // texture Coords
-                -1.0f,  1.0f, 0.0f, 0.0f, 1.0f,
-                -1.0f, -1.0f, 0.0f, 0.0f, 0.0f,
-                1.0f,  1.0f, 0.0f, 1.0f, 1.0f,
-                1.0f, -1.0f, 0.0f, 1.0f, 0.0f,
-        };
-        // setup plane VAO
-        glGenVertexArrays(1, &quadVAO);
-        glGenBuffers(1, &quadVBO);
-        glBindVertexArray(quadVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-
-        std::cout << "Quad created" << std::endl;
-    }
-    glBindVertexArray(quadVAO);
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-    //glBindVertexArray(0);
-}
-
-void drawQuad(unsigned int quadID, unsigned int textureID){
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glUseProgram(quadID);
-    glUniform1i(glGetUniformLocation(quadID, "image"), 0);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, textureID);
-    renderQuad();
-}
-
-
 // **************
 // MAIN
 int main()
 {
+    auto startTime = std::chrono::steady_clock::now();
 
     // glfw: initialize and configure
     glfwInit();
@@ -141,13 +114,46 @@ int main()
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_MULTISAMPLE);
 
+    // uniform blocks of the mesh shaders : 3 frames in flight, room for ~16k draws per frame
+    UniformRing uniformRing;
+    uniformRing.create(4 * 1024 * 1024);
+    MeshRenderer::setUniformRing(&uniformRing);
+
     // get current working directory
     std::string currentPath = getCurrentWorkingDirectory();
 	std::cout << "Current working directory is " << currentPath << std::endl;
 
+    // load meshes in the background, they are uploaded by the render loop once ready
+    // Thoracique/Thoracique_30 coeur
+    MeshLoader handLoader(currentPath+"/assets/models/hand.off");
+    MeshLoader lightLoader(currentPath+"/assets/models/sphereHQ.off");
+    bool handsReady = false, lightReady = false, assetsReported = false;
+    // camel.off of the ray benchmark, loaded on its first run
+    MeshLoader benchmarkLoader;
+    bool benchmarkRays = false;
+
+    // skin noise baked in 3D textures on the worker threads, computed per fragment until then
+    NoiseVolumes noiseVolumes;
+    noiseVolumes.bake();
+    // skin colour of the hands baked in their uv atlas, again whenever the freckles change
+    SkinAtlas skinAtlas;
+
     // create shader
-    Shader shader = Shader((currentPath+"/assets/shaders/vertex_shader.glsl").c_str(),
-                           (currentPath+"/assets/shaders/fragment_shader.glsl").c_str());
+    // skin programs are compiled per set of enabled features (the full one now, with the noise
+    // and colour computed until the volumes and the atlas are baked, others on demand)
+    SkinFeatures skinFeatures;
+    ShaderVariants skinShaders(currentPath+"/assets/shaders/vertex_shader.glsl",
+                               currentPath+"/assets/shaders/fragment_shader.glsl");
+    ShaderVariants instancedSkinShaders(currentPath+"/assets/shaders/instanced_vertex_shader.glsl",
+                                        currentPath+"/assets/shaders/fragment_shader.glsl");
+    SkinFeatures computedNoise;
+    computedNoise.noiseTextures = false;
+    computedNoise.bakedAlbedo = false;
+    for (const SkinFeatures & features : {skinFeatures, computedNoise})
+    {
+        skinShaders.get(features);
+        instancedSkinShaders.get(features);
+    }
 
     Shader lighting_shader = Shader((currentPath+"/assets/shaders/light_vertex_shader.glsl").c_str(),
                            (currentPath+"/assets/shaders/light_fragment_shader.glsl").c_str());
@@ -155,33 +161,29 @@ int main()
     Shader depth_shader = Shader((currentPath+"/assets/shaders/depth_vertex_shader.glsl").c_str(),
                            (currentPath+"/assets/shaders/depth_fragment_shader.glsl").c_str());
 
-    //---
-    Shader quad_shader = Shader((currentPath+"/assets/shaders/quad.vs.glsl").c_str(),
-                                 (currentPath+"/assets/shaders/quad.fs.glsl").c_str());
-
-    Shader compute_shader = Shader((currentPath+"/assets/shaders/godrays.cs.glsl").c_str());
-    unsigned int tex_w = SCR_WIDTH; unsigned int tex_h = SCR_HEIGHT;
-    unsigned int tex_norm = compute_shader.generateComputeTexture(tex_w, tex_h, 0);
+    // light shafts of the post-processing, composited straight to the screen
+    GodRays godRays(currentPath+"/assets/shaders");
+    // scales the rays by how much of the light is seen, skips them when nothing is
+    LightVisibility lightVisibility;
+    // compiled on a cold start, loaded from the program binary cache on the next ones
+    Shader::report(std::cout);
 
-    // create mesh
-    // Thoracique/Thoracique_30 coeur
-    Mesh tridimodel = Mesh((currentPath+"/assets/models/hand.off").c_str());
-    Mesh lightmodel = Mesh((currentPath+"/assets/models/sphereHQ.off").c_str());
-
-    // create renderer
+    // create renderer (once the meshes are loaded)
     glm::vec3 objectcolor = glm::vec3(1.0, 0.75, 0.66);//glm::vec3(0.95, 0.5, 0.35);
 
-    mrenderer = MeshRenderer(shader.ID, depth_shader.ID, tridimodel);
-    mrenderer.setModelScale(glm::vec3(0.005));
-    mrenderer.setModelTranslation(glm::vec3(125, -200.0, 0.0));
-    mrenderer.setModelRotation(glm::vec3(0.0, -glm::radians(/*glfwGetTime()*/90.0f), 0.0));
-    mrenderer.setModelColor(objectcolor);
+    auto createHandRenderers = [&](const std::shared_ptr<MeshAsset> & tridimodel) {
+        mrenderer = MeshRenderer(skinShaders.get(skinFeatures).ID, depth_shader.ID, tridimodel);
+        mrenderer.setModelScale(glm::vec3(0.005));
+        mrenderer.setModelTranslation(glm::vec3(125, -200.0, 0.0));
+        mrenderer.setModelRotation(glm::vec3(0.0, -glm::radians(/*glfwGetTime()*/90.0f), 0.0));
+        mrenderer.setModelColor(objectcolor);
 
-    mrenderer2 = MeshRenderer(shader.ID, depth_shader.ID, tridimodel);
-    mrenderer2.setModelScale(glm::vec3(-0.005, 0.005, 0.005));
-    mrenderer2.setModelTranslation(glm::vec3(125, -200.0, 0.0));
-    mrenderer2.setModelRotation(glm::vec3(0.0, -glm::radians(/*glfwGetTime()*/90.0f), 0.0));
-    mrenderer2.setModelColor(objectcolor);
+        mrenderer2 = MeshRenderer(skinShaders.get(skinFeatures).ID, depth_shader.ID, tridimodel);
+        mrenderer2.setModelScale(glm::vec3(-0.005, 0.005, 0.005));
+        mrenderer2.setModelTranslation(glm::vec3(125, -200.0, 0.0));
+        mrenderer2.setModelRotation(glm::vec3(0.0, -glm::radians(/*glfwGetTime()*/90.0f), 0.0));
+        mrenderer2.setModelColor(objectcolor);
+    };
 
     // create camera
     mainCamera = Camera(glm::vec3(0.0 + cos(0.5 * 3.1415) * 3.0,
@@ -196,46 +198,22 @@ int main()
     light = LightSource(glm::vec3(0.0, 0.25, 0));
     light.color = glm::vec3(0.95, 0.95, 0.9);
     light.configureDepthMapTo(glm::vec3(0.0, 0.0, 0.0));
-    lrenderer = MeshRenderer(lighting_shader.ID, depth_shader.ID, lightmodel);
-    lrenderer.setModelTranslation(glm::vec3(0.0, 0.25, 0.0));
-    lrenderer.setModelRotation(glm::vec3(0.0, -glm::radians(/*glfwGetTime()*/90.0f), 0.0));
-    lrenderer.setModelScale(glm::vec3(0.75));
-    lrenderer.setModelColor(lighting_shader.ID, light.color);
-
-
-    // configure framebuffer
-    // ------------------------------
-    unsigned int framebuffer;
-    glGenFramebuffers(1, &framebuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-    // position color buffer
-    unsigned int textureColorbuffer;
-    glGenTextures(1, &textureColorbuffer);
-    glBindTexture(GL_TEXTURE_2D, textureColorbuffer);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textureColorbuffer, 0);
-    unsigned int textureMaskBuffer;
-    glGenTextures(1, &textureMaskBuffer);
-    glBindTexture(GL_TEXTURE_2D, textureMaskBuffer);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, textureMaskBuffer, 0);
-    unsigned int attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
-    glDrawBuffers(2, attachments);
-
-    // create and attach depth buffer (renderbuffer)
-    unsigned int rbo;
-    glGenRenderbuffers(1, &rbo);
-    glBindRenderbuffer(GL_RENDERBUFFER, rbo);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, SCR_WIDTH, SCR_HEIGHT); // use a single renderbuffer object for both a depth AND stencil buffer.
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbo); // now actually attach it
-    // now that we actually created the framebuffer and added all attachments we want to check if it is actually complete now
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        std::cout << "Framebuffer not complete!" << std::endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    // size of the light mesh, in its model matrix only : the screen test of its bounding sphere
+    // (LightVisibility) and the draws agree
+    const float lightScale = 0.5f;
+    auto createLightRenderer = [&](const std::shared_ptr<MeshAsset> & lightmodel) {
+        lrenderer = MeshRenderer(lighting_shader.ID, depth_shader.ID, lightmodel);
+        lrenderer.setModelNewTranslation(light.position);
+        lrenderer.setModelScale(glm::vec3(lightScale));
+        lrenderer.setModelColor(light.color);
+    };
+
+
+    // offscreen targets of the 3D pass, allocated again when the window is resized
+    RenderTargets renderTargets;
+    renderTargets.resize(int(SCR_WIDTH), int(SCR_HEIGHT));
+    // render scale of the 3D pass, adapted to the GPU time of the frames
+    DynamicResolution dynamicResolution;
 
     // setup Dear ImGui context
     IMGUI_CHECKVERSION();
@@ -253,14 +231,55 @@ int main()
     // ------------------
     bool animatedLight = false;
     bool animatedCamera = false;
-    glm::vec3 skinColor = objectcolor;
-    glm::vec3 freckColor = glm::vec3(0.409, 0.101, 0.108);
-    float freck_scale = 0.3;
-    float freck_frequency = 5.0;
+    SkinParameters skin;
+    // version of the skin parameters each derived value was made from (NEVER : not made yet)
+    const std::uint64_t NEVER = ~std::uint64_t(0);
+    std::unordered_map<GLuint, std::uint64_t> frecklesUploaded;    // per skin program
+    std::uint64_t atlasRequested = NEVER, handColorsSet = NEVER, crowdColors = NEVER;
+    SkinFeatures programFeatures;
+    const Shader * skinProgram = nullptr;
+    const Shader * instancedSkinProgram = nullptr;
+    bool force32bitIndices = false;
+    bool automaticLod = true;
+    bool packedVertices = true;
+    GpuTimer handsTimer;
+    bool instancedHands = true;
+    int crowdSize = 0;
+    float submitMilliseconds = 0.0f;
+    std::vector<MeshInstance> crowd;
+    bool benchmarkSubmit = false;
+    bool firstFrame = true;
 
     // RENDER LOOP -----
     while (!glfwWindowShouldClose(window))
     {
+        // GL upload of the meshes finished by the loaders
+        if (!handsReady && handLoader.ready() && !handLoader.failed())
+        {
+            // both hands share one asset : one CPU mesh, one set of buffers
+            createHandRenderers(MeshAssetCache::acquire(handLoader.getFilename(), handLoader.get()));
+            handsReady = true;
+            std::cout << "Hands ready after " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count()
+                      << " ms (loaded in " << handLoader.getMilliseconds() << " ms)" << std::endl;
+        }
+        if (!lightReady && lightLoader.ready() && !lightLoader.failed())
+        {
+            createLightRenderer(MeshAssetCache::acquire(lightLoader.getFilename(), lightLoader.get()));
+            lightReady = true;
+            std::cout << "Light ready after " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count()
+                      << " ms (loaded in " << lightLoader.getMilliseconds() << " ms)" << std::endl;
+        }
+        if (benchmarkRays && benchmarkLoader.ready())
+        {
+            if (!benchmarkLoader.failed()) benchmarkLoader.get()->bvh().benchmark(std::cout);
+            benchmarkRays = false;
+        }
+        noiseVolumes.update();
+        if (handsReady && lightReady && !assetsReported)
+        {
+            MeshAssetCache::report(std::cout);
+            assetsReported = true;
+        }
         //glClearColor(50.0f/255.0f, 50.0f/255.0f, 50.0f/255.0f, 1.0f);
         glClearColor(0.0f/255.0f, 0.0f/255.0f, 0.0f/255.0f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -268,38 +287,175 @@ int main()
         if(wireFrame) glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
         else glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
-        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        // skin programs of the frame : the features turned off in the settings are compiled out
+        skinFeatures.freckles = skin.freckleScale.get() > 0.0f;
+        SkinFeatures frameFeatures = skinFeatures;
+        frameFeatures.noiseTextures &= noiseVolumes.ready();
+        if (frameFeatures.noiseTextures) noiseVolumes.bind();
+        // computed while the atlas is out of date (the freckles being edited)
+        frameFeatures.bakedAlbedo &= handsReady;
+        if (handsReady)
+        {
+            const std::shared_ptr<const Mesh> handMesh = mrenderer.getAsset()->mesh;
+            const std::uint64_t frecklesVersion = skin.freckles_version();
+            skinAtlas.update();
+            if (skinFeatures.bakedAlbedo && atlasRequested != frecklesVersion)
+            {
+                SkinAtlasParameters atlasParameters;
+                atlasParameters.model = mrenderer.getModel();
+                atlasParameters.freckleColor = skin.freckleColor.get();
+                atlasParameters.freckleScale = skin.freckleScale.get();
+                atlasParameters.freckleFrequency = skin.freckleFrequency.get();
+                skinAtlas.request(handMesh, atlasParameters, frecklesVersion);
+                atlasRequested = frecklesVersion;
+            }
+            else if (!skinFeatures.bakedAlbedo) atlasRequested = NEVER;
+            frameFeatures.bakedAlbedo &= skinAtlas.current(handMesh, frecklesVersion);
+        }
+        if (frameFeatures.bakedAlbedo) skinAtlas.bind();
+        if (skinProgram == nullptr || frameFeatures != programFeatures)
+        {
+            skinProgram = &skinShaders.get(frameFeatures);
+            instancedSkinProgram = &instancedSkinShaders.get(frameFeatures);
+            programFeatures = frameFeatures;
+        }
+        const Shader & shader = *skinProgram;
+        const Shader & instanced_shader = *instancedSkinProgram;
+        // freckle uniforms, when the program is new to them or they changed
+        for (const Shader * program : {skinProgram, instancedSkinProgram})
+        {
+            std::uint64_t & uploaded = frecklesUploaded[program->ID];
+            if (uploaded == skin.freckles_version() + 1) continue;
+            program->use();
+            program->setVec3("freck_col", skin.freckleColor.get());
+            program->setFloat("freck_scale", skin.freckleScale.get());
+            program->setFloat("freck_frequency", skin.freckleFrequency.get());
+            uploaded = skin.freckles_version() + 1;
+        }
+
+        // camera and light of the frame, shared by every mesh draw
+        uniformRing.beginFrame();
+        FrameUniforms frameUniforms = {};
+        frameUniforms.projection = mainCamera.projection;
+        frameUniforms.view = mainCamera.GetViewMatrix();
+        frameUniforms.lightPos = light.position;
+        frameUniforms.viewPos = mainCamera.Position;
+        frameUniforms.lightColor = light.color;
+        uniformRing.bind(FRAME_BLOCK_BINDING, &frameUniforms, sizeof(frameUniforms));
+
+        // light against the screen (bounding sphere of its mesh)
+        if (lightReady) {
+            const BOX & box = lrenderer.getAsset()->mesh->bounding_box;
+            float extent = std::max(box.xpos.y - box.xpos.x, std::max(box.ypos.y - box.ypos.x, box.zpos.y - box.zpos.x));
+            float radius = 0.5f * extent * lightScale;
+            lightVisibility.beginFrame(mainCamera.projection, mainCamera.GetViewMatrix(), light.position, radius);
+        }
+
+        // targets and projection follow the window (not while it is minimised)
+        if (renderTargets.resize(int(SCR_WIDTH), int(SCR_HEIGHT)))
+            mainCamera.setProjection(glm::perspective(glm::radians(45.0f), (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.01f, 100.0f));
+        renderTargets.setRenderScale(dynamicResolution.getScale());
+        MeshRenderer::setViewportHeight(renderTargets.getRenderHeight());
+
+        dynamicResolution.beginFrame();
+        renderTargets.bind();
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-            lrenderer.draw(lighting_shader.ID, mainCamera, light);
-            mrenderer.draw(shader.ID, mainCamera,light);
-            mrenderer2.draw(shader.ID, mainCamera, light);
+            if (lightReady) lrenderer.draw(lighting_shader.ID, mainCamera, light);
+            if (handsReady && benchmarkSubmit) {
+                // CPU submit time of both paths for growing crowds, printed on the console
+                std::cout << "hands | instanced (ms, draws) | one draw per hand (ms)" << std::endl;
+                for (int count : {2, 16, 64, 256, 1024, 4096}) {
+                    std::vector<MeshInstance> instances(count);
+                    for (int i = 0; i < count; ++i) {
+                        glm::vec3 offset(float(i / 2 % 32) - 15.5f, 0.0f, -1.5f - float(i / 64));
+                        instances[i] = {glm::translate(glm::mat4(1.0f), offset) * (i % 2 ? mrenderer2 : mrenderer).getModel(), skin.skinColor.get()};
+                    }
+                    glFinish();
+                    auto start = std::chrono::steady_clock::now();
+                    mrenderer.drawInstanced(instanced_shader.ID, mainCamera, light, instances);
+                    double instancedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                    glFinish();
+                    glm::mat4 handModel = mrenderer.getModel();
+                    start = std::chrono::steady_clock::now();
+                    for (const MeshInstance & instance : instances) {
+                        mrenderer.setModel(instance.model);
+                        mrenderer.draw(shader.ID, mainCamera, light);
+                    }
+                    double loopMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                    mrenderer.setModel(handModel);
+                    glFinish();
+                    std::cout << count << " | " << instancedMs << ", " << mrenderer.getNumberOfInstancedDraws() << " | " << loopMs << std::endl;
+                }
+                benchmarkSubmit = false;
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            }
+            if (handsReady) {
+                // the two hands, then crowdSize more for stress scenes (alternately mirrored,
+                // on a grid behind them)
+                // rebuilt when its size or the skin colour change
+                if (crowd.size() != std::size_t(2 + crowdSize) || crowdColors != skin.skinColor.version()) {
+                    crowd.resize(2 + crowdSize);
+                    crowd[0] = {mrenderer.getModel(), skin.skinColor.get()};
+                    crowd[1] = {mrenderer2.getModel(), skin.skinColor.get()};
+                    for (int i = 0; i < crowdSize; ++i) {
+                        glm::vec3 offset(float(i / 2 % 32) - 15.5f, 0.0f, -1.5f - float(i / 64));
+                        crowd[2 + i] = {glm::translate(glm::mat4(1.0f), offset) * crowd[i % 2].model, skin.skinColor.get()};
+                    }
+                    crowdColors = skin.skinColor.version();
+                }
+
+                handsTimer.begin();
+                auto submitStart = std::chrono::steady_clock::now();
+                if (instancedHands) {
+                    mrenderer.drawInstanced(instanced_shader.ID, mainCamera, light, crowd);
+                } else {
+                    mrenderer.draw(shader.ID, mainCamera,light);
+                    mrenderer2.draw(shader.ID, mainCamera, light);
+                    // one draw per crowd member, through the first renderer
+                    glm::mat4 handModel = mrenderer.getModel();
+                    for (std::size_t i = 2; i < crowd.size(); ++i) {
+                        mrenderer.setModel(crowd[i].model);
+                        mrenderer.draw(shader.ID, mainCamera, light);
+                    }
+                    mrenderer.setModel(handModel);
+                }
+                float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - submitStart).count();
+                submitMilliseconds = (submitMilliseconds == 0.0f) ? ms : submitMilliseconds * 0.9f + ms * 0.1f;
+                handsTimer.end();
+            }
+            // how much of the light the hands hide, drawn again against their depth
+            if (lightReady) lightVisibility.query([&]() { lrenderer.draw(lighting_shader.ID, mainCamera, light); });
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // compute shader
-        {
-            compute_shader.use();
-            glMemoryBarrier(GL_ALL_BARRIER_BITS);
-            glBindImageTexture(0, tex_norm, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
-            glActiveTexture(GL_TEXTURE1);
-            glBindTexture(GL_TEXTURE_2D, textureColorbuffer);
-            glActiveTexture(GL_TEXTURE2);
-            glBindTexture(GL_TEXTURE_2D, textureMaskBuffer);
-            glm::vec4 clipSpacePos = mainCamera.projection * (mainCamera.GetViewMatrix() * glm::vec4(light.position, 1.0));
-            glm::vec3 ndcSpacePos = glm::vec3(clipSpacePos.x, clipSpacePos.y, clipSpacePos.z) / clipSpacePos.w;
-            glm::vec2 windowSpacePos = ((glm::vec2(ndcSpacePos.x, ndcSpacePos.y) + glm::vec2(1.0)) / 2.0f);
-            compute_shader.setVec2("sunPos", windowSpacePos);
-            glDispatchCompute((GLuint)tex_w/16, (GLuint)tex_h/16, 1);
-            glMemoryBarrier(GL_ALL_BARRIER_BITS);
-        }
-        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-        drawQuad(quad_shader.ID, tex_norm);
+        // god rays, composited with the scene into the screen (the scene alone when the light is not seen)
+        // (upscales the 3D pass to the window)
+        godRays.render(renderTargets, lightVisibility.getScreenPosition(), mainCamera.projection, lightVisibility.getVisibility());
+        dynamicResolution.endFrame();
 
         // feed inputs to dear imgui, start new frame
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
         //renderGui(light, mainCamera);
+        if (!handLoader.ready() || !lightLoader.ready()) {
+            // placeholder while the meshes are loading, a failed one is done too (reported on
+            // the console) so the window does not stay
+            MeshLoader * loaders[2] = {&handLoader, &lightLoader};
+            int done = int(handLoader.ready()) + int(lightLoader.ready());
+            ImGui::SetNextWindowPos(ImVec2(0.5f * float(SCR_WIDTH), 0.5f * float(SCR_HEIGHT)), ImGuiCond_Always, ImVec2(0.5f, 0.5f));
+            if (ImGui::Begin("Loading", nullptr, ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_AlwaysAutoResize)) {
+                char overlay[32];
+                std::snprintf(overlay, sizeof(overlay), "%d / 2 meshes", done);
+                ImGui::ProgressBar(float(done) / 2.0f, ImVec2(300.0f, 0.0f), overlay);
+                for (MeshLoader * loader : loaders) {
+                    const char * state = loader->failed() ? "failed" : (loader->ready() ? "ready" : "loading...");
+                    ImGui::Text("%s : %s", loader->getFilename().substr(loader->getFilename().find_last_of("/\\") + 1).c_str(), state);
+                }
+            }
+            ImGui::End();
+        }
         if(ImGui::Begin("Settings", nullptr, ImGuiWindowFlags_NoMove)){
             ImGui::SetWindowPos(ImVec2(0, 0), ImGuiCond_Once);
             ImGui::SetWindowSize(ImVec2(400, (float)SCR_HEIGHT));
@@ -309,24 +465,42 @@ int main()
             if (ImGui::CollapsingHeader("Skin", ImGuiTreeNodeFlags_None)) {
                 ImGui::Dummy(ImVec2(0.0f, 10.0f));
                 if (ImGui::Button("Reset Skin Presets", ImVec2(ImGui::GetContentRegionAvailWidth(),0))) {
-                    freck_scale = 0.3;
-                    freck_frequency = 5.0;
-                    freckColor = glm::vec3(0.409, 0.101, 0.108);
-                    skinColor = objectcolor;
+                    skin.reset();
+                    skinFeatures = SkinFeatures();
                 }
                 ImGui::Dummy(ImVec2(0.0f, 10.0f));
                 ImGui::PushItemWidth(ImGui::GetContentRegionAvailWidth()*0.80);
-                ImGui::ColorEdit3("##ColorSkin", &skinColor.x);
+                // widgets edit copies, the store only takes actual changes
+                glm::vec3 skinColor = skin.skinColor.get(), freckColor = skin.freckleColor.get();
+                float freck_frequency = skin.freckleFrequency.get(), freck_scale = skin.freckleScale.get();
+                if (ImGui::ColorEdit3("##ColorSkin", &skinColor.x)) skin.set(skin.skinColor, skinColor);
                 ImGui::SameLine(); ImGui::Text("Skin");
                 ImGui::Dummy(ImVec2(0.0,10.0));
-                ImGui::ColorEdit3("##ColorFreck", &freckColor.x);
+                if (ImGui::ColorEdit3("##ColorFreck", &freckColor.x)) skin.set(skin.freckleColor, freckColor);
                 ImGui::SameLine(); ImGui::Text("Freck");
                 ImGui::PopItemWidth();
                 ImGui::Dummy(ImVec2(0.0,10.0));
                 ImGui::PushItemWidth(ImGui::GetContentRegionAvailWidth()*0.72);
-                ImGui::DragFloat("Freck frequency", &freck_frequency, 0.01, 0.0, 100.0);
+                if (ImGui::DragFloat("Freck frequency", &freck_frequency, 0.01, 0.0, 100.0))
+                    skin.set(skin.freckleFrequency, freck_frequency);
+                ImGui::Dummy(ImVec2(0.0,10.0));
+                if (ImGui::DragFloat("Freck scale", &freck_scale, 0.001, 0.0f)) skin.set(skin.freckleScale, freck_scale);
                 ImGui::Dummy(ImVec2(0.0,10.0));
-                ImGui::DragFloat("Freck scale", &freck_scale, 0.001, 0.0f);
+                ImGui::Checkbox("Thickness", &skinFeatures.thickness);
+                ImGui::Checkbox("Noise textures", &skinFeatures.noiseTextures);
+                if (noiseVolumes.ready())
+                    ImGui::Text("Noise volumes : %.2f MB, baked in %.0f ms", float(noiseVolumes.getGpuBytes()) / (1024.0f * 1024.0f),
+                                noiseVolumes.getBakeMilliseconds());
+                else
+                    ImGui::Text("Noise volumes : baking...");
+                ImGui::Checkbox("Baked skin atlas", &skinFeatures.bakedAlbedo);
+                if (skinAtlas.ready())
+                    ImGui::Text("Skin atlas : %.2f MB, %.1f%% covered, baked in %.0f ms", float(skinAtlas.getGpuBytes()) / (1024.0f * 1024.0f),
+                                100.0f * float(skinAtlas.getCoveredTexels()) / float(skinAtlas.getSize() * skinAtlas.getSize()),
+                                skinAtlas.getBakeMilliseconds());
+                if (!skinFeatures.noiseTextures || !noiseVolumes.ready())
+                    ImGui::SliderInt("Noise octaves", &skinFeatures.fbmOctaves, 1, 6);
+                ImGui::Text("Skin variants compiled : %u", unsigned(skinShaders.size() + instancedSkinShaders.size()));
                 ImGui::PopItemWidth();
                 ImGui::Dummy(ImVec2(0.0f, 20.0f));
                 ImGui::Separator();
@@ -378,11 +552,109 @@ int main()
                 ImVec2 region = ImVec2(ImGui::GetContentRegionAvailWidth(), ImGui::GetContentRegionAvailWidth()*(9.0/16.0));
                 ImGui::Text("Color texture : ");
                 ImGui::Dummy(ImVec2(0.0f, 5.0f));
-                ImGui::Image((void*)(intptr_t)textureColorbuffer, region, ImVec2(0,1), ImVec2(1,0));
+                // the part the 3D pass rendered into
+                glm::vec2 uvScale = renderTargets.getUvScale();
+                ImGui::Image((void*)(intptr_t)renderTargets.getColor(), region, ImVec2(0,uvScale.y), ImVec2(uvScale.x,0));
                 ImGui::Dummy(ImVec2(0.0f, 20.0f));
                 ImGui::Text("Mask texture : ");
                 ImGui::Dummy(ImVec2(0.0f, 5.0f));
-                ImGui::Image((void*)(intptr_t)textureMaskBuffer, region, ImVec2(0,1), ImVec2(1,0));
+                ImGui::Image((void*)(intptr_t)renderTargets.getMask(), region, ImVec2(0,uvScale.y), ImVec2(uvScale.x,0));
+
+                ImGui::Dummy(ImVec2(0.0f, 20.0f));
+                ImGui::Separator();
+            }
+
+            ImGui::SetNextItemOpen(true, ImGuiCond_Once);
+            if (ImGui::CollapsingHeader("Performance", ImGuiTreeNodeFlags_None)) {
+                ImGui::Dummy(ImVec2(0.0f, 10.0f));
+                ImGui::Text("Frame : %.2f ms", 1000.0f / ImGui::GetIO().Framerate);
+                ImGui::Text("Hands (GPU) : %.3f ms", handsTimer.getMilliseconds());
+                ImGui::Text("Hand triangles : %u", handsReady ? mrenderer.getNumberOfTriangles() : 0u);
+                ImGui::Dummy(ImVec2(0.0f, 10.0f));
+                const GodRaysQuality godRaysModes[3] = {GODRAYS_FULL, GODRAYS_HALF, GODRAYS_QUARTER};
+                const char * godRaysNames[3] = {"Full", "Half", "Quarter"};
+                int godRaysMode = int(std::find(godRaysModes, godRaysModes + 3, godRays.getQuality()) - godRaysModes);
+                if (ImGui::Combo("God rays", &godRaysMode, godRaysNames, 3)) godRays.setQuality(godRaysModes[godRaysMode]);
+                for (int i = 0; i < 3; ++i) {
+                    // measured once the mode was rendered
+                    float ms = godRays.getMilliseconds(godRaysModes[i]);
+                    if (ms > 0.0f) ImGui::Text("God rays %s (GPU) : %.3f ms", godRaysNames[i], ms);
+                    else ImGui::Text("God rays %s (GPU) : -", godRaysNames[i]);
+                }
+                ImGui::Text("Light visibility : %.2f (%.2f unoccluded)%s", lightVisibility.getVisibility(),
+                            lightVisibility.getUnoccluded(), godRays.active() ? "" : ", rays skipped");
+                ImGui::Dummy(ImVec2(0.0f, 10.0f));
+                bool dynamic = dynamicResolution.isEnabled();
+                if (ImGui::Checkbox("Dynamic resolution", &dynamic)) {
+                    dynamicResolution.setEnabled(dynamic);
+                    if (!dynamic) dynamicResolution.setScale(1.0f);
+                }
+                float targetMs = dynamicResolution.getTargetMilliseconds();
+                if (ImGui::SliderFloat("Target (ms)", &targetMs, 4.0f, 50.0f, "%.1f ms")) dynamicResolution.setTargetMilliseconds(targetMs);
+                float minimumScale = dynamicResolution.getMinimumScale();
+                if (ImGui::SliderFloat("Minimum scale", &minimumScale, 0.25f, 1.0f, "%.2f"))
+                    dynamicResolution.setScaleRange(minimumScale, dynamicResolution.getMaximumScale());
+                ImGui::Text("Render scale : %.3f (%dx%d of %dx%d)", renderTargets.getRenderScale(), renderTargets.getRenderWidth(),
+                            renderTargets.getRenderHeight(), renderTargets.getWidth(), renderTargets.getHeight());
+                ImGui::Text("Frame (GPU) : %.3f ms", dynamicResolution.getMilliseconds());
+                ImGui::PlotLines("##scale", dynamicResolution.getScaleHistory().data(), DynamicResolution::HISTORY,
+                                 dynamicResolution.getHistoryOffset(), "render scale", 0.0f, 1.0f, ImVec2(0, 60));
+                ImGui::PlotLines("##gpu", dynamicResolution.getMillisecondsHistory().data(), DynamicResolution::HISTORY,
+                                 dynamicResolution.getHistoryOffset(), "GPU (ms)", 0.0f, 2.0f * targetMs, ImVec2(0, 60));
+                // the last scale decisions, all of them on the console
+                const std::deque<DynamicResolution::Decision> & decisions = dynamicResolution.getDecisions();
+                for (std::size_t i = decisions.size() > 4 ? decisions.size() - 4 : 0; i < decisions.size(); ++i)
+                    ImGui::Text("Frame %llu : %.3f -> %.3f (%.2f ms)", (unsigned long long) decisions[i].frame,
+                                decisions[i].from, decisions[i].to, decisions[i].milliseconds);
+                if (ImGui::Button("Print scale decisions", ImVec2(ImGui::GetContentRegionAvailWidth(), 0)))
+                    dynamicResolution.report(std::cout);
+                ImGui::Dummy(ImVec2(0.0f, 10.0f));
+                ImGui::Checkbox("Instanced hands", &instancedHands);
+                ImGui::SliderInt("Crowd", &crowdSize, 0, 4096);
+                ImGui::Text("Submit (CPU) : %.3f ms for %d hands", submitMilliseconds, crowdSize + 2);
+                if (instancedHands) ImGui::Text("Instanced draws : %u", mrenderer.getNumberOfInstancedDraws());
+                if (ImGui::Button("Benchmark submit", ImVec2(ImGui::GetContentRegionAvailWidth(), 0))) benchmarkSubmit = true;
+                if (ImGui::Button("Benchmark rays", ImVec2(ImGui::GetContentRegionAvailWidth(), 0)) && handsReady) {
+                    // BVH ray queries on the hand, then on camel.off once the loader has it,
+                    // printed on the console
+                    mrenderer.getAsset()->mesh->bvh().benchmark(std::cout);
+                    if (benchmarkLoader.getFilename().empty()) benchmarkLoader.load(currentPath+"/assets/models/camel.off");
+                    benchmarkRays = true;
+                }
+                if (ImGui::Button("Benchmark occlusion bake", ImVec2(ImGui::GetContentRegionAvailWidth(), 0)) && handsReady) {
+                    // bake time against the number of threads, printed on the console
+                    mrenderer.getAsset()->mesh->benchmark_occlusion(std::cout);
+                }
+                if (ImGui::Button("Benchmark skin noise", ImVec2(ImGui::GetContentRegionAvailWidth(), 0))) {
+                    // CPU port of the shader noise : checked against the references, then timed
+                    SkinNoise::conformance(std::cout);
+                    SkinNoise::benchmark(std::cout);
+                }
+                ImGui::Dummy(ImVec2(0.0f, 10.0f));
+                if (ImGui::Checkbox("Force 32-bit indices", &force32bitIndices) && handsReady) {
+                    mrenderer.forceIndexWidth(force32bitIndices);
+                    mrenderer2.forceIndexWidth(force32bitIndices);
+                }
+                if (handsReady) ImGui::Text("Index width : %d bits", mrenderer.getIndexWidth() * 8);
+                if (ImGui::Checkbox("Packed vertices", &packedVertices) && handsReady && lightReady) {
+                    // both hands share the asset : one upload covers them
+                    mrenderer.setVertexFormat(packedVertices ? VERTEX_PACKED : VERTEX_FLOAT);
+                    lrenderer.setVertexFormat(packedVertices ? VERTEX_PACKED : VERTEX_FLOAT);
+                }
+                if (handsReady) ImGui::Text("Vertex size : %u bytes", mrenderer.getVertexStride());
+                ImGui::Dummy(ImVec2(0.0f, 10.0f));
+                if (ImGui::Checkbox("Automatic LOD", &automaticLod) && handsReady && lightReady) {
+                    mrenderer.setAutomaticLod(automaticLod);
+                    mrenderer2.setAutomaticLod(automaticLod);
+                    lrenderer.setAutomaticLod(automaticLod);
+                }
+                if (handsReady) ImGui::Text("Hand LOD : %u (%u triangles)", mrenderer.getCurrentLod(), mrenderer.getNumberOfDrawnTriangles());
+                if (lightReady) ImGui::Text("Light LOD : %u (%u triangles)", lrenderer.getCurrentLod(), lrenderer.getNumberOfDrawnTriangles());
+                std::size_t sharedBytes, unsharedBytes;
+                MeshAssetCache::memory_usage(sharedBytes, unsharedBytes);
+                ImGui::Text("Mesh memory : %.2f MB (%.2f MB unshared)", float(sharedBytes) / (1024.0f * 1024.0f),
+                            float(unsharedBytes) / (1024.0f * 1024.0f));
+                ImGui::Text("Uniform ring : %u stalls, %u overflows", uniformRing.getStalls(), uniformRing.getOverflows());
 
                 ImGui::Dummy(ImVec2(0.0f, 20.0f));
                 ImGui::Separator();
@@ -399,15 +671,16 @@ int main()
                                            light.position.y,
                                            cos(glfwGetTime() * 2.0f) * 0.075f);
             }
-            lrenderer.setModelNewTranslation(light.position);
-            lrenderer.setModelColor(lighting_shader.ID, light.color);
-            shader.use();
-            shader.setVec3("lightColor", light.color);
-            shader.setVec3("freck_col", freckColor);
-            shader.setFloat("freck_scale", freck_scale);
-            shader.setFloat("freck_frequency", freck_frequency);
-            mrenderer.setModelColor(skinColor);
-            mrenderer2.setModelColor(skinColor);
+            if (lightReady) {
+                lrenderer.setModelNewTranslation(light.position);
+                lrenderer.setModelScale(glm::vec3(lightScale));
+                lrenderer.setModelColor(light.color);
+            }
+            if (handsReady && handColorsSet != skin.skinColor.version()) {
+                mrenderer.setModelColor(skin.skinColor.get());
+                mrenderer2.setModelColor(skin.skinColor.get());
+                handColorsSet = skin.skinColor.version();
+            }
             if (animatedCamera) {
                 mainCamera.Position = glm::vec3(cos(glfwGetTime() / 10.0f) * 3.0f,
                                                 mainCamera.Position.y,
@@ -422,13 +695,30 @@ int main()
         ImGui::Render();
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
+        uniformRing.endFrame();
         glfwSwapBuffers(window);
         glfwPollEvents();
 
+        if (firstFrame) {
+            std::cout << "First frame after " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count()
+                      << " ms" << std::endl;
+            firstFrame = false;
+        }
+
         //little_sleep(std::chrono::milliseconds(25));
     }
     // clean up
-    mrenderer.cleanUp();
+    handsTimer.cleanUp();
+    // mesh assets go with their last renderer, while the context is alive
+    if (handsReady) mrenderer.cleanUp();
+    mrenderer = mrenderer2 = lrenderer = MeshRenderer();
+    uniformRing.destroy();
+    noiseVolumes.destroy();
+    skinAtlas.destroy();
+    godRays.destroy();
+    lightVisibility.destroy();
+    dynamicResolution.destroy();
+    renderTargets.destroy();
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();